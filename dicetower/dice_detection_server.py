@@ -6,7 +6,11 @@ ChatGPT-only Dice Detection Server.
 - /gpt_detect -> uses gpt_dice_integration.detect_with_chatgpt on posted JPEG
 """
 
-from flask import Flask, request, jsonify
+import itertools
+import struct
+import time
+
+from flask import Flask, Response, request, jsonify
 from flask_cors import CORS
 
 app = Flask(__name__)
@@ -17,6 +21,36 @@ try:
 except Exception:
     detect_with_chatgpt = None
 
+# Binary DiceDetection record, see src/esp32cam/detection_wire.h.
+# Towers ask for it with `Accept: application/vnd.dicetower.detection`.
+DETECTION_WIRE_MIME = "application/vnd.dicetower.detection"
+DETECTION_WIRE = struct.Struct("<2sBBIIBBHf4h")
+_detection_seq = itertools.count(1)
+
+
+def pack_detection(result):
+    """Pack a detection dict into the 28-byte little-endian wire record."""
+    def small(v):
+        v = int(v or 0)
+        return v if 0 <= v <= 255 else 0
+
+    return DETECTION_WIRE.pack(
+        b"DT",
+        1,
+        1 if result.get("detected") else 0,
+        next(_detection_seq) & 0xFFFFFFFF,
+        int(time.monotonic() * 1000) & 0xFFFFFFFF,
+        small(result.get("value")),
+        small(result.get("second_most_likely")),
+        0,
+        float(result.get("confidence") or 0.0),
+        0, 0, 0, 0,
+    )
+
+
+def wants_wire():
+    return DETECTION_WIRE_MIME in (request.headers.get("Accept") or "")
+
 
 @app.route("/health", methods=["GET"])
 def health():
@@ -54,6 +88,8 @@ def gpt_detect():
     except Exception:
         pass
 
+    if wants_wire() and isinstance(result, dict):
+        return Response(pack_detection(result), status=200, mimetype=DETECTION_WIRE_MIME)
     return jsonify(result), 200
 
 
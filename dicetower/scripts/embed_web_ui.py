@@ -0,0 +1,59 @@
+"""
+PlatformIO pre-build step for the esp32cam env: gzips web/index.html and
+writes it into src/esp32cam/web_ui.h as a flash-resident byte array, along
+with a strong ETag derived from the compressed bytes.
+
+The header is only rewritten when its content changes, so unchanged UI
+sources do not trigger a rebuild. Also runnable by hand:
+
+    python scripts/embed_web_ui.py
+"""
+
+import gzip
+import hashlib
+import os
+
+try:
+    Import("env")  # noqa: F821 (provided by PlatformIO/SCons)
+    PROJECT_DIR = env.subst("$PROJECT_DIR")  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+SOURCE = os.path.join(PROJECT_DIR, "web", "index.html")
+TARGET = os.path.join(PROJECT_DIR, "src", "esp32cam", "web_ui.h")
+
+
+def render_header(gz):
+    etag = hashlib.sha256(gz).hexdigest()[:16]
+    rows = []
+    for i in range(0, len(gz), 16):
+        rows.append("  " + ", ".join("0x%02x" % b for b in gz[i:i + 16]) + ",")
+    return (
+        "#pragma once\n"
+        "// Generated by scripts/embed_web_ui.py from web/index.html. Do not edit.\n"
+        "#include <Arduino.h>\n"
+        "\n"
+        "static const char kWebUiEtag[] = \"\\\"%s\\\"\";\n"
+        "static const size_t kWebUiGzLen = %d;\n"
+        "static const uint8_t kWebUiGz[] PROGMEM = {\n"
+        "%s\n"
+        "};\n" % (etag, len(gz), "\n".join(rows))
+    )
+
+
+def main():
+    with open(SOURCE, "rb") as f:
+        html = f.read()
+    # mtime=0 keeps the output (and so the ETag) stable across builds.
+    gz = gzip.compress(html, compresslevel=9, mtime=0)
+    text = render_header(gz)
+    if os.path.exists(TARGET):
+        with open(TARGET, "r") as f:
+            if f.read() == text:
+                return
+    with open(TARGET, "w") as f:
+        f.write(text)
+    print("web_ui.h: %d bytes -> %d gzipped" % (len(html), len(gz)))
+
+
+main()
@@ -5,6 +5,7 @@
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 #include "setup/led_strip.h"
+#include "shared/json_writer.h"
 
 static ESP8266WebServer httpServer(80);
 static bool blinkEnabled = false; // Not blinking by default (controlled via API)
@@ -26,6 +27,31 @@ static void handleOptions() {
   httpServer.send(204);
 }
 
+// Sends a JsonWriter body straight from its buffer (no String copy); answers
+// 500 instead if the body did not fit.
+static void sendJson(int code, const JsonWriter& w) {
+  addNoCacheAndCors();
+  if (!w.ok()) {
+    httpServer.send(500, "application/json", "{\"ok\":false,\"error\":\"response too large\"}");
+    return;
+  }
+  httpServer.send_P(code, "application/json", w.c_str(), w.length());
+}
+
+// Dotted quad into `out` (16 bytes) without IPAddress::toString()'s String.
+static const char* formatIp(const IPAddress& ip, char* out) {
+  char* p = out;
+  for (int i = 0; i < 4; ++i) {
+    uint8_t octet = ip[i];
+    if (octet >= 100) *p++ = (char)('0' + octet / 100);
+    if (octet >= 10) *p++ = (char)('0' + (octet / 10) % 10);
+    *p++ = (char)('0' + octet % 10);
+    if (i < 3) *p++ = '.';
+  }
+  *p = '\0';
+  return out;
+}
+
 // --- Provisioning storage ---
 struct WifiCredentials {
   String ssid;
@@ -153,13 +179,13 @@ static void handleBlinkToggle() {
     ledOn = false;
   }
   addNoCacheAndCors();
-  httpServer.send(200, "application/json", String("{\"ok\":true,\"blinking\":" ) + (blinkEnabled?"true":"false") + "}");
+  httpServer.send(200, "application/json", blinkEnabled ? "{\"ok\":true,\"blinking\":true}" : "{\"ok\":true,\"blinking\":false}");
 }
 
 static void handleStatus() {
   bool staConnected = (WiFi.status() == WL_CONNECTED);
   bool apEnabled = WiFi.getMode() & WIFI_AP;
-  String mode = "unknown";
+  const char* mode = "unknown";
   if (apEnabled && staConnected) {
     mode = "AP+STA";
   } else if (apEnabled) {
@@ -170,16 +196,21 @@ static void handleStatus() {
     mode = "OFF";
   }
   
-  String json = String("{\"blinking\":") + (blinkEnabled?"true":"false") + 
-                ",\"ledOn\":" + (ledOn?"true":"false") +
-                ",\"strip\":" + (stripEnabled?"true":"false") +
-                ",\"mode\":\"" + mode + "\"" +
-                ",\"staConnected\":" + (staConnected?"true":"false") +
-                ",\"staIp\":\"" + (staConnected ? WiFi.localIP().toString() : "") + "\"" +
-                ",\"apIp\":\"" + WiFi.softAPIP().toString() + "\"" +
-                "}";
-  addNoCacheAndCors();
-  httpServer.send(200, "application/json", json);
+  char buf[256];
+  char staIp[16];
+  char apIp[16];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginObject()
+    .add("blinking", blinkEnabled)
+    .add("ledOn", ledOn)
+    .add("strip", stripEnabled)
+    .add("mode", mode)
+    .add("staConnected", staConnected)
+    .add("staIp", staConnected ? formatIp(WiFi.localIP(), staIp) : "")
+    .add("apIp", formatIp(WiFi.softAPIP(), apIp))
+    .add("heapFree", ESP.getFreeHeap())
+    .endObject();
+  sendJson(200, w);
 }
 
 static void handleProvision() {
@@ -214,13 +245,17 @@ static void handleProvision() {
       Serial.print("AP SSID: "); Serial.println(apSsid);
     }
   }
-  String json = String("{\"ok\":") + (saved?"true":"false") + 
-                ",\"connected\":" + (connected?"true":"false") + 
-                ",\"ip\":\"" + (connected ? WiFi.localIP().toString() : "") + "\"" +
-                ",\"apOff\":" + (connected?"true":"false") +
-                ",\"name\":\"" + creds.name + "\"}";
-  addNoCacheAndCors();
-  httpServer.send(saved ? 200 : 500, "application/json", json);
+  char buf[192];
+  char ip[16];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginObject()
+    .add("ok", saved)
+    .add("connected", connected)
+    .add("ip", connected ? formatIp(WiFi.localIP(), ip) : "")
+    .add("apOff", connected)
+    .add("name", creds.name.c_str())
+    .endObject();
+  sendJson(saved ? 200 : 500, w);
 }
 
 static void handleWipe() {
@@ -229,7 +264,7 @@ static void handleWipe() {
     removed = LittleFS.remove(kCredsPath);
   }
   addNoCacheAndCors();
-  httpServer.send(200, "application/json", String("{\"ok\":" ) + (removed?"true":"false") + "}\nRebooting...");
+  httpServer.send(200, "application/json", removed ? "{\"ok\":true}\nRebooting..." : "{\"ok\":false}\nRebooting...");
   delay(200);
   ESP.restart();
 }
@@ -249,12 +284,16 @@ static void handleForceAp() {
   Serial.print("AP SSID: "); Serial.println(apSsid);
   Serial.print("AP IP: "); Serial.println(WiFi.softAPIP());
   
-  String json = String("{\"ok\":") + (apOk?"true":"false") +
-                ",\"ap\":true" +
-                ",\"ssid\":\"" + apSsid + "\"" +
-                ",\"ip\":\"" + WiFi.softAPIP().toString() + "\"}";
-  addNoCacheAndCors();
-  httpServer.send(apOk ? 200 : 500, "application/json", json);
+  char buf[160];
+  char ip[16];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginObject()
+    .add("ok", apOk)
+    .add("ap", true)
+    .add("ssid", apSsid.c_str())
+    .add("ip", formatIp(WiFi.softAPIP(), ip))
+    .endObject();
+  sendJson(apOk ? 200 : 500, w);
 }
 
 static void handleName() {
@@ -263,8 +302,10 @@ static void handleName() {
   if (action == "get") {
     WifiCredentials creds;
     if (loadCredentials(creds)) {
-      addNoCacheAndCors();
-      httpServer.send(200, "application/json", String("{\"ok\":true,\"name\":\"") + creds.name + "\"}");
+      char buf[128];
+      JsonWriter w(buf, sizeof(buf));
+      w.beginObject().add("ok", true).add("name", creds.name.c_str()).endObject();
+      sendJson(200, w);
     } else {
       addNoCacheAndCors();
       httpServer.send(200, "application/json", "{\"ok\":true,\"name\":\"\"}");
@@ -275,8 +316,10 @@ static void handleName() {
     if (loadCredentials(creds)) {
       creds.name = newName;
       bool saved = saveCredentials(creds);
-      addNoCacheAndCors();
-      httpServer.send(saved ? 200 : 500, "application/json", String("{\"ok\":") + (saved?"true":"false") + ",\"name\":\"" + newName + "\"}");
+      char buf[128];
+      JsonWriter w(buf, sizeof(buf));
+      w.beginObject().add("ok", saved).add("name", newName.c_str()).endObject();
+      sendJson(saved ? 200 : 500, w);
     } else {
       addNoCacheAndCors();
       httpServer.send(404, "application/json", "{\"ok\":false,\"error\":\"no credentials found\"}");
@@ -393,7 +436,7 @@ void setup() {
     stripEnabled = !stripEnabled;
     if (!stripEnabled) { ledStripAllOff(); }
     addNoCacheAndCors();
-    httpServer.send(200, "application/json", String("{\"ok\":true,\"strip\":" ) + (stripEnabled?"true":"false") + "}");
+    httpServer.send(200, "application/json", stripEnabled ? "{\"ok\":true,\"strip\":true}" : "{\"ok\":true,\"strip\":false}");
   });
   httpServer.on("/strip/toggle", HTTP_OPTIONS, handleOptions);
   httpServer.on("/strip/mode/toggle", [](){
@@ -401,7 +444,7 @@ void setup() {
     LedStripMode next = (cur == LED_MODE_GLOW) ? LED_MODE_CHASE : LED_MODE_GLOW;
     ledStripSetMode(next);
     addNoCacheAndCors();
-    httpServer.send(200, "application/json", String("{\"ok\":true,\"mode\":\"") + (next==LED_MODE_GLOW?"glow":"chase") + "\"}");
+    httpServer.send(200, "application/json", next == LED_MODE_GLOW ? "{\"ok\":true,\"mode\":\"glow\"}" : "{\"ok\":true,\"mode\":\"chase\"}");
   });
   httpServer.on("/strip/mode/toggle", HTTP_OPTIONS, handleOptions);
   httpServer.on("/strip/mode/glow", [](){
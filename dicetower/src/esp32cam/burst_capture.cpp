@@ -0,0 +1,215 @@
+#include "burst_capture.h"
+#include <string.h>
+#include "freertos/semphr.h"
+#include "detect_pipeline.h"
+#include "frame_pool.h"
+
+static const float kMissWeight = 0.5f;   // A frame that found no die counts against the winner this much
+
+// Running confidence-weighted vote over one burst.
+struct BurstVote {
+  float weight[kDetectionMaxFace + 1];
+  int votes[kDetectionMaxFace + 1];
+  DiceDetection best[kDetectionMaxFace + 1];  // Highest-confidence reading per value
+  DetectionSource bestSource[kDetectionMaxFace + 1];
+  int readings;
+  int misses;
+  int leadValue;  // Value shared by every reading so far, 0 once they disagree
+};
+
+static BurstConfig gConfig = {1, 2, 0.6f};
+static BurstStats gStats = {};
+static SemaphoreHandle_t gRunLock = nullptr;
+static portMUX_TYPE gBurstMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void voteAdd(BurstVote& vote, const PipelineReading& r, const BurstConfig& cfg) {
+  int value = r.detection.value;
+  bool counted = r.detection.detected && value >= 1 && value <= kDetectionMaxFace;
+  vote.readings++;
+  if (!counted) {
+    vote.misses++;
+    vote.leadValue = 0;
+    return;
+  }
+  vote.weight[value] += r.detection.confidence;
+  vote.votes[value]++;
+  if (vote.votes[value] == 1 || r.detection.confidence > vote.best[value].confidence) {
+    vote.best[value] = r.detection;
+    vote.bestSource[value] = r.source;
+  }
+  bool sure = r.detection.confidence >= cfg.minConfidence;
+  if (vote.readings == 1) {
+    vote.leadValue = sure ? value : 0;
+  } else if (vote.leadValue != value || !sure) {
+    vote.leadValue = 0;
+  }
+}
+
+// The first agreeFrames readings all named the same value with confidence.
+static bool voteSettled(const BurstVote& vote, const BurstConfig& cfg) {
+  return vote.leadValue != 0 && vote.readings >= cfg.agreeFrames;
+}
+
+static void voteResult(const BurstVote& vote, BurstResult& out) {
+  int winner = 0;
+  int runnerUp = 0;
+  float total = vote.misses * kMissWeight;
+  for (int v = 1; v <= kDetectionMaxFace; ++v) {
+    total += vote.weight[v];
+    if (!vote.votes[v]) continue;
+    if (!winner || vote.weight[v] > vote.weight[winner]) {
+      runnerUp = winner;
+      winner = v;
+    } else if (!runnerUp || vote.weight[v] > vote.weight[runnerUp]) {
+      runnerUp = v;
+    }
+  }
+
+  memset(&out.detection, 0, sizeof(out.detection));
+  out.source = DETECTION_SOURCE_LOCAL;
+  out.agreement = 0.0f;
+  out.detected = vote.readings - vote.misses;
+  out.votes = winner ? vote.votes[winner] : 0;
+  if (!winner) return;
+
+  out.agreement = total > 0.0f ? vote.weight[winner] / total : 0.0f;
+  out.detection = vote.best[winner];
+  out.source = vote.bestSource[winner];
+  // Mean confidence of the agreeing frames, scaled down by the dissent.
+  out.detection.confidence = vote.weight[winner] / vote.votes[winner] * out.agreement;
+  out.detection.detected = out.agreement >= 0.5f;
+  if (runnerUp) out.detection.second_most_likely = runnerUp;
+}
+
+bool burstBegin() {
+  if (!gRunLock) gRunLock = xSemaphoreCreateMutex();
+  return gRunLock != nullptr;
+}
+
+void burstConfigure(const BurstConfig& config) {
+  portENTER_CRITICAL(&gBurstMux);
+  gConfig = config;
+  if (gConfig.frames < 1) gConfig.frames = 1;
+  if (gConfig.frames > kBurstMaxFrames) gConfig.frames = kBurstMaxFrames;
+  if (gConfig.agreeFrames < 1) gConfig.agreeFrames = 1;
+  if (gConfig.agreeFrames > gConfig.frames) gConfig.agreeFrames = gConfig.frames;
+  if (gConfig.minConfidence < 0.0f) gConfig.minConfidence = 0.0f;
+  if (gConfig.minConfidence > 1.0f) gConfig.minConfidence = 1.0f;
+  portEXIT_CRITICAL(&gBurstMux);
+}
+
+void burstGetConfig(BurstConfig& out) {
+  portENTER_CRITICAL(&gBurstMux);
+  out = gConfig;
+  portEXIT_CRITICAL(&gBurstMux);
+}
+
+bool burstRun(PipelineFrame* first, BurstResult& out) {
+  memset(&out, 0, sizeof(out));
+  if (!gRunLock) {
+    if (first) framePoolRelease(first->jpeg);
+    return false;
+  }
+  BurstConfig cfg;
+  burstGetConfig(cfg);
+
+  xSemaphoreTake(gRunLock, portMAX_DELAY);
+  uint32_t startMs = millis();
+  BurstVote vote;
+  memset(&vote, 0, sizeof(vote));
+  PipelineReading single;
+  memset(&single, 0, sizeof(single));
+  int requested = 0;
+  int inFlight = 0;
+  int skipped = 0;
+  uint32_t captureFailures = 0;
+  bool settled = false;
+  bool failed = false;
+
+  while (requested < cfg.frames && !settled && !failed) {
+    // Backpressure: with a frame in every stage, wait for a reading before
+    // asking for another.
+    PipelineReading r;
+    while (inFlight > 0 && pipelineNextReading(r, inFlight >= kPipelineMaxInFlight ? portMAX_DELAY : 0)) {
+      inFlight--;
+      if (!r.captured) {
+        captureFailures++;
+        failed = true;
+        continue;
+      }
+      out.captured++;
+      single = r;
+      voteAdd(vote, r, cfg);
+      settled = settled || voteSettled(vote, cfg);
+    }
+    if (settled || failed) break;
+
+    if (requested == 0 && first) {
+      pipelineSubmit(*first);  // Still yields a (not captured) reading without a lease
+    } else if (!pipelineRequestCapture()) {
+      break;
+    }
+    requested++;
+    inFlight++;
+  }
+
+  // Frames still in the pipeline behind an early exit come back unread; after
+  // a failed capture the ones already taken are still read.
+  pipelineSkip(settled);
+  while (inFlight > 0) {
+    PipelineReading r;
+    if (!pipelineNextReading(r, portMAX_DELAY)) break;
+    inFlight--;
+    if (r.skipped) {
+      skipped++;
+      if (r.captured) out.captured++;
+      continue;
+    }
+    if (!r.captured) {
+      captureFailures++;
+      continue;
+    }
+    out.captured++;
+    single = r;
+    voteAdd(vote, r, cfg);
+    if (!settled && voteSettled(vote, cfg)) {
+      settled = true;
+      pipelineSkip(true);
+    }
+  }
+  pipelineSkip(false);
+  out.earlyExit = settled && (requested < cfg.frames || skipped > 0);
+
+  if (cfg.frames > 1) {
+    voteResult(vote, out);
+  } else {
+    // Nothing to vote on; pass the one reading through as read.
+    out.detection = single.detection;
+    out.source = single.source;
+    out.detected = single.detection.detected ? 1 : 0;
+    out.votes = out.detected;
+    out.agreement = single.detection.detected ? 1.0f : 0.0f;
+  }
+  out.elapsedMs = millis() - startMs;
+  xSemaphoreGive(gRunLock);
+
+  if (cfg.frames > 1) {
+    portENTER_CRITICAL(&gBurstMux);
+    gStats.bursts++;
+    gStats.frames += out.captured;
+    gStats.skipped += skipped;
+    gStats.captureFailures += captureFailures;
+    if (out.earlyExit) gStats.earlyExits++;
+    gStats.lastFrames = out.captured;
+    gStats.lastAgreement = out.agreement;
+    gStats.lastMs = out.elapsedMs;
+    portEXIT_CRITICAL(&gBurstMux);
+  }
+  return out.captured > 0;
+}
+
+void burstGetStats(BurstStats& out) {
+  portENTER_CRITICAL(&gBurstMux);
+  out = gStats;
+  portEXIT_CRITICAL(&gBurstMux);
+}
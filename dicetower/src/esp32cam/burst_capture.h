@@ -0,0 +1,58 @@
+#pragma once
+#include <Arduino.h>
+#include "dice_detection.h"
+#include "detection_history.h"
+#include "detect_pipeline.h"
+
+// Burst detection: grab several consecutive frames and fuse their readings,
+// so one blurred or glared frame cannot decide the roll on its own. Frames
+// go through detect_pipeline, so the next capture overlaps the current upload
+// or inference. Readings are combined by confidence-weighted voting; when the
+// first frames already agree the rest of the burst is skipped. A one-frame
+// "burst" is plain single-shot detection through the same pipeline.
+
+static const int kBurstMaxFrames = 8;
+
+struct BurstConfig {
+  int frames;           // Frames per burst; 1 turns bursts off
+  int agreeFrames;      // Leading readings that must agree to stop early
+  float minConfidence;  // Each of those readings must reach this confidence
+};
+
+struct BurstResult {
+  DiceDetection detection;  // Fused reading (box from the best agreeing frame)
+  DetectionSource source;   // Source of that frame
+  float agreement;          // Winning weight / all weight, misses included (0..1)
+  int captured;
+  int detected;             // Frames whose reading went into the vote
+  int votes;                // Frames that voted for the winning value
+  bool earlyExit;
+  uint32_t elapsedMs;
+};
+
+struct BurstStats {
+  uint32_t bursts;
+  uint32_t frames;          // Captured
+  uint32_t skipped;         // Captured but dropped after an early exit
+  uint32_t earlyExits;
+  uint32_t captureFailures; // No camera frame or no free pool slot
+  int lastFrames;
+  float lastAgreement;
+  uint32_t lastMs;
+};
+
+// Call after pipelineBegin().
+bool burstBegin();
+
+void burstConfigure(const BurstConfig& config);
+void burstGetConfig(BurstConfig& out);
+
+// Runs one burst (one at a time; concurrent callers wait). `first`, if set,
+// is a pipelineLease() copy of a frame the caller already captured; the burst
+// takes the lease over and counts it as its first frame. The rest are
+// captured by the pipeline. Returns false if not a single frame could be
+// captured.
+bool burstRun(PipelineFrame* first, BurstResult& out);
+
+// Counts multi-frame bursts only.
+void burstGetStats(BurstStats& out);
@@ -0,0 +1,201 @@
+#include "camera_mode.h"
+#include <string.h>
+#include "freertos/semphr.h"
+#include "frame_pool.h"
+
+static const uint32_t kGatePollMs = 2;
+static const uint32_t kFirstFrameTimeoutMs = 2000;
+static const int kTrailerScan = 16;  // Bytes searched from the end for the EOI marker
+
+static const CameraMode kModes[kCameraModeCount] = {
+  {FRAMESIZE_QQVGA, "QQVGA", 160, 120},
+  {FRAMESIZE_QVGA, "QVGA", 320, 240},
+  {FRAMESIZE_CIF, "CIF", 400, 296},
+  {FRAMESIZE_VGA, "VGA", 640, 480},
+  {FRAMESIZE_SVGA, "SVGA", 800, 600},
+  {FRAMESIZE_XGA, "XGA", 1024, 768},
+  {FRAMESIZE_HD, "HD", 1280, 720},
+  {FRAMESIZE_SXGA, "SXGA", 1280, 1024},
+  {FRAMESIZE_UXGA, "UXGA", 1600, 1200},
+};
+
+static int gMaxMode = 1;
+static volatile int gCurrentMode = 1;
+static CameraModeFlushFn gFlush = nullptr;
+static bool gPaused = false;
+static int gOutstanding = 0;  // Frames handed out through the gate
+static CameraModeStats gStats = {};
+static SemaphoreHandle_t gSwitchLock = nullptr;
+static portMUX_TYPE gGateMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void setPaused(bool paused) {
+  portENTER_CRITICAL(&gGateMux);
+  gPaused = paused;
+  portEXIT_CRITICAL(&gGateMux);
+}
+
+static void noteRejected() {
+  portENTER_CRITICAL(&gGateMux);
+  gStats.rejected++;
+  portEXIT_CRITICAL(&gGateMux);
+}
+
+static int outstanding() {
+  portENTER_CRITICAL(&gGateMux);
+  int n = gOutstanding;
+  portEXIT_CRITICAL(&gGateMux);
+  return n;
+}
+
+// SOI at the start and EOI near the end; the frame at the moment of a size
+// change can be cut short.
+static bool frameWhole(const camera_fb_t* fb, const CameraMode& mode) {
+  if (fb->format != PIXFORMAT_JPEG) return fb->width == mode.width && fb->height == mode.height;
+  if (fb->width != mode.width || fb->height != mode.height || fb->len < 4) return false;
+  if (fb->buf[0] != 0xFF || fb->buf[1] != 0xD8) return false;
+  size_t from = fb->len > kTrailerScan ? fb->len - kTrailerScan : 0;
+  for (size_t i = fb->len - 1; i > from; --i) {
+    if (fb->buf[i - 1] == 0xFF && fb->buf[i] == 0xD9) return true;
+  }
+  return false;
+}
+
+const CameraMode& cameraModeInfo(int mode) {
+  if (mode < 0) mode = 0;
+  if (mode >= kCameraModeCount) mode = kCameraModeCount - 1;
+  return kModes[mode];
+}
+
+int cameraModeFind(const char* name) {
+  if (!name) return -1;
+  for (int i = 0; i < kCameraModeCount; ++i) {
+    if (strcasecmp(name, kModes[i].name) == 0) return i;
+  }
+  return -1;
+}
+
+size_t cameraModeBudgetBytes(int mode, int driverFrameBuffers) {
+  const CameraMode& m = cameraModeInfo(mode);
+  size_t pixels = (size_t)m.width * m.height;
+  // esp32-camera sizes each JPEG frame buffer at a fifth of a byte per pixel.
+  return (size_t)driverFrameBuffers * (pixels / 5) + framePoolBytesFor(m.width, m.height);
+}
+
+int cameraModeLargestFitting(size_t psramBytes, int driverFrameBuffers) {
+  int best = 0;
+  for (int i = 0; i < kCameraModeCount; ++i) {
+    if (cameraModeBudgetBytes(i, driverFrameBuffers) <= psramBytes) best = i;
+  }
+  return best;
+}
+
+void cameraModeBegin(int maxMode, int currentMode, CameraModeFlushFn flush) {
+  if (!gSwitchLock) gSwitchLock = xSemaphoreCreateMutex();
+  gMaxMode = maxMode < 0 ? 0 : (maxMode >= kCameraModeCount ? kCameraModeCount - 1 : maxMode);
+  gCurrentMode = currentMode < 0 ? 0 : (currentMode > gMaxMode ? gMaxMode : currentMode);
+  gFlush = flush;
+}
+
+int cameraModeMax() {
+  return gMaxMode;
+}
+
+int cameraModeCurrent() {
+  return gCurrentMode;
+}
+
+camera_fb_t* cameraFrameGet() {
+  for (;;) {
+    portENTER_CRITICAL(&gGateMux);
+    bool open = !gPaused;
+    if (open) gOutstanding++;
+    portEXIT_CRITICAL(&gGateMux);
+    if (open) break;
+    vTaskDelay(pdMS_TO_TICKS(kGatePollMs));
+  }
+  camera_fb_t* fb = esp_camera_fb_get();
+  if (!fb) {
+    portENTER_CRITICAL(&gGateMux);
+    gOutstanding--;
+    portEXIT_CRITICAL(&gGateMux);
+  }
+  return fb;
+}
+
+void cameraFrameReturn(camera_fb_t* fb) {
+  if (!fb) return;
+  esp_camera_fb_return(fb);
+  portENTER_CRITICAL(&gGateMux);
+  gOutstanding--;
+  portEXIT_CRITICAL(&gGateMux);
+}
+
+bool cameraModeSwitch(int mode, uint32_t drainTimeoutMs, const char** error) {
+  if (mode < 0 || mode > gMaxMode || !gSwitchLock) {
+    *error = "frame size exceeds the memory budget";
+    noteRejected();
+    return false;
+  }
+  xSemaphoreTake(gSwitchLock, portMAX_DELAY);
+  if (mode == gCurrentMode) {
+    xSemaphoreGive(gSwitchLock);
+    return true;
+  }
+
+  uint32_t startMs = millis();
+  setPaused(true);
+  while (outstanding() > 0 && millis() - startMs < drainTimeoutMs) vTaskDelay(pdMS_TO_TICKS(kGatePollMs));
+  if (outstanding() > 0) {
+    setPaused(false);
+    noteRejected();
+    xSemaphoreGive(gSwitchLock);
+    *error = "camera busy";
+    return false;
+  }
+  uint32_t drainMs = millis() - startMs;
+
+  const CameraMode& target = kModes[mode];
+  sensor_t* s = esp_camera_sensor_get();
+  if (!s || s->set_framesize(s, target.size) != 0) {
+    setPaused(false);
+    noteRejected();
+    xSemaphoreGive(gSwitchLock);
+    *error = "sensor rejected frame size";
+    return false;
+  }
+  gCurrentMode = mode;
+  if (gFlush) gFlush();
+
+  // Frames already queued in the driver are still at the old size, and the
+  // one in flight during the change can be torn.
+  uint32_t setMs = millis();
+  uint32_t discarded = 0;
+  bool good = false;
+  while (!good && millis() - setMs < kFirstFrameTimeoutMs) {
+    camera_fb_t* fb = esp_camera_fb_get();
+    if (!fb) continue;
+    good = frameWhole(fb, target);
+    esp_camera_fb_return(fb);
+    if (!good) discarded++;
+  }
+  uint32_t firstFrameMs = millis() - setMs;
+  uint32_t switchMs = millis() - startMs;
+
+  portENTER_CRITICAL(&gGateMux);
+  gPaused = false;
+  gStats.switches++;
+  gStats.discarded += discarded;
+  gStats.lastDrainMs = drainMs;
+  gStats.lastFirstFrameMs = firstFrameMs;
+  gStats.lastSwitchMs = switchMs;
+  if (!good) gStats.firstFrameTimeouts++;
+  portEXIT_CRITICAL(&gGateMux);
+  xSemaphoreGive(gSwitchLock);
+  return true;
+}
+
+void cameraModeGetStats(CameraModeStats& out) {
+  portENTER_CRITICAL(&gGateMux);
+  out = gStats;
+  portEXIT_CRITICAL(&gGateMux);
+}
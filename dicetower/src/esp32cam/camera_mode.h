@@ -0,0 +1,69 @@
+#pragma once
+#include <Arduino.h>
+#include "esp_camera.h"
+
+// Frame-size modes and the gate every camera user takes frames through.
+//
+// The driver's JPEG buffers and the frame pool are sized once, at boot, for
+// the largest mode that fits the PSRAM budget; any mode up to it can then be
+// selected at runtime without reallocating. A switch closes the gate, waits
+// for every frame handed out to come back, changes the sensor size, discards
+// frames until one arrives whole at the new size, and reopens the gate, so no
+// consumer (stream, roll-settle, detection) sees a torn or mis-sized frame.
+
+struct CameraMode {
+  framesize_t size;
+  const char* name;
+  uint16_t width;
+  uint16_t height;
+};
+
+static const int kCameraModeCount = 9;  // QQVGA .. UXGA, ascending
+
+struct CameraModeStats {
+  uint32_t switches;
+  uint32_t rejected;          // Over budget, drain timed out, or the sensor refused
+  uint32_t discarded;         // Frames dropped after switches before a good one arrived
+  uint32_t lastDrainMs;       // Gate closed until every frame was back
+  uint32_t lastFirstFrameMs;  // New size set until the first good frame
+  uint32_t lastSwitchMs;      // Gate closed until it reopened
+  uint32_t firstFrameTimeouts;  // Switches that reopened without a good frame at the new size
+};
+
+// Called with the gate closed after the size changed; drops anything a
+// consumer buffered at the old size (stream_hub's newest frame).
+typedef void (*CameraModeFlushFn)();
+
+const CameraMode& cameraModeInfo(int mode);
+
+// Mode index by name ("VGA"), or -1.
+int cameraModeFind(const char* name);
+
+// PSRAM needed to make `mode` the largest selectable one: the driver's JPEG
+// frame buffers plus the frame pool.
+size_t cameraModeBudgetBytes(int mode, int driverFrameBuffers);
+
+// Largest mode whose budget fits in `psramBytes` (at least QQVGA).
+int cameraModeLargestFitting(size_t psramBytes, int driverFrameBuffers);
+
+// Records the selectable range and the mode the sensor is set to. Call once
+// the camera is initialized.
+void cameraModeBegin(int maxMode, int currentMode, CameraModeFlushFn flush);
+
+int cameraModeMax();
+int cameraModeCurrent();
+
+// esp_camera_fb_get / esp_camera_fb_return through the gate. Get waits while
+// a switch is in progress.
+camera_fb_t* cameraFrameGet();
+void cameraFrameReturn(camera_fb_t* fb);
+
+// Switches the sensor to `mode`. Frames still out after drainTimeoutMs, or a
+// sensor that refuses the size, fail the switch (error set, gate reopened,
+// size unchanged). Once the sensor has taken the size the switch succeeds;
+// if no whole frame arrives in time the gate reopens anyway and
+// firstFrameTimeouts counts it. Must not be called while holding a frame.
+// Loop task only, like every other sensor register write.
+bool cameraModeSwitch(int mode, uint32_t drainTimeoutMs, const char** error);
+
+void cameraModeGetStats(CameraModeStats& out);
@@ -0,0 +1,167 @@
+#include "camera_sensor.h"
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+
+static const char* kSettingsPath = "/camera_sensor.json";
+static const uint32_t kQuietMs = 80;       // Write once requests pause this long...
+static const uint32_t kMaxHoldMs = 250;    // ...or once the oldest has waited this long (drag preview)
+static const uint32_t kSaveDelayMs = 2000; // Flash write after settings stop changing
+
+struct SensorFieldInfo {
+  const char* key;
+  int16_t min;
+  int16_t max;
+  int16_t def;
+};
+
+// Defaults are the tower's tuning for a lit tray (grayscale output).
+static const SensorFieldInfo kFields[SENSOR_FIELD_COUNT] = {
+  {"brightness", -2, 2, 2},
+  {"contrast", -2, 2, 1},
+  {"saturation", -2, 2, 1},
+  {"special_effect", 0, 6, 2},   // 2 = Grayscale
+  {"whitebal", 0, 1, 1},
+  {"awb_gain", 0, 1, 1},
+  {"wb_mode", 0, 4, 0},          // 0 Auto, 1 Sunny, 2 Cloudy, 3 Office, 4 Home (with awb_gain)
+  {"exposure_ctrl", 0, 1, 1},
+  {"aec2", 0, 1, 0},
+  {"ae_level", -2, 2, 2},
+  {"aec_value", 0, 1200, 600},
+  {"gain_ctrl", 0, 1, 1},
+  {"agc_gain", 0, 30, 0},
+  {"gainceiling", 0, 6, 2},
+  {"bpc", 0, 1, 0},
+  {"wpc", 0, 1, 1},
+  {"raw_gma", 0, 1, 1},
+  {"lenc", 0, 1, 1},
+  {"hmirror", 0, 1, 0},
+  {"vflip", 0, 1, 0},
+  {"dcw", 0, 1, 1},
+  {"colorbar", 0, 1, 0},
+};
+
+static int16_t gDesired[SENSOR_FIELD_COUNT];
+static int16_t gApplied[SENSOR_FIELD_COUNT];
+static uint32_t gPendingSinceMs = 0;  // 0: nothing pending
+static uint32_t gLastChangeMs = 0;
+static bool gUnsaved = false;
+static CameraSensorStats gStats = {};
+
+static int writeField(sensor_t* s, SensorField field, int v) {
+  switch (field) {
+    case SENSOR_BRIGHTNESS: return s->set_brightness(s, v);
+    case SENSOR_CONTRAST: return s->set_contrast(s, v);
+    case SENSOR_SATURATION: return s->set_saturation(s, v);
+    case SENSOR_SPECIAL_EFFECT: return s->set_special_effect(s, v);
+    case SENSOR_WHITEBAL: return s->set_whitebal(s, v);
+    case SENSOR_AWB_GAIN: return s->set_awb_gain(s, v);
+    case SENSOR_WB_MODE: return s->set_wb_mode(s, v);
+    case SENSOR_EXPOSURE_CTRL: return s->set_exposure_ctrl(s, v);
+    case SENSOR_AEC2: return s->set_aec2(s, v);
+    case SENSOR_AE_LEVEL: return s->set_ae_level(s, v);
+    case SENSOR_AEC_VALUE: return s->set_aec_value(s, v);
+    case SENSOR_GAIN_CTRL: return s->set_gain_ctrl(s, v);
+    case SENSOR_AGC_GAIN: return s->set_agc_gain(s, v);
+    case SENSOR_GAINCEILING: return s->set_gainceiling(s, (gainceiling_t)v);
+    case SENSOR_BPC: return s->set_bpc(s, v);
+    case SENSOR_WPC: return s->set_wpc(s, v);
+    case SENSOR_RAW_GMA: return s->set_raw_gma(s, v);
+    case SENSOR_LENC: return s->set_lenc(s, v);
+    case SENSOR_HMIRROR: return s->set_hmirror(s, v);
+    case SENSOR_VFLIP: return s->set_vflip(s, v);
+    case SENSOR_DCW: return s->set_dcw(s, v);
+    case SENSOR_COLORBAR: return s->set_colorbar(s, v);
+    default: return -1;
+  }
+}
+
+static int16_t clampField(SensorField field, int v) {
+  const SensorFieldInfo& f = kFields[field];
+  return (int16_t)(v < f.min ? f.min : (v > f.max ? f.max : v));
+}
+
+static void applyField(sensor_t* s, SensorField field) {
+  gStats.writes++;
+  if (writeField(s, field, gDesired[field]) != 0) gStats.failures++;
+  gApplied[field] = gDesired[field];
+}
+
+static bool saveSettings() {
+  JsonDocument doc;
+  for (int i = 0; i < SENSOR_FIELD_COUNT; ++i) doc[kFields[i].key] = gDesired[i];
+  File f = LittleFS.open(kSettingsPath, "w");
+  if (!f) return false;
+  bool ok = (serializeJson(doc, f) > 0);
+  f.close();
+  return ok;
+}
+
+const char* cameraSensorKey(SensorField field) {
+  return field < SENSOR_FIELD_COUNT ? kFields[field].key : "";
+}
+
+void cameraSensorLoad() {
+  for (int i = 0; i < SENSOR_FIELD_COUNT; ++i) gDesired[i] = kFields[i].def;
+  if (!LittleFS.exists(kSettingsPath)) return;
+  File f = LittleFS.open(kSettingsPath, "r");
+  if (!f) return;
+  JsonDocument doc;
+  DeserializationError err = deserializeJson(doc, f);
+  f.close();
+  if (err) return;
+  for (int i = 0; i < SENSOR_FIELD_COUNT; ++i) {
+    if (doc[kFields[i].key].is<int>()) gDesired[i] = clampField((SensorField)i, doc[kFields[i].key].as<int>());
+  }
+}
+
+void cameraSensorApplyAll(sensor_t* s) {
+  if (!s) return;
+  for (int i = 0; i < SENSOR_FIELD_COUNT; ++i) applyField(s, (SensorField)i);
+  gPendingSinceMs = 0;
+}
+
+bool cameraSensorSet(SensorField field, int value) {
+  if (field >= SENSOR_FIELD_COUNT) return false;
+  int16_t v = clampField(field, value);
+  if (v == gDesired[field]) {
+    gStats.unchanged++;
+    return false;
+  }
+  if (gDesired[field] != gApplied[field]) gStats.coalesced++;
+  gDesired[field] = v;
+  uint32_t now = millis();
+  gLastChangeMs = now;
+  if (!gPendingSinceMs) gPendingSinceMs = now ? now : 1;
+  gUnsaved = true;
+  return true;
+}
+
+int cameraSensorGet(SensorField field) {
+  return field < SENSOR_FIELD_COUNT ? gDesired[field] : 0;
+}
+
+void cameraSensorPoll() {
+  uint32_t now = millis();
+  if (gPendingSinceMs && (now - gLastChangeMs >= kQuietMs || now - gPendingSinceMs >= kMaxHoldMs)) {
+    sensor_t* s = esp_camera_sensor_get();
+    if (s) {
+      for (int i = 0; i < SENSOR_FIELD_COUNT; ++i) {
+        if (gDesired[i] != gApplied[i]) applyField(s, (SensorField)i);
+      }
+    }
+    gPendingSinceMs = 0;
+  }
+  if (gUnsaved && !gPendingSinceMs && now - gLastChangeMs >= kSaveDelayMs) {
+    // A failed save is retried on the next change, not every loop.
+    gUnsaved = false;
+    if (saveSettings()) gStats.saves++;
+  }
+}
+
+void cameraSensorGetStats(CameraSensorStats& out) {
+  out = gStats;
+  out.pending = 0;
+  for (int i = 0; i < SENSOR_FIELD_COUNT; ++i) {
+    if (gDesired[i] != gApplied[i]) out.pending++;
+  }
+}
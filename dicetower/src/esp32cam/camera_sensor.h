@@ -0,0 +1,70 @@
+#pragma once
+#include <Arduino.h>
+#include "esp_camera.h"
+
+// Cached OV2640 image settings. The driver has no cheap getters and every
+// set_* call is an SCCB transaction that can stall a frame, so the desired
+// value of each register lives here: /camera/settings reads the cache, writes
+// only touch fields whose value actually changed, and a burst of changes (a
+// slider drag) is coalesced into one write per field. Settings are saved to
+// LittleFS once they stop changing and re-applied by initCamera at boot.
+//
+// Loop task only (HTTP handlers and cameraSensorPoll()); no locking.
+
+enum SensorField {
+  SENSOR_BRIGHTNESS = 0,
+  SENSOR_CONTRAST,
+  SENSOR_SATURATION,
+  SENSOR_SPECIAL_EFFECT,
+  SENSOR_WHITEBAL,
+  SENSOR_AWB_GAIN,
+  SENSOR_WB_MODE,
+  SENSOR_EXPOSURE_CTRL,
+  SENSOR_AEC2,
+  SENSOR_AE_LEVEL,
+  SENSOR_AEC_VALUE,
+  SENSOR_GAIN_CTRL,
+  SENSOR_AGC_GAIN,
+  SENSOR_GAINCEILING,
+  SENSOR_BPC,
+  SENSOR_WPC,
+  SENSOR_RAW_GMA,
+  SENSOR_LENC,
+  SENSOR_HMIRROR,
+  SENSOR_VFLIP,
+  SENSOR_DCW,
+  SENSOR_COLORBAR,
+  SENSOR_FIELD_COUNT
+};
+
+struct CameraSensorStats {
+  uint32_t writes;      // SCCB writes issued
+  uint32_t failures;    // Writes the driver rejected
+  uint32_t unchanged;   // Requests for the value already set (no write)
+  uint32_t coalesced;   // Values replaced before they were written
+  uint32_t saves;
+  uint8_t pending;      // Fields waiting for the debounce window
+};
+
+// JSON key (/camera/settings, the settings file) of a field.
+const char* cameraSensorKey(SensorField field);
+
+// Defaults, overridden by whatever the settings file holds. Call before
+// cameraSensorApplyAll().
+void cameraSensorLoad();
+
+// Writes every field (boot, after esp_camera_init).
+void cameraSensorApplyAll(sensor_t* s);
+
+// Requests a value (clamped to the field's range). Returns false when it is
+// already the desired value. The register is written by cameraSensorPoll().
+bool cameraSensorSet(SensorField field, int value);
+
+// Desired value: what the sensor holds, or will within the debounce window.
+int cameraSensorGet(SensorField field);
+
+// Writes pending fields once requests have paused, and saves the settings
+// once they have stayed unchanged for a while. Call from loop().
+void cameraSensorPoll();
+
+void cameraSensorGetStats(CameraSensorStats& out);
@@ -0,0 +1,135 @@
+#include "detect_jobs.h"
+#include <string.h>
+#include "freertos/queue.h"
+
+static const uint32_t kTaskStack = 8192;  // HTTPClient + ArduinoJson, as on the roll-settle task
+static const int kQueueDepth = 4;
+static const int kMaxJobs = 8;            // Finished jobs stay readable until overwritten
+static const uint32_t kWaitPollMs = 10;
+
+static DetectJob gJobs[kMaxJobs];
+static uint32_t gNextId = 1;
+static DetectJobRunFn gRun = nullptr;
+static QueueHandle_t gQueue = nullptr;
+static TaskHandle_t gTask = nullptr;
+static portMUX_TYPE gJobsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static DetectJob* slotFor(uint32_t id) {
+  return &gJobs[id % kMaxJobs];
+}
+
+static void jobsTask(void*) {
+  for (;;) {
+    uint32_t id = 0;
+    if (xQueueReceive(gQueue, &id, portMAX_DELAY) != pdTRUE) continue;
+
+    DetectJob* job = slotFor(id);
+    DetectJobKind kind;
+    portENTER_CRITICAL(&gJobsMux);
+    bool live = job->id == id;
+    kind = job->kind;
+    if (live) {
+      job->state = DETECT_JOB_RUNNING;
+      job->startedMs = millis();
+    }
+    portEXIT_CRITICAL(&gJobsMux);
+    if (!live) continue;
+
+    DetectJob work;
+    memset(&work, 0, sizeof(work));
+    work.frames = 1;
+    work.agreement = 1.0f;
+    const char* error = nullptr;
+    bool ran = gRun(kind, work, &error);
+
+    portENTER_CRITICAL(&gJobsMux);
+    job->result = work.result;
+    job->seq = work.seq;
+    job->frames = work.frames;
+    job->agreement = work.agreement;
+    job->state = ran ? DETECT_JOB_DONE : DETECT_JOB_FAILED;
+    job->error = ran ? nullptr : (error ? error : "detection failed");
+    job->finishedMs = millis();
+    portEXIT_CRITICAL(&gJobsMux);
+  }
+}
+
+bool detectJobsBegin(DetectJobRunFn run) {
+  gRun = run;
+  if (!gQueue) gQueue = xQueueCreate(kQueueDepth, sizeof(uint32_t));
+  if (!gQueue || !gRun) return false;
+  if (!gTask) {
+    xTaskCreatePinnedToCore(jobsTask, "detect_jobs", kTaskStack, nullptr, 2, &gTask, tskNO_AFFINITY);
+  }
+  return gTask != nullptr;
+}
+
+uint32_t detectJobSubmit(DetectJobKind kind) {
+  if (!gTask) return 0;
+
+  portENTER_CRITICAL(&gJobsMux);
+  for (int i = 0; i < kMaxJobs; ++i) {
+    if (gJobs[i].id && gJobs[i].kind == kind && gJobs[i].state == DETECT_JOB_QUEUED) {
+      uint32_t shared = gJobs[i].id;
+      portEXIT_CRITICAL(&gJobsMux);
+      return shared;
+    }
+  }
+  // kMaxJobs > kQueueDepth + 1, so the slot never holds a pending job.
+  uint32_t id = gNextId++;
+  if (!gNextId) gNextId = 1;
+  DetectJob* job = slotFor(id);
+  memset(job, 0, sizeof(*job));
+  job->id = id;
+  job->kind = kind;
+  job->state = DETECT_JOB_QUEUED;
+  job->submittedMs = millis();
+  portEXIT_CRITICAL(&gJobsMux);
+
+  if (xQueueSend(gQueue, &id, 0) != pdTRUE) {
+    portENTER_CRITICAL(&gJobsMux);
+    if (job->id == id) job->id = 0;
+    portEXIT_CRITICAL(&gJobsMux);
+    return 0;
+  }
+  return id;
+}
+
+bool detectJobGet(uint32_t id, DetectJob& out) {
+  if (!id) return false;
+  portENTER_CRITICAL(&gJobsMux);
+  const DetectJob* job = slotFor(id);
+  bool found = job->id == id;
+  if (found) out = *job;
+  portEXIT_CRITICAL(&gJobsMux);
+  return found;
+}
+
+bool detectJobWait(uint32_t id, uint32_t timeoutMs, DetectJob& out) {
+  uint32_t start = millis();
+  for (;;) {
+    if (!detectJobGet(id, out)) return false;
+    if (out.state == DETECT_JOB_DONE || out.state == DETECT_JOB_FAILED) return true;
+    if (millis() - start >= timeoutMs) return false;
+    vTaskDelay(pdMS_TO_TICKS(kWaitPollMs));
+  }
+}
+
+const char* detectJobKindName(DetectJobKind kind) {
+  switch (kind) {
+    case DETECT_JOB_CAPTURE: return "capture";
+    case DETECT_JOB_GPT: return "gpt";
+    case DETECT_JOB_TEST: return "test";
+    default: return "unknown";
+  }
+}
+
+const char* detectJobStateName(DetectJobState state) {
+  switch (state) {
+    case DETECT_JOB_QUEUED: return "queued";
+    case DETECT_JOB_RUNNING: return "running";
+    case DETECT_JOB_DONE: return "done";
+    case DETECT_JOB_FAILED: return "failed";
+    default: return "unknown";
+  }
+}
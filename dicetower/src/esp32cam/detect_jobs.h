@@ -0,0 +1,58 @@
+#pragma once
+#include <Arduino.h>
+#include "dice_detection.h"
+
+// Detection requests run on a worker task instead of inside
+// httpServer.handleClient(), so a slow server or GPT round trip no longer
+// freezes the other endpoints. Handlers submit a job, get its id back at
+// once, and read the result later (or wait for it with a deadline).
+
+enum DetectJobKind {
+  DETECT_JOB_CAPTURE = 0,  // Server, then on-device fallback (/dice/capture)
+  DETECT_JOB_GPT = 1,      // ChatGPT via the detection server (/dice/capture_gpt)
+  DETECT_JOB_TEST = 2,     // Fixed multipart test server (/dice/capture_test)
+  DETECT_JOB_KIND_COUNT
+};
+
+enum DetectJobState {
+  DETECT_JOB_QUEUED = 0,
+  DETECT_JOB_RUNNING = 1,
+  DETECT_JOB_DONE = 2,
+  DETECT_JOB_FAILED = 3,  // Could not run (see error); "no die found" is DONE
+};
+
+struct DetectJob {
+  uint32_t id;
+  DetectJobKind kind;
+  DetectJobState state;
+  const char* error;       // Static string, set when FAILED
+  DiceDetection result;
+  uint32_t seq;            // Detection sequence number the result was recorded under
+  uint8_t frames;          // Frames read for the result (more than 1 for burst captures)
+  float agreement;         // Burst vote agreement, 0..1 (1 for single frames)
+  uint32_t submittedMs;    // millis() timestamps
+  uint32_t startedMs;
+  uint32_t finishedMs;
+};
+
+// Runs on the worker task and fills job.result, job.seq (the detection sequence
+// number the result was recorded under), job.frames and job.agreement.
+// Returns false with *error set when the job could not run at all (camera,
+// configuration).
+typedef bool (*DetectJobRunFn)(DetectJobKind kind, DetectJob& job, const char** error);
+
+bool detectJobsBegin(DetectJobRunFn run);
+
+// Queues a job and returns its id, or 0 when the queue is full. A request for
+// a kind that is already queued (not yet running) shares that job.
+uint32_t detectJobSubmit(DetectJobKind kind);
+
+// Copies the job; false once it has been evicted by newer jobs.
+bool detectJobGet(uint32_t id, DetectJob& out);
+
+// Blocks the caller until the job finishes or timeoutMs passes; `out` holds
+// the latest state either way. Returns true when it finished.
+bool detectJobWait(uint32_t id, uint32_t timeoutMs, DetectJob& out);
+
+const char* detectJobKindName(DetectJobKind kind);
+const char* detectJobStateName(DetectJobState state);
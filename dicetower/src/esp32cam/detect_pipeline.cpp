@@ -0,0 +1,177 @@
+#include "detect_pipeline.h"
+#include <string.h>
+#include "freertos/queue.h"
+#include "frame_pool.h"
+#include "camera_mode.h"
+
+static const uint32_t kCaptureStack = 4096;
+static const uint32_t kPrepStack = 4096;    // jpegCrop keeps its tables in the shared codec
+static const uint32_t kUploadStack = 8192;  // HTTPClient + ArduinoJson, as on detect_jobs
+static const BaseType_t kCaptureCore = 1;   // APP_CPU: away from Wi-Fi / lwIP
+static const BaseType_t kNetCore = 0;       // PRO_CPU: next to the network stack
+static const int kStageQueueDepth = 1;
+
+static PipelinePrepareFn gPrepare = nullptr;
+static PipelineDetectFn gDetect = nullptr;
+static QueueHandle_t gRequests = nullptr;  // Capture stage input (no payload)
+static QueueHandle_t gPrepQueue = nullptr;
+static QueueHandle_t gUploadQueue = nullptr;
+static QueueHandle_t gReadings = nullptr;
+static TaskHandle_t gTasks[PIPELINE_STAGE_COUNT] = {};
+static volatile bool gSkip = false;
+static PipelineStats gStats = {};
+static portMUX_TYPE gPipelineMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void noteStage(PipelineStage stage, uint32_t workUs, uint32_t blockedUs) {
+  portENTER_CRITICAL(&gPipelineMux);
+  PipelineStageStats& s = gStats.stages[stage];
+  s.items++;
+  s.lastUs = workUs;
+  if (workUs > s.maxUs) s.maxUs = workUs;
+  s.busyUs += workUs;
+  s.blockedUs += blockedUs;
+  portEXIT_CRITICAL(&gPipelineMux);
+}
+
+// Blocking send; returns how long the queue stayed full.
+static uint32_t sendDownstream(QueueHandle_t queue, const void* item) {
+  uint32_t start = micros();
+  xQueueSend(queue, item, portMAX_DELAY);
+  return micros() - start;
+}
+
+void pipelineLease(camera_fb_t* fb, PipelineFrame& frame) {
+  memset(&frame, 0, sizeof(frame));
+  if (!fb) return;
+  frame.width = fb->width;
+  frame.height = fb->height;
+  frame.kept = {0, 0, (int)fb->width, (int)fb->height};
+  if (fb->format != PIXFORMAT_JPEG) return;
+  frame.jpeg = framePoolAcquire(FRAME_POOL_JPEG, fb->len);
+  if (!frame.jpeg) return;
+  memcpy(frame.jpeg, fb->buf, fb->len);
+  frame.len = fb->len;
+}
+
+static void captureTask(void*) {
+  for (;;) {
+    uint8_t request;
+    if (xQueueReceive(gRequests, &request, portMAX_DELAY) != pdTRUE) continue;
+    uint32_t start = micros();
+    PipelineFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.skip = gSkip;
+    if (!frame.skip) {
+      camera_fb_t* fb = cameraFrameGet();
+      pipelineLease(fb, frame);
+      if (fb) cameraFrameReturn(fb);
+    }
+    uint32_t workUs = micros() - start;
+    noteStage(PIPELINE_STAGE_CAPTURE, workUs, sendDownstream(gPrepQueue, &frame));
+  }
+}
+
+static void prepTask(void*) {
+  for (;;) {
+    PipelineFrame frame;
+    if (xQueueReceive(gPrepQueue, &frame, portMAX_DELAY) != pdTRUE) continue;
+    uint32_t start = micros();
+    frame.skip = frame.skip || gSkip;
+    if (frame.jpeg && !frame.skip) gPrepare(frame);
+    uint32_t workUs = micros() - start;
+    noteStage(PIPELINE_STAGE_PREP, workUs, sendDownstream(gUploadQueue, &frame));
+  }
+}
+
+static void uploadTask(void*) {
+  for (;;) {
+    PipelineFrame frame;
+    if (xQueueReceive(gUploadQueue, &frame, portMAX_DELAY) != pdTRUE) continue;
+    uint32_t start = micros();
+    PipelineReading reading;
+    memset(&reading, 0, sizeof(reading));
+    reading.source = DETECTION_SOURCE_LOCAL;
+    reading.captured = frame.jpeg != nullptr;
+    reading.skipped = frame.skip || gSkip;
+    if (reading.captured && !reading.skipped) reading.source = gDetect(frame, reading.detection);
+    framePoolRelease(frame.jpeg);
+
+    portENTER_CRITICAL(&gPipelineMux);
+    if (reading.skipped) {
+      gStats.skipped++;
+    } else if (!reading.captured) {
+      gStats.captureFailures++;
+    }
+    portEXIT_CRITICAL(&gPipelineMux);
+    uint32_t workUs = micros() - start;
+    noteStage(PIPELINE_STAGE_UPLOAD, workUs, sendDownstream(gReadings, &reading));
+  }
+}
+
+bool pipelineBegin(PipelinePrepareFn prepare, PipelineDetectFn detect) {
+  gPrepare = prepare;
+  gDetect = detect;
+  if (!gRequests) gRequests = xQueueCreate(kPipelineMaxInFlight, sizeof(uint8_t));
+  if (!gPrepQueue) gPrepQueue = xQueueCreate(kStageQueueDepth, sizeof(PipelineFrame));
+  if (!gUploadQueue) gUploadQueue = xQueueCreate(kStageQueueDepth, sizeof(PipelineFrame));
+  // Room for every frame a consumer may have in flight, so the upload stage
+  // never waits on a consumer that is itself waiting to submit.
+  if (!gReadings) gReadings = xQueueCreate(kPipelineMaxInFlight, sizeof(PipelineReading));
+  if (!gRequests || !gPrepQueue || !gUploadQueue || !gReadings || !gPrepare || !gDetect) return false;
+
+  if (!gTasks[PIPELINE_STAGE_CAPTURE]) {
+    xTaskCreatePinnedToCore(captureTask, "pipe_capture", kCaptureStack, nullptr, 3,
+                            &gTasks[PIPELINE_STAGE_CAPTURE], kCaptureCore);
+  }
+  if (!gTasks[PIPELINE_STAGE_PREP]) {
+    xTaskCreatePinnedToCore(prepTask, "pipe_prep", kPrepStack, nullptr, 2, &gTasks[PIPELINE_STAGE_PREP], kNetCore);
+  }
+  if (!gTasks[PIPELINE_STAGE_UPLOAD]) {
+    xTaskCreatePinnedToCore(uploadTask, "pipe_upload", kUploadStack, nullptr, 2,
+                            &gTasks[PIPELINE_STAGE_UPLOAD], kNetCore);
+  }
+  for (int i = 0; i < PIPELINE_STAGE_COUNT; ++i) {
+    if (!gTasks[i]) return false;
+  }
+  return true;
+}
+
+bool pipelineRequestCapture() {
+  if (!gTasks[PIPELINE_STAGE_CAPTURE]) return false;
+  uint8_t request = 0;
+  return xQueueSend(gRequests, &request, portMAX_DELAY) == pdTRUE;
+}
+
+bool pipelineSubmit(PipelineFrame& frame) {
+  if (!gTasks[PIPELINE_STAGE_PREP]) {
+    framePoolRelease(frame.jpeg);
+    return false;
+  }
+  frame.skip = gSkip;
+  xQueueSend(gPrepQueue, &frame, portMAX_DELAY);
+  return frame.jpeg != nullptr;
+}
+
+bool pipelineNextReading(PipelineReading& out, TickType_t wait) {
+  if (!gReadings) return false;
+  return xQueueReceive(gReadings, &out, wait) == pdTRUE;
+}
+
+void pipelineSkip(bool skip) {
+  gSkip = skip;
+}
+
+void pipelineGetStats(PipelineStats& out) {
+  portENTER_CRITICAL(&gPipelineMux);
+  out = gStats;
+  portEXIT_CRITICAL(&gPipelineMux);
+}
+
+const char* pipelineStageName(PipelineStage stage) {
+  switch (stage) {
+    case PIPELINE_STAGE_CAPTURE: return "capture";
+    case PIPELINE_STAGE_PREP: return "prep";
+    case PIPELINE_STAGE_UPLOAD: return "upload";
+    default: return "unknown";
+  }
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <Arduino.h>
+#include "esp_camera.h"
+#include "dice_detection.h"
+#include "detection_history.h"
+#include "jpeg_mcu.h"
+
+// Detection as three pinned stages joined by bounded queues:
+//
+//   capture (core 1)  camera frame -> JPEG pool lease, frame returned at once
+//   prep    (core 0)  lossless crop to the tray ROI
+//   upload  (core 0)  PC server request / on-device fallback
+//
+// Capture stays off the core that runs Wi-Fi and lwIP; crop and upload share
+// it with the network stack they feed. Every queue holds one frame, so a slow
+// stage stalls the one before it instead of piling up pool leases, and the
+// time each stage spends stalled is counted. With frames in every stage,
+// frame N+1 is being captured and cropped while frame N is uploading.
+//
+// Single consumer: one caller (burst_capture) submits frames and collects
+// readings, which come back in submission order, one per submitted frame.
+
+// Frames a consumer should keep in flight: one per stage.
+static const int kPipelineMaxInFlight = 3;
+
+enum PipelineStage {
+  PIPELINE_STAGE_CAPTURE = 0,
+  PIPELINE_STAGE_PREP = 1,
+  PIPELINE_STAGE_UPLOAD = 2,
+  PIPELINE_STAGE_COUNT
+};
+
+// A frame held in a frame_pool JPEG lease; the pipeline releases it.
+struct PipelineFrame {
+  uint8_t* jpeg;  // nullptr: capture failed, passed on so readings stay in order
+  size_t len;
+  int width;      // Full camera frame
+  int height;
+  JpegRect kept;  // Where the image sits in the full frame
+  bool skip;      // Dropped by pipelineSkip(); no work is done on it
+};
+
+struct PipelineReading {
+  DiceDetection detection;
+  DetectionSource source;
+  bool captured;  // false: no camera frame or no free pool slot
+  bool skipped;
+};
+
+struct PipelineStageStats {
+  uint32_t items;
+  uint32_t lastUs;     // Work time of the last item
+  uint32_t maxUs;
+  uint64_t busyUs;     // Total work time
+  uint64_t blockedUs;  // Total time waiting for room downstream (backpressure)
+};
+
+struct PipelineStats {
+  PipelineStageStats stages[PIPELINE_STAGE_COUNT];
+  uint32_t captureFailures;
+  uint32_t skipped;
+};
+
+// May replace frame.jpeg with a smaller lease (releasing the old one) and set
+// frame.kept. Runs on the prep task.
+typedef void (*PipelinePrepareFn)(PipelineFrame& frame);
+
+// Reads one prepared frame. Runs on the upload task; must not release the lease.
+typedef DetectionSource (*PipelineDetectFn)(const PipelineFrame& frame, DiceDetection& out);
+
+// Creates the queues and starts the three stage tasks.
+bool pipelineBegin(PipelinePrepareFn prepare, PipelineDetectFn detect);
+
+// Asks the capture stage for the next camera frame. Blocks while the capture
+// queue is full.
+bool pipelineRequestCapture();
+
+// Copies a frame the caller holds into a JPEG pool lease, so fb can go back
+// to the camera at once. frame.jpeg stays nullptr when no slot is free.
+void pipelineLease(camera_fb_t* fb, PipelineFrame& frame);
+
+// Hands a pipelineLease() frame straight to the prep stage, which takes the
+// lease over. Still yields a reading (not captured) when the lease is empty.
+bool pipelineSubmit(PipelineFrame& frame);
+
+// Next reading, in submission order; waits up to `wait` ticks.
+bool pipelineNextReading(PipelineReading& out, TickType_t wait);
+
+// While set, frames not yet read are released untouched and come back as
+// skipped readings; used to abandon the tail of a burst.
+void pipelineSkip(bool skip);
+
+void pipelineGetStats(PipelineStats& out);
+
+const char* pipelineStageName(PipelineStage stage);
@@ -0,0 +1,74 @@
+#include "detection_history.h"
+#include <string.h>
+
+static DetectionRecord gRing[kDetectionHistoryCapacity];
+static uint32_t gLatestSeq = 0;  // Record seq lives at gRing[(seq - 1) % capacity]
+static DetectionHistoryStats gStats = {};
+static portMUX_TYPE gHistoryMux = portMUX_INITIALIZER_UNLOCKED;
+
+uint32_t detectionHistoryAdd(const DiceDetection& detection, DetectionSource source, uint32_t latencyMs,
+                             uint32_t timestampMs) {
+  if (source >= DETECTION_SOURCE_COUNT) source = DETECTION_SOURCE_LOCAL;
+  DetectionRecord rec;
+  rec.timestampMs = timestampMs;
+  rec.latencyMs = latencyMs;
+  rec.confidence = detection.confidence;
+  rec.value = (uint8_t)(detection.value >= 0 && detection.value <= 255 ? detection.value : 0);
+  rec.second = (uint8_t)(detection.second_most_likely >= 0 && detection.second_most_likely <= 255
+                             ? detection.second_most_likely : 0);
+  rec.source = source;
+  rec.detected = detection.detected;
+
+  portENTER_CRITICAL(&gHistoryMux);
+  rec.seq = ++gLatestSeq;
+  gRing[(rec.seq - 1) % kDetectionHistoryCapacity] = rec;
+
+  gStats.recorded++;
+  if (rec.detected) {
+    gStats.detected++;
+    if (rec.value >= 1 && rec.value <= kDetectionMaxFace) gStats.faces[rec.value]++;
+  }
+  DetectionSourceStats& s = gStats.sources[source];
+  s.count++;
+  if (latencyMs != kDetectionLatencyUnknown) {
+    if (!s.timed || latencyMs < s.minMs) s.minMs = latencyMs;
+    if (latencyMs > s.maxMs) s.maxMs = latencyMs;
+    s.lastMs = latencyMs;
+    s.sumMs += latencyMs;
+    s.timed++;
+  }
+  portEXIT_CRITICAL(&gHistoryMux);
+  return rec.seq;
+}
+
+int detectionHistorySince(uint32_t sinceSeq, DetectionRecord* out, int max, uint32_t* latestSeq, bool* truncated) {
+  portENTER_CRITICAL(&gHistoryMux);
+  uint32_t latest = gLatestSeq;
+  uint32_t oldest = latest > (uint32_t)kDetectionHistoryCapacity ? latest - kDetectionHistoryCapacity + 1 : 1;
+  uint32_t first = sinceSeq + 1 > oldest ? sinceSeq + 1 : oldest;
+  int n = 0;
+  for (uint32_t seq = first; seq <= latest && n < max; ++seq) {
+    out[n++] = gRing[(seq - 1) % kDetectionHistoryCapacity];
+  }
+  portEXIT_CRITICAL(&gHistoryMux);
+  if (latestSeq) *latestSeq = latest;
+  if (truncated) *truncated = sinceSeq + 1 < oldest;
+  return n;
+}
+
+void detectionHistoryGetStats(DetectionHistoryStats& out) {
+  portENTER_CRITICAL(&gHistoryMux);
+  out = gStats;
+  portEXIT_CRITICAL(&gHistoryMux);
+}
+
+const char* detectionSourceName(DetectionSource source) {
+  switch (source) {
+    case DETECTION_SOURCE_LOCAL: return "local";
+    case DETECTION_SOURCE_SERVER: return "server";
+    case DETECTION_SOURCE_GPT: return "gpt";
+    case DETECTION_SOURCE_TEST: return "test";
+    case DETECTION_SOURCE_EXTERNAL: return "external";
+    default: return "unknown";
+  }
+}
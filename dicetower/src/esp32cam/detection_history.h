@@ -0,0 +1,61 @@
+#pragma once
+#include <Arduino.h>
+#include "dice_detection.h"
+
+// Fixed-capacity ring of the most recent detections plus running totals
+// (per-face counts, per-source latency), all in static storage. Every
+// recorded result gets the next sequence number here, so a client that
+// remembers the last seq it saw can fetch everything newer in one call.
+
+enum DetectionSource : uint8_t {
+  DETECTION_SOURCE_LOCAL = 0,     // Pip counter / on-device model
+  DETECTION_SOURCE_SERVER = 1,    // PC server /detect
+  DETECTION_SOURCE_GPT = 2,       // PC server /gpt_detect
+  DETECTION_SOURCE_TEST = 3,      // Multipart test server
+  DETECTION_SOURCE_EXTERNAL = 4,  // Pushed to /external/detection
+  DETECTION_SOURCE_COUNT = 5,
+};
+
+static const int kDetectionHistoryCapacity = 32;
+static const int kDetectionMaxFace = 20;
+static const uint32_t kDetectionLatencyUnknown = 0xFFFFFFFFu;
+
+struct DetectionRecord {
+  uint32_t seq;
+  uint32_t timestampMs;  // millis() when recorded
+  uint32_t latencyMs;    // Frame in hand to result, or kDetectionLatencyUnknown
+  float confidence;
+  uint8_t value;
+  uint8_t second;        // second_most_likely
+  uint8_t source;        // DetectionSource
+  bool detected;
+};
+
+struct DetectionSourceStats {
+  uint32_t count;
+  uint32_t timed;        // Records that carried a latency
+  uint32_t minMs;
+  uint32_t maxMs;
+  uint32_t lastMs;
+  uint64_t sumMs;
+};
+
+struct DetectionHistoryStats {
+  uint32_t recorded;     // Since boot
+  uint32_t detected;
+  uint32_t faces[kDetectionMaxFace + 1];  // Detected results per face value; [0] unused
+  DetectionSourceStats sources[DETECTION_SOURCE_COUNT];
+};
+
+// Appends a result and updates the totals. Returns its sequence number (from 1).
+uint32_t detectionHistoryAdd(const DiceDetection& detection, DetectionSource source, uint32_t latencyMs,
+                             uint32_t timestampMs);
+
+// Copies up to `max` records with seq > sinceSeq, oldest first. `latestSeq`
+// gets the newest seq recorded; `truncated` is set when records after sinceSeq
+// have already been overwritten.
+int detectionHistorySince(uint32_t sinceSeq, DetectionRecord* out, int max, uint32_t* latestSeq, bool* truncated);
+
+void detectionHistoryGetStats(DetectionHistoryStats& out);
+
+const char* detectionSourceName(DetectionSource source);
@@ -0,0 +1,39 @@
+#include "detection_state.h"
+#include <atomic>
+#include <string.h>
+
+// Even: stable. Odd: a write is in progress. Published version = gSequence / 2.
+static std::atomic<uint32_t> gSequence(0);
+static DetectionSnapshot gSnapshot = {{false, 0, 0, 0, 0, 0, 0.0f, 0}, 0, 0, DETECTION_SOURCE_LOCAL};
+// Serializes writers only. Being a critical section it also keeps a writer
+// from being preempted mid-copy, so readers on the other core spin for at
+// most one copy and readers on the same core never see an odd sequence.
+static portMUX_TYPE gWriterMux = portMUX_INITIALIZER_UNLOCKED;
+
+bool detectionStatePublish(const DetectionSnapshot& snapshot) {
+  portENTER_CRITICAL(&gWriterMux);
+  uint32_t s = gSequence.load(std::memory_order_relaxed);
+  bool fresh = snapshot.seq > gSnapshot.seq;
+  if (fresh) {
+    gSequence.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&gSnapshot, &snapshot, sizeof(gSnapshot));
+    gSequence.store(s + 2, std::memory_order_release);
+  }
+  portEXIT_CRITICAL(&gWriterMux);
+  return fresh;
+}
+
+uint32_t detectionStateRead(DetectionSnapshot& out) {
+  for (;;) {
+    uint32_t before = gSequence.load(std::memory_order_acquire);
+    if (before & 1) continue;
+    memcpy(&out, &gSnapshot, sizeof(out));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (gSequence.load(std::memory_order_relaxed) == before) return before / 2;
+  }
+}
+
+uint32_t detectionStateVersion() {
+  return gSequence.load(std::memory_order_acquire) / 2;
+}
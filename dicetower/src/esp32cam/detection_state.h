@@ -0,0 +1,29 @@
+#pragma once
+#include <Arduino.h>
+#include "dice_detection.h"
+#include "detection_history.h"
+
+// The current detection, shared by every task that records results (job
+// worker, roll-settle watcher, HTTP loop) and every task that reads them
+// (HTTP loop, stream_hub's overlay renderer). Guarded by a seqlock: writers
+// serialize among themselves and bump the version around the copy; readers
+// never take a lock and retry the ~40-byte copy if a write overlapped it.
+
+struct DetectionSnapshot {
+  DiceDetection detection;
+  uint32_t seq;          // detection_history sequence number
+  uint32_t timestampMs;  // millis() when recorded
+  DetectionSource source;
+};
+
+// Replaces the current detection. A snapshot older than the current one
+// (lower seq, from a writer that lost a race) is dropped; returns false then.
+bool detectionStatePublish(const DetectionSnapshot& snapshot);
+
+// Consistent copy of the current detection. Returns its version: 0 before
+// the first publish, then +1 per accepted publish.
+uint32_t detectionStateRead(DetectionSnapshot& out);
+
+// Current version without copying; compare against a previous read to see
+// whether anything changed.
+uint32_t detectionStateVersion();
@@ -0,0 +1,49 @@
+#include "detection_wire.h"
+#include <string.h>
+
+static int16_t clamp16(int v) {
+  return (int16_t)(v < -32768 ? -32768 : (v > 32767 ? 32767 : v));
+}
+
+size_t detectionWireEncode(const DiceDetection& det, uint32_t seq, uint32_t timestampMs, uint8_t* out, size_t cap) {
+  if (!out || cap < kDetectionWireBytes) return 0;
+  DetectionWire w;
+  w.magic[0] = 'D';
+  w.magic[1] = 'T';
+  w.version = kDetectionWireVersion;
+  w.flags = det.detected ? 1 : 0;
+  w.seq = seq;
+  w.timestampMs = timestampMs;
+  w.value = (uint8_t)(det.value >= 0 && det.value <= 255 ? det.value : 0);
+  w.secondMostLikely = (uint8_t)(det.second_most_likely >= 0 && det.second_most_likely <= 255 ? det.second_most_likely : 0);
+  w.reserved = 0;
+  w.confidence = det.confidence;
+  w.x = clamp16(det.x);
+  w.y = clamp16(det.y);
+  w.w = clamp16(det.w);
+  w.h = clamp16(det.h);
+  memcpy(out, &w, sizeof(w));
+  return sizeof(w);
+}
+
+bool detectionWireDecode(const uint8_t* in, size_t len, DiceDetection& out, uint32_t* seq, uint32_t* timestampMs) {
+  if (!in || len < kDetectionWireBytes) return false;
+  DetectionWire w;
+  memcpy(&w, in, sizeof(w));
+  if (w.magic[0] != 'D' || w.magic[1] != 'T' || w.version == 0) return false;
+  out.detected = (w.flags & 1) != 0;
+  out.value = w.value;
+  out.second_most_likely = w.secondMostLikely;
+  out.confidence = w.confidence;
+  out.x = w.x;
+  out.y = w.y;
+  out.w = w.w;
+  out.h = w.h;
+  if (seq) *seq = w.seq;
+  if (timestampMs) *timestampMs = w.timestampMs;
+  return true;
+}
+
+bool detectionWireMatches(const char* header) {
+  return header && strstr(header, DETECTION_WIRE_MIME) != nullptr;
+}
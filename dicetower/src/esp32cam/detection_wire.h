@@ -0,0 +1,48 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "dice_detection.h"
+
+// Fixed-layout binary form of DiceDetection for machine-to-machine traffic
+// (detection server -> tower, tower -> hub). Little-endian, 28 bytes, read and
+// written with a single memcpy on both ends. Negotiated per request: clients
+// send `Accept: application/vnd.dicetower.detection` to get it back and
+// `Content-Type: application/vnd.dicetower.detection` when posting it. JSON
+// stays the default.
+//
+// Fields are only ever appended; a newer version bumps `version` and readers
+// accept any record at least kDetectionWireBytes long.
+
+#define DETECTION_WIRE_MIME "application/vnd.dicetower.detection"
+
+static const uint8_t kDetectionWireVersion = 1;
+static const size_t kDetectionWireBytes = 28;
+
+struct __attribute__((packed)) DetectionWire {
+  uint8_t magic[2];       // 'D', 'T'
+  uint8_t version;
+  uint8_t flags;          // bit 0: detected
+  uint32_t seq;           // Sender's detection sequence number
+  uint32_t timestampMs;   // Sender's millis() when the result was produced
+  uint8_t value;
+  uint8_t secondMostLikely;
+  uint16_t reserved;
+  float confidence;       // IEEE 754 binary32
+  int16_t x;
+  int16_t y;
+  int16_t w;
+  int16_t h;
+};
+
+static_assert(sizeof(DetectionWire) == kDetectionWireBytes, "DetectionWire layout changed");
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "DetectionWire assumes a little-endian host");
+
+// Writes one record into `out`; returns kDetectionWireBytes, or 0 if cap is too small.
+size_t detectionWireEncode(const DiceDetection& det, uint32_t seq, uint32_t timestampMs, uint8_t* out, size_t cap);
+
+// Reads a record; seq and timestampMs may be null. Returns false on a short
+// buffer, bad magic or version 0.
+bool detectionWireDecode(const uint8_t* in, size_t len, DiceDetection& out, uint32_t* seq, uint32_t* timestampMs);
+
+// True when an Accept or Content-Type header names the binary type.
+bool detectionWireMatches(const char* header);
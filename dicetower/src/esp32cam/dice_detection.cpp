@@ -1,4 +1,9 @@
 #include "dice_detection.h"
+#include "detection_wire.h"
+#include "dice_model.h"
+#include "multipart_body.h"
+#include "pip_counter.h"
+#include "esp_heap_caps.h"
 #include <string.h>
 #include <WiFi.h>
 #include <HTTPClient.h>
@@ -8,112 +13,247 @@
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
 
-// Placeholder implementation. Detection will be reintroduced once the embedded
-// ML pipeline is ready.
+static const uint32_t kModelTimeoutMs = 2000;
+static const int kPipMinConfidenceQ8 = 154;  // ~0.6
+
+static uint8_t* pipScratch = nullptr;
+static size_t pipScratchCap = 0;
+static SemaphoreHandle_t pipLock = nullptr;
+static portMUX_TYPE pipInitMux = portMUX_INITIALIZER_UNLOCKED;
+
+// d6 fast path on one channel: luma for grayscale, G for RGB888.
+static bool countPips(const uint8_t* px, int width, int height, int channels, DiceDetection& out) {
+  if (!pipLock) {
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    portENTER_CRITICAL(&pipInitMux);
+    if (!pipLock) {
+      pipLock = lock;
+      lock = nullptr;
+    }
+    portEXIT_CRITICAL(&pipInitMux);
+    if (lock) vSemaphoreDelete(lock);
+  }
+  if (!pipLock) return false;
+
+  xSemaphoreTake(pipLock, portMAX_DELAY);
+  size_t need = pipScratchBytes(width, height);
+  if (need > pipScratchCap) {
+    heap_caps_free(pipScratch);
+    pipScratch = (uint8_t*)heap_caps_malloc(need, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    pipScratchCap = pipScratch ? need : 0;
+  }
+  PipParams params;
+  pipParamsDefault(params);
+  PipResult pips;
+  bool ok = pipScratch && pipCount(px, width, height, channels, width * channels, params, pipScratch, pipScratchCap, pips);
+  xSemaphoreGive(pipLock);
+
+  if (!ok || pips.pips < 1 || pips.pips > 6 || pips.confidenceQ8 < kPipMinConfidenceQ8) return false;
+  out.detected = true;
+  out.value = pips.pips;
+  out.confidence = pips.confidenceQ8 / 256.0f;
+  out.second_most_likely = 0;
+  out.x = pips.x;
+  out.y = pips.y;
+  out.w = pips.w;
+  out.h = pips.h;
+  return true;
+}
+
+// Pip counter first (a few ms, d6 only), then the on-device model.
+bool detectDiceFromGray(const uint8_t* gray, int width, int height, DiceDetection& out) {
+  memset(&out, 0, sizeof(out));
+  if (countPips(gray, width, height, 1, out)) return true;
+  return diceModelRun(gray, width, height, 1, out, kModelTimeoutMs);
+}
+
 bool detectDiceFromRGB(const uint8_t* rgb, int width, int height, DiceDetection& out) {
-  (void)rgb;
-  (void)width;
-  (void)height;
   memset(&out, 0, sizeof(out));
-  out.detected = false;
-  out.value = 0;
-  out.confidence = 0.0f;
-  out.second_most_likely = 0;
-  return false;
+  if (countPips(rgb + 1, width, height, 3, out)) return true;
+  return diceModelRun(rgb, width, height, 3, out, kModelTimeoutMs);
+}
+
+// Shared by the detection server paths: {"detected","value","confidence","second_most_likely"}.
+static bool parseDetectionResponse(const String& response, DiceDetection& out) {
+  DynamicJsonDocument doc(512);
+  DeserializationError err = deserializeJson(doc, response);
+  if (err) return false;
+  out.detected = doc["detected"] | false;
+  out.value = doc["value"] | 0;
+  out.confidence = doc["confidence"] | 0.0f;
+  out.second_most_likely = doc["second_most_likely"] | 0;
+  out.x = 0;
+  out.y = 0;
+  out.w = 0;
+  out.h = 0;
+  if (out.second_most_likely < 1 || out.second_most_likely > 20) {
+    out.second_most_likely = 0;
+  }
+  return out.detected;
+}
+
+// Binary record body (detection_wire.h), read straight off the socket; the
+// declared length is consumed exactly so the connection stays reusable.
+static bool readDetectionWire(HTTPClient& http, DiceDetection& out) {
+  uint8_t wire[64];
+  int size = http.getSize();
+  WiFiClient* stream = http.getStreamPtr();
+  if (!stream || size < (int)kDetectionWireBytes || size > (int)sizeof(wire)) return false;
+  if ((int)stream->readBytes(wire, size) != size) return false;
+  return detectionWireDecode(wire, size, out, nullptr, nullptr) && out.detected;
+}
+
+static const char* kResponseHeaders[] = {"Content-Type"};
+
+// One long-lived client for the configured detection server. HTTPClient
+// keeps the socket open across begin()/end() when reuse is on and the server
+// answered with keep-alive, so each capture skips the TCP handshake (and DNS).
+static HTTPClient detectHttp;
+static String detectHttpOrigin;  // scheme://host:port the open socket belongs to
+static SemaphoreHandle_t detectHttpLock = nullptr;
+static portMUX_TYPE detectHttpMux = portMUX_INITIALIZER_UNLOCKED;
+static DetectServerStats detectHttpStats = {};
+
+// Errors that mean the kept-alive socket was already dead (server closed it
+// while idle); worth one retry on a fresh connection.
+static bool isStaleConnectionError(int code) {
+  return code == HTTPC_ERROR_SEND_HEADER_FAILED || code == HTTPC_ERROR_SEND_PAYLOAD_FAILED ||
+         code == HTTPC_ERROR_NOT_CONNECTED || code == HTTPC_ERROR_CONNECTION_LOST;
+}
+
+// HTTPClient reuses an open socket whatever host the next begin() names, so
+// the socket is keyed on the origin: /detect and /gpt_detect on the same
+// server share it, a different server gets a fresh one.
+static String urlOrigin(const String& url) {
+  int scheme = url.indexOf("://");
+  int path = url.indexOf('/', scheme < 0 ? 0 : scheme + 3);
+  return path < 0 ? url : url.substring(0, path);
+}
+
+static void closeDetectHttp() {
+  detectHttp.setReuse(false);
+  detectHttp.end();
+  detectHttp.setReuse(true);
+}
+
+static bool lockDetectHttp(uint32_t timeoutMs) {
+  if (!detectHttpLock) {
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    portENTER_CRITICAL(&detectHttpMux);
+    if (!detectHttpLock) {
+      detectHttpLock = lock;
+      lock = nullptr;
+    }
+    portEXIT_CRITICAL(&detectHttpMux);
+    if (lock) vSemaphoreDelete(lock);
+  }
+  return detectHttpLock && xSemaphoreTake(detectHttpLock, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
 }
 
 // External server detection - sends JPEG to server and parses response
-bool detectDiceFromJPEG(const uint8_t* jpeg, size_t jpegLen, const String& serverUrl, DiceDetection& out) {
+bool detectDiceFromJPEG(const uint8_t* jpeg, size_t jpegLen, const String& serverUrl, DiceDetection& out,
+                        uint32_t timeoutMs) {
   if (serverUrl.length() == 0 || WiFi.status() != WL_CONNECTED) {
     return false;
   }
+  if (!lockDetectHttp(timeoutMs)) {
+    return false;
+  }
 
-  HTTPClient http;
-  http.begin(serverUrl);
-  http.addHeader("Content-Type", "image/jpeg");
-  http.setTimeout(5000);  // 5 second timeout
+  String origin = urlOrigin(serverUrl);
+  if (origin != detectHttpOrigin) {
+    closeDetectHttp();
+    detectHttpOrigin = origin;
+  }
+
+  int httpCode = 0;
+  bool reused = false;
+  bool reconnected = false;
+  uint32_t t0 = millis();
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    detectHttp.setReuse(true);
+    if (!detectHttp.begin(serverUrl)) {
+      httpCode = HTTPC_ERROR_CONNECTION_REFUSED;
+      break;
+    }
+    reused = detectHttp.connected();
+    detectHttp.addHeader("Content-Type", "image/jpeg");
+    detectHttp.addHeader("Accept", DETECTION_WIRE_MIME ", application/json;q=0.9");
+    detectHttp.collectHeaders(kResponseHeaders, 1);
+    detectHttp.setTimeout(timeoutMs);
+    httpCode = detectHttp.POST(const_cast<uint8_t*>(jpeg), jpegLen);
+    if (httpCode > 0 || !reused || !isStaleConnectionError(httpCode)) break;
+    closeDetectHttp();
+    reconnected = true;
+  }
 
-  int httpCode = http.POST(const_cast<uint8_t*>(jpeg), jpegLen);
-  
   bool success = false;
   if (httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_CREATED) {
-    String response = http.getString();
-    
-    DynamicJsonDocument doc(512);
-    DeserializationError err = deserializeJson(doc, response);
-    if (!err) {
-      out.detected = doc["detected"] | false;
-      out.value = doc["value"] | 0;
-      out.confidence = doc["confidence"] | 0.0f;
-      out.second_most_likely = doc["second_most_likely"] | 0;
-      out.x = 0;
-      out.y = 0;
-      out.w = 0;
-      out.h = 0;
-      if (out.second_most_likely < 1 || out.second_most_likely > 20) {
-        out.second_most_likely = 0;
-      }
-      success = out.detected;
+    if (detectionWireMatches(detectHttp.header("Content-Type").c_str())) {
+      success = readDetectionWire(detectHttp, out);
+    } else {
+      success = parseDetectionResponse(detectHttp.getString(), out);
     }
   }
-  
-  http.end();
+
+  // end() keeps the socket when the response allowed it; anything else
+  // (errors, timeouts, unread bodies) starts the next request fresh.
+  if (httpCode > 0) {
+    detectHttp.end();
+  } else {
+    closeDetectHttp();
+  }
+
+  portENTER_CRITICAL(&detectHttpMux);
+  detectHttpStats.requests++;
+  if (reused && !reconnected) detectHttpStats.reused++;
+  if (reconnected) detectHttpStats.reconnects++;
+  if (httpCode <= 0) detectHttpStats.failures++;
+  detectHttpStats.lastMs = millis() - t0;
+  portEXIT_CRITICAL(&detectHttpMux);
+
+  xSemaphoreGive(detectHttpLock);
   return success;
 }
 
+void detectServerDisconnect() {
+  if (!lockDetectHttp(portMAX_DELAY)) return;
+  closeDetectHttp();
+  detectHttpOrigin = "";
+  xSemaphoreGive(detectHttpLock);
+}
+
+void detectServerGetStats(DetectServerStats& out) {
+  portENTER_CRITICAL(&detectHttpMux);
+  out = detectHttpStats;
+  portEXIT_CRITICAL(&detectHttpMux);
+}
+
 // Multipart/form-data post to fixed test server (field name: file)
 bool detectDiceToTestServer(const uint8_t* jpeg, size_t jpegLen, const String& serverUrl, DiceDetection& out) {
   if (serverUrl.length() == 0 || WiFi.status() != WL_CONNECTED) {
     return false;
   }
 
-  HTTPClient http;
-  String boundary = "----esp32boundary";
-  String contentType = "multipart/form-data; boundary=" + boundary;
-  if (!http.begin(serverUrl)) {
+  MultipartBody body;
+  if (!body.addFile("file", "capture.jpg", "image/jpeg", jpeg, jpegLen) || !body.finish()) {
     return false;
   }
-  http.addHeader("Content-Type", contentType);
-  http.setTimeout(8000);
-
-  String head = "--" + boundary + "\r\n"
-                "Content-Disposition: form-data; name=\"file\"; filename=\"capture.jpg\"\r\n"
-                "Content-Type: image/jpeg\r\n\r\n";
-  String tail = "\r\n--" + boundary + "--\r\n";
 
-  size_t totalLen = head.length() + jpegLen + tail.length();
-  uint8_t* body = (uint8_t*)malloc(totalLen);
-  if (!body) {
-    http.end();
+  HTTPClient http;
+  if (!http.begin(serverUrl)) {
     return false;
   }
+  http.addHeader("Content-Type", body.contentType());
+  http.setTimeout(8000);
 
-  memcpy(body, head.c_str(), head.length());
-  memcpy(body + head.length(), jpeg, jpegLen);
-  memcpy(body + head.length() + jpegLen, tail.c_str(), tail.length());
-
-  int httpCode = http.POST(body, totalLen);
-  free(body);
+  // Streams the part header, the frame buffer in place and the closing
+  // boundary; HTTPClient sets Content-Length from body.length().
+  int httpCode = http.sendRequest("POST", &body, body.length());
 
   bool success = false;
   if (httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_CREATED) {
-    String response = http.getString();
-    DynamicJsonDocument doc(512);
-    DeserializationError err = deserializeJson(doc, response);
-    if (!err) {
-      out.detected = doc["detected"] | false;
-      out.value = doc["value"] | 0;
-      out.confidence = doc["confidence"] | 0.0f;
-      out.second_most_likely = doc["second_most_likely"] | 0;
-      out.x = 0;
-      out.y = 0;
-      out.w = 0;
-      out.h = 0;
-      if (out.second_most_likely < 1 || out.second_most_likely > 20) {
-        out.second_most_likely = 0;
-      }
-      success = out.detected;
-    }
+    success = parseDetectionResponse(http.getString(), out);
   }
 
   http.end();
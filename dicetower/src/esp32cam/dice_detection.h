@@ -12,11 +12,29 @@ struct DiceDetection {
   int second_most_likely;  // Second most likely value (for ChatGPT)
 };
 
-// Placeholder detection hook. Returns false until the ML model is integrated.
+// On-device detection: the d6 pip counter (pip_counter.h), then the model
+// (dice_model.h). Returns false when neither found a die. Grayscale is the
+// native input (see jpegDecodeLuma); RGB888 is kept for other callers.
+bool detectDiceFromGray(const uint8_t* gray, int width, int height, DiceDetection& out);
 bool detectDiceFromRGB(const uint8_t* rgb, int width, int height, DiceDetection& out);
 
-// External server detection (sends JPEG to server, returns result)
-bool detectDiceFromJPEG(const uint8_t* jpeg, size_t jpegLen, const String& serverUrl, DiceDetection& out);
+struct DetectServerStats {
+  uint32_t requests;
+  uint32_t reused;      // Requests sent on an already open keep-alive connection
+  uint32_t reconnects;  // Kept-alive connection was dead; retried on a fresh one
+  uint32_t failures;    // Transport errors (no HTTP status)
+  uint32_t lastMs;      // Round trip of the last request
+};
+
+// External server detection (sends JPEG to server, returns result). Keeps one
+// HTTP keep-alive connection per server URL and reconnects when it drops.
+bool detectDiceFromJPEG(const uint8_t* jpeg, size_t jpegLen, const String& serverUrl, DiceDetection& out,
+                        uint32_t timeoutMs = 5000);
+
+// Closes the kept-alive connection (e.g. when the server URL is cleared).
+void detectServerDisconnect();
+
+void detectServerGetStats(DetectServerStats& out);
 
 // Test server detection (multipart/form-data file field "file")
 bool detectDiceToTestServer(const uint8_t* jpeg, size_t jpegLen, const String& serverUrl, DiceDetection& out);
@@ -0,0 +1,195 @@
+#include "dice_model.h"
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "dice_model_input.h"
+
+#if defined(__has_include)
+#if __has_include(<dice_inferencing.h>)
+#include "dice_model_decode.h"
+#define DICE_MODEL_PRESENT 1
+#endif
+#endif
+#ifndef DICE_MODEL_PRESENT
+#define DICE_MODEL_PRESENT 0
+#endif
+
+static DiceModelStats gStats = {};
+static portMUX_TYPE gModelMux = portMUX_INITIALIZER_UNLOCKED;
+
+#if DICE_MODEL_PRESENT
+
+static const uint32_t kTaskStack = 12288;  // TFLite Micro interpreter + DSP scratch
+static const int kInputW = EI_CLASSIFIER_INPUT_WIDTH;
+static const int kInputH = EI_CLASSIFIER_INPUT_HEIGHT;
+#if defined(EI_CLASSIFIER_TFLITE_LARGEST_ARENA_SIZE)
+static const size_t kArenaBytes = EI_CLASSIFIER_TFLITE_LARGEST_ARENA_SIZE;
+#else
+static const size_t kArenaBytes = EI_CLASSIFIER_TFLITE_ARENA_SIZE;
+#endif
+
+static uint8_t* gInput = nullptr;  // kInputW * kInputH RGB888, PSRAM
+static uint8_t* gArena = nullptr;  // Tensor arena, allocated once in PSRAM
+static bool gArenaLeased = false;
+static TaskHandle_t gTask = nullptr;
+static SemaphoreHandle_t gDone = nullptr;
+static volatile bool gBusy = false;
+static uint32_t gRequestId = 0;
+static uint32_t gResultId = 0;
+static DiceDetection gResult = {false, 0, 0, 0, 0, 0, 0.0f, 0};
+static ModelInputMap gMap = {0, 0, 1.0f};  // Where gInput sits in the last frame
+
+// The SDK allocates the interpreter arena through these hooks (weak in its
+// Arduino port). The arena-sized request is served from one PSRAM block that
+// lives for the whole run; everything else goes to the regular heap.
+void* ei_malloc(size_t size) {
+  if (gArena && size <= kArenaBytes && size > kArenaBytes / 2) {
+    portENTER_CRITICAL(&gModelMux);
+    bool take = !gArenaLeased;
+    gArenaLeased = true;
+    portEXIT_CRITICAL(&gModelMux);
+    if (take) return gArena;
+  }
+  return heap_caps_malloc(size, MALLOC_CAP_8BIT);
+}
+
+void* ei_calloc(size_t nitems, size_t size) {
+  void* p = ei_malloc(nitems * size);
+  if (p) memset(p, 0, nitems * size);
+  return p;
+}
+
+void ei_free(void* ptr) {
+  if (ptr && ptr == gArena) {
+    portENTER_CRITICAL(&gModelMux);
+    gArenaLeased = false;
+    portEXIT_CRITICAL(&gModelMux);
+    return;
+  }
+  heap_caps_free(ptr);
+}
+
+static int getInputData(size_t offset, size_t length, float* out) {
+  modelInputPack(gInput, offset, length, out);
+  return 0;
+}
+
+static void decodeResult(const ei_impulse_result_t& result, DiceDetection& out) {
+  ModelReading r;
+  modelDecode(result, gMap, r);
+  out.detected = r.detected;
+  out.value = r.value;
+  out.confidence = r.confidence;
+  out.second_most_likely = r.second;
+  out.x = r.x;
+  out.y = r.y;
+  out.w = r.w;
+  out.h = r.h;
+}
+
+static void modelTask(void*) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    uint32_t id = gRequestId;
+
+    signal_t signal;
+    signal.total_length = (size_t)kInputW * kInputH;
+    signal.get_data = &getInputData;
+    ei_impulse_result_t result = {};
+    EI_IMPULSE_ERROR err = run_classifier(&signal, &result, false);
+
+    DiceDetection det = {false, 0, 0, 0, 0, 0, 0.0f, 0};
+    if (err == EI_IMPULSE_OK) decodeResult(result, det);
+
+    portENTER_CRITICAL(&gModelMux);
+    gResult = det;
+    gResultId = id;
+    gStats.runs++;
+    gStats.lastDspUs = (uint32_t)result.timing.dsp_us;
+    gStats.lastInferUs = (uint32_t)result.timing.classification_us;
+    gBusy = false;
+    portEXIT_CRITICAL(&gModelMux);
+    xSemaphoreGive(gDone);
+  }
+}
+
+bool diceModelAvailable() {
+  return gTask != nullptr;
+}
+
+bool diceModelBegin() {
+  if (gTask) return true;
+  if (!gInput) gInput = (uint8_t*)heap_caps_malloc((size_t)kInputW * kInputH * 3, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!gArena) gArena = (uint8_t*)heap_caps_aligned_alloc(16, kArenaBytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!gDone) gDone = xSemaphoreCreateBinary();
+  if (!gInput || !gArena || !gDone) return false;
+  // Core 1: keeps inference off the Wi-Fi/lwIP core.
+  xTaskCreatePinnedToCore(modelTask, "dice_model", kTaskStack, nullptr, 2, &gTask, 1);
+  return gTask != nullptr;
+}
+
+bool diceModelRun(const uint8_t* px, int width, int height, int channels, DiceDetection& out, uint32_t timeoutMs) {
+  memset(&out, 0, sizeof(out));
+  if (!gTask || !px || width <= 0 || height <= 0 || (channels != 1 && channels != 3)) return false;
+
+  portENTER_CRITICAL(&gModelMux);
+  bool busy = gBusy;
+  gBusy = true;
+  if (busy) gStats.busy++;
+  portEXIT_CRITICAL(&gModelMux);
+  if (busy) return false;
+
+  int64_t t0 = esp_timer_get_time();
+  modelInputResize(px, width, height, channels, gInput, kInputW, kInputH, gMap);
+  uint32_t id;
+  portENTER_CRITICAL(&gModelMux);
+  id = ++gRequestId;
+  gStats.lastPrepUs = (uint32_t)(esp_timer_get_time() - t0);
+  portEXIT_CRITICAL(&gModelMux);
+  xTaskNotifyGive(gTask);
+
+  // Skip completions left over from callers that timed out.
+  TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeoutMs);
+  for (;;) {
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(deadline - now) <= 0 || xSemaphoreTake(gDone, deadline - now) != pdTRUE) {
+      portENTER_CRITICAL(&gModelMux);
+      gStats.timeouts++;
+      portEXIT_CRITICAL(&gModelMux);
+      return false;
+    }
+    portENTER_CRITICAL(&gModelMux);
+    bool mine = gResultId == id;
+    if (mine) out = gResult;
+    portEXIT_CRITICAL(&gModelMux);
+    if (mine) return out.detected;
+  }
+}
+
+#else  // !DICE_MODEL_PRESENT
+
+bool diceModelAvailable() {
+  return false;
+}
+
+bool diceModelBegin() {
+  return false;
+}
+
+bool diceModelRun(const uint8_t* px, int width, int height, int channels, DiceDetection& out, uint32_t timeoutMs) {
+  (void)px;
+  (void)width;
+  (void)height;
+  (void)channels;
+  (void)timeoutMs;
+  memset(&out, 0, sizeof(out));
+  return false;
+}
+
+#endif  // DICE_MODEL_PRESENT
+
+void diceModelGetStats(DiceModelStats& out) {
+  portENTER_CRITICAL(&gModelMux);
+  out = gStats;
+  portEXIT_CRITICAL(&gModelMux);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <Arduino.h>
+#include "dice_detection.h"
+
+// On-device int8 classifier (Edge Impulse export). Inference runs on its own
+// task so the camera and HTTP paths never share a stack with TFLite Micro.
+// The model comes from the Edge Impulse Arduino library export; when the
+// firmware is built without it (no dice_inferencing.h on the include path)
+// diceModelAvailable() is false and every run fails fast. test/dice_model
+// runs the same input and decoding path on a host.
+
+struct DiceModelStats {
+  uint32_t runs;
+  uint32_t busy;       // Runs refused because an inference was still in flight
+  uint32_t timeouts;   // Callers that gave up waiting (result still recorded)
+  uint32_t lastPrepUs; // Crop + resize into the model input
+  uint32_t lastDspUs;  // Edge Impulse DSP block (normalize, quantize)
+  uint32_t lastInferUs;
+};
+
+bool diceModelAvailable();
+
+// Allocates the PSRAM input buffer and tensor arena and starts the task.
+bool diceModelBegin();
+
+// Resizes an 8-bit grayscale (channels = 1) or RGB888 (channels = 3) frame
+// into the model input on the caller's task, then waits up to timeoutMs for
+// the classifier. Fills value, confidence and second_most_likely; x/y/w/h are
+// set for object-detection models.
+bool diceModelRun(const uint8_t* px, int width, int height, int channels, DiceDetection& out, uint32_t timeoutMs);
+
+void diceModelGetStats(DiceModelStats& out);
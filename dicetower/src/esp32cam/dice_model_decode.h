@@ -0,0 +1,66 @@
+#pragma once
+#include <string.h>
+#include <dice_inferencing.h>
+#include "dice_model_input.h"
+
+// Turns an Edge Impulse result into a dice reading. Header-only because it
+// follows the exported model's EI_CLASSIFIER_* settings; included by
+// dice_model.cpp and the host harness, only when the export is present.
+
+static const float kDiceModelMinConfidence = 0.5f;
+
+struct ModelReading {
+  int value;       // 0: no usable label
+  int second;      // Second most likely value
+  float confidence;
+  int x, y, w, h;  // Source-frame box (object-detection models only)
+  bool detected;   // value set and confidence >= kDiceModelMinConfidence
+};
+
+inline void modelDecode(const ei_impulse_result_t& result, const ModelInputMap& map, ModelReading& out) {
+  memset(&out, 0, sizeof(out));
+#if EI_CLASSIFIER_OBJECT_DETECTION == 1
+  // Keep the best box and the best box with a different value.
+  float best = 0.0f;
+  float second = 0.0f;
+  for (uint32_t i = 0; i < result.bounding_boxes_count; ++i) {
+    const ei_impulse_result_bounding_box_t& bb = result.bounding_boxes[i];
+    int value = modelLabelValue(bb.label);
+    if (bb.value <= 0.0f || value == 0) continue;
+    if (bb.value > best) {
+      if (out.value != 0 && out.value != value) {
+        second = best;
+        out.second = out.value;
+      }
+      best = bb.value;
+      out.value = value;
+      out.x = map.cropX + (int)(bb.x * map.scale);
+      out.y = map.cropY + (int)(bb.y * map.scale);
+      out.w = (int)(bb.width * map.scale);
+      out.h = (int)(bb.height * map.scale);
+    } else if (bb.value > second && value != out.value) {
+      second = bb.value;
+      out.second = value;
+    }
+  }
+  out.confidence = best;
+#else
+  int bestIdx = -1;
+  int secondIdx = -1;
+  for (int i = 0; i < EI_CLASSIFIER_LABEL_COUNT; ++i) {
+    float v = result.classification[i].value;
+    if (bestIdx < 0 || v > result.classification[bestIdx].value) {
+      secondIdx = bestIdx;
+      bestIdx = i;
+    } else if (secondIdx < 0 || v > result.classification[secondIdx].value) {
+      secondIdx = i;
+    }
+  }
+  if (bestIdx >= 0) {
+    out.value = modelLabelValue(result.classification[bestIdx].label);
+    out.confidence = result.classification[bestIdx].value;
+  }
+  if (secondIdx >= 0) out.second = modelLabelValue(result.classification[secondIdx].label);
+#endif
+  out.detected = out.value != 0 && out.confidence >= kDiceModelMinConfidence;
+}
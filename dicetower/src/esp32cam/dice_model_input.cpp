@@ -0,0 +1,55 @@
+#include "dice_model_input.h"
+#include <stdlib.h>
+
+void modelInputResize(const uint8_t* px, int width, int height, int channels, uint8_t* dst, int dstW, int dstH,
+                      ModelInputMap& map) {
+  int cropW = width;
+  int cropH = (int)((int64_t)width * dstH / dstW);
+  if (cropH > height) {
+    cropH = height;
+    cropW = (int)((int64_t)height * dstW / dstH);
+  }
+  map.cropX = (width - cropW) / 2;
+  map.cropY = (height - cropH) / 2;
+  map.scale = (float)cropW / (float)dstW;
+
+  const int32_t stepX = (int32_t)(((int64_t)(cropW - 1) << 16) / (dstW > 1 ? dstW - 1 : 1));
+  const int32_t stepY = (int32_t)(((int64_t)(cropH - 1) << 16) / (dstH > 1 ? dstH - 1 : 1));
+  const size_t rowStride = (size_t)width * channels;
+  uint8_t* out = dst;
+  for (int oy = 0; oy < dstH; ++oy) {
+    int32_t fy = oy * stepY;
+    int y0 = map.cropY + (fy >> 16);
+    int y1 = y0 + 1 < map.cropY + cropH ? y0 + 1 : y0;
+    uint32_t wy = (uint32_t)(fy & 0xFFFF) >> 8;
+    const uint8_t* row0 = px + (size_t)y0 * rowStride;
+    const uint8_t* row1 = px + (size_t)y1 * rowStride;
+    for (int ox = 0; ox < dstW; ++ox) {
+      int32_t fx = ox * stepX;
+      int x0 = (map.cropX + (fx >> 16)) * channels;
+      int x1 = (fx >> 16) + 1 < cropW ? x0 + channels : x0;
+      uint32_t wx = (uint32_t)(fx & 0xFFFF) >> 8;
+      for (int c = 0; c < channels; ++c) {
+        uint32_t top = row0[x0 + c] * (256 - wx) + row0[x1 + c] * wx;
+        uint32_t bot = row1[x0 + c] * (256 - wx) + row1[x1 + c] * wx;
+        *out++ = (uint8_t)((top * (256 - wy) + bot * wy + (1u << 15)) >> 16);
+      }
+      if (channels == 1) {
+        out[0] = out[1] = out[-1];
+        out += 2;
+      }
+    }
+  }
+}
+
+void modelInputPack(const uint8_t* rgb, size_t offset, size_t length, float* out) {
+  const uint8_t* p = rgb + offset * 3;
+  for (size_t i = 0; i < length; ++i, p += 3) {
+    out[i] = (float)(((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2]);
+  }
+}
+
+int modelLabelValue(const char* label) {
+  int v = atoi(label);
+  return (v >= 1 && v <= 20) ? v : 0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Model-side image handling for dice_model that does not depend on the Edge
+// Impulse SDK or Arduino: fitting a camera frame into the model input and
+// packing it the way the SDK's image blocks read it. Shared with the host
+// harness in test/dice_model, which runs the same path on recorded frames.
+
+// Where the model input sits in the source frame, for mapping boxes back.
+struct ModelInputMap {
+  int cropX;
+  int cropY;
+  float scale;  // Source pixels per input pixel
+};
+
+// Center-crops an 8-bit grayscale (channels = 1) or RGB888 (channels = 3)
+// frame to the input's aspect ratio and resamples it bilinearly (16.16 fixed
+// point) into `dst`, dstW x dstH RGB888. One-channel sources are replicated
+// into R, G and B.
+void modelInputResize(const uint8_t* px, int width, int height, int channels, uint8_t* dst, int dstW, int dstH,
+                      ModelInputMap& map);
+
+// Edge Impulse image blocks take packed 0xRRGGBB pixels as floats and do
+// their own scaling and quantization. Pixel offsets into an RGB888 input.
+void modelInputPack(const uint8_t* rgb, size_t offset, size_t length, float* out);
+
+// Face value of a model label ("1".."20"), or 0.
+int modelLabelValue(const char* label);
@@ -0,0 +1,216 @@
+#include "event_hub.h"
+#include <stdio.h>
+#include <string.h>
+#include "freertos/queue.h"
+#include "lwip/sockets.h"
+
+static const int kQueueDepth = 8;
+static const int kRetained = 4;            // Distinct event names replayed on connect
+static const uint32_t kTaskStack = 4096;
+static const uint32_t kHeartbeatMs = 15000;
+static const int kSendTimeoutMs = 2000;    // A stalled client is dropped, not waited for
+static const char* kEventsResponseHead =
+  "HTTP/1.1 200 OK\r\n"
+  "Content-Type: text/event-stream\r\n"
+  "Cache-Control: no-cache\r\n"
+  "Access-Control-Allow-Origin: *\r\n"
+  "Connection: keep-alive\r\n"
+  "\r\n"
+  "retry: 3000\n\n";
+
+struct EventMsg {
+  uint32_t id;
+  char name[16];
+  char data[232];
+};
+
+struct Client {
+  bool active;
+  bool fresh;            // Needs the retained events before anything else
+  volatile bool closed;  // Set when esp_http_server drops the session under us
+  uint32_t id;
+  int fd;
+};
+
+static httpd_handle_t gServer = nullptr;
+static QueueHandle_t gQueue = nullptr;
+static TaskHandle_t gTask = nullptr;
+static Client gClients[kEventHubMaxClients] = {};
+static uint32_t gNextClientId = 1;
+static uint32_t gNextEventId = 1;
+static EventMsg gRetained[kRetained] = {};
+static EventHubStats gStats = {};
+static portMUX_TYPE gEventsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool sendAll(int fd, const char* data, size_t len) {
+  while (len > 0) {
+    int n = httpd_socket_send(gServer, fd, data, len, 0);
+    if (n <= 0) return false;
+    data += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+static int formatEvent(const EventMsg& msg, char* out, size_t cap) {
+  int n = snprintf(out, cap, "id: %u\nevent: %s\ndata: %s\n\n", (unsigned)msg.id, msg.name, msg.data);
+  return (n > 0 && (size_t)n < cap) ? n : 0;
+}
+
+static void dropClient(Client& c) {
+  if (!c.closed) httpd_sess_trigger_close(gServer, c.fd);
+  portENTER_CRITICAL(&gEventsMux);
+  c.active = false;
+  gStats.clients--;
+  gStats.disconnects++;
+  portEXIT_CRITICAL(&gEventsMux);
+}
+
+// Sends to every live client; new clients first get the head and the retained
+// events, which already include `msg` when it is one of them.
+static void broadcast(const char* text, size_t len) {
+  for (int i = 0; i < kEventHubMaxClients; ++i) {
+    Client& c = gClients[i];
+    portENTER_CRITICAL(&gEventsMux);
+    bool active = c.active;
+    bool closed = c.closed;
+    bool fresh = c.fresh;
+    c.fresh = false;
+    portEXIT_CRITICAL(&gEventsMux);
+    if (!active) continue;
+    if (closed) {
+      dropClient(c);
+      continue;
+    }
+
+    bool ok = true;
+    if (fresh) {
+      ok = sendAll(c.fd, kEventsResponseHead, strlen(kEventsResponseHead));
+      for (int r = 0; ok && r < kRetained; ++r) {
+        EventMsg retained;
+        portENTER_CRITICAL(&gEventsMux);
+        retained = gRetained[r];
+        portEXIT_CRITICAL(&gEventsMux);
+        if (!retained.id) continue;
+        char buf[sizeof(EventMsg) + 32];
+        int n = formatEvent(retained, buf, sizeof(buf));
+        if (n) ok = sendAll(c.fd, buf, n);
+      }
+    } else if (len) {
+      ok = sendAll(c.fd, text, len);
+    }
+    if (!ok) dropClient(c);
+  }
+}
+
+static void eventsTask(void*) {
+  uint32_t lastSendMs = millis();
+  for (;;) {
+    EventMsg msg;
+    // Woken by publishes and new clients (a zero-id message); otherwise by the heartbeat.
+    if (xQueueReceive(gQueue, &msg, pdMS_TO_TICKS(kHeartbeatMs)) == pdTRUE) {
+      char buf[sizeof(EventMsg) + 32];
+      int n = msg.id ? formatEvent(msg, buf, sizeof(buf)) : 0;
+      broadcast(buf, n);
+      if (n) lastSendMs = millis();
+      continue;
+    }
+    if (millis() - lastSendMs >= kHeartbeatMs) {
+      char hb[32];
+      int n = snprintf(hb, sizeof(hb), ": hb %lu\n\n", (unsigned long)millis());
+      broadcast(hb, n);
+      lastSendMs = millis();
+      portENTER_CRITICAL(&gEventsMux);
+      gStats.heartbeats++;
+      portEXIT_CRITICAL(&gEventsMux);
+    }
+  }
+}
+
+// Context is the client id, as in stream_hub, so a recycled slot is never
+// confused with the connection it replaced.
+static void onSessionClosed(void* ctx) {
+  uint32_t id = (uint32_t)(uintptr_t)ctx;
+  portENTER_CRITICAL(&gEventsMux);
+  for (int i = 0; i < kEventHubMaxClients; ++i) {
+    if (gClients[i].active && gClients[i].id == id) gClients[i].closed = true;
+  }
+  portEXIT_CRITICAL(&gEventsMux);
+}
+
+bool eventHubBegin(httpd_handle_t server) {
+  gServer = server;
+  if (!gQueue) gQueue = xQueueCreate(kQueueDepth, sizeof(EventMsg));
+  if (!gQueue) return false;
+  if (!gTask) {
+    xTaskCreatePinnedToCore(eventsTask, "events", kTaskStack, nullptr, 2, &gTask, tskNO_AFFINITY);
+  }
+  return gTask != nullptr;
+}
+
+bool eventHubSubscribe(httpd_req_t* req) {
+  if (!gTask) return false;
+  int fd = httpd_req_to_sockfd(req);
+  Client* client = nullptr;
+  portENTER_CRITICAL(&gEventsMux);
+  for (int i = 0; i < kEventHubMaxClients; ++i) {
+    if (!gClients[i].active) {
+      client = &gClients[i];
+      client->active = true;
+      client->fresh = true;
+      client->closed = false;
+      client->id = gNextClientId++;
+      client->fd = fd;
+      gStats.clients++;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&gEventsMux);
+  if (!client) return false;
+
+  struct timeval tv = {kSendTimeoutMs / 1000, (kSendTimeoutMs % 1000) * 1000};
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  req->sess_ctx = (void*)(uintptr_t)client->id;
+  req->free_ctx = onSessionClosed;
+
+  EventMsg wake = {};
+  xQueueSend(gQueue, &wake, 0);
+  return true;
+}
+
+bool eventHubPublish(const char* name, const char* json) {
+  if (!gQueue || !name || !json) return false;
+  EventMsg msg;
+  snprintf(msg.name, sizeof(msg.name), "%s", name);
+  snprintf(msg.data, sizeof(msg.data), "%s", json);
+
+  portENTER_CRITICAL(&gEventsMux);
+  msg.id = gNextEventId++;
+  if (!gNextEventId) gNextEventId = 1;
+  int slot = -1;
+  for (int i = 0; i < kRetained; ++i) {
+    if (gRetained[i].id && strcmp(gRetained[i].name, msg.name) == 0) {
+      slot = i;
+      break;
+    }
+    if (slot < 0 && !gRetained[i].id) slot = i;
+  }
+  if (slot >= 0) gRetained[slot] = msg;
+  portEXIT_CRITICAL(&gEventsMux);
+
+  bool queued = xQueueSend(gQueue, &msg, 0) == pdTRUE;
+  portENTER_CRITICAL(&gEventsMux);
+  if (queued) {
+    gStats.published++;
+  } else {
+    gStats.dropped++;
+  }
+  portEXIT_CRITICAL(&gEventsMux);
+  return queued;
+}
+
+void eventHubGetStats(EventHubStats& out) {
+  portENTER_CRITICAL(&gEventsMux);
+  out = gStats;
+  portEXIT_CRITICAL(&gEventsMux);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <Arduino.h>
+#include "esp_http_server.h"
+
+// Server-Sent Events push channel on the port 81 server. Like stream_hub, the
+// handler hands the connection to the hub and returns; one sender task writes
+// every event to every client and sends a heartbeat comment when idle, so
+// clients can drop their /status polling.
+//
+// The last payload of each event name is retained and replayed to clients
+// when they connect, so a new page starts with the current state.
+
+static const int kEventHubMaxClients = 4;
+
+struct EventHubStats {
+  uint8_t clients;
+  uint32_t published;   // Events accepted by eventHubPublish
+  uint32_t dropped;     // Events lost because the queue was full
+  uint32_t heartbeats;
+  uint32_t disconnects; // Clients dropped after a failed or timed-out send
+};
+
+bool eventHubBegin(httpd_handle_t server);
+
+// Takes over the connection behind `req` (the handler must return right after).
+// Returns false when the client limit is reached.
+bool eventHubSubscribe(httpd_req_t* req);
+
+// Queues `event: <name>` with a single-line JSON payload for every client.
+// Safe from any task; never blocks. Returns false if the event was dropped.
+bool eventHubPublish(const char* name, const char* json);
+
+void eventHubGetStats(EventHubStats& out);
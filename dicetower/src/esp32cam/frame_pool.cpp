@@ -0,0 +1,119 @@
+#include "frame_pool.h"
+#include <string.h>
+#include "esp_heap_caps.h"
+
+// GRAY: overlay fallback plus one luma frame per detection task (pipeline
+// upload stage, roll-settle). JPEG: the four stream_hub ring slots, one frame
+// per detect_pipeline stage and the tray crop being cut from one of them.
+static const uint8_t kSlotsPerKind[FRAME_POOL_KIND_COUNT] = {3, 8};
+static const uint8_t kMaxSlots = 8;
+
+struct PoolSlot {
+  uint8_t* buf;
+  bool leased;
+};
+
+static PoolSlot gSlots[FRAME_POOL_KIND_COUNT][kMaxSlots] = {};
+static FramePoolStats gStats = {};
+static portMUX_TYPE gPoolMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void freeSlots() {
+  for (int k = 0; k < FRAME_POOL_KIND_COUNT; ++k) {
+    for (int i = 0; i < kMaxSlots; ++i) {
+      if (gSlots[k][i].buf) heap_caps_free(gSlots[k][i].buf);
+      gSlots[k][i].buf = nullptr;
+      gSlots[k][i].leased = false;
+    }
+    gStats.slots[k] = 0;
+    gStats.slotBytes[k] = 0;
+  }
+}
+
+// An overlaid frame re-encoded at quality 80 stays well under half a byte
+// per pixel; the encoder reports overflow rather than writing past the slot.
+static void slotBytesFor(int maxWidth, int maxHeight, size_t* bytes) {
+  const size_t pixels = (size_t)maxWidth * (size_t)maxHeight;
+  bytes[FRAME_POOL_GRAY] = pixels;
+  bytes[FRAME_POOL_JPEG] = pixels / 2;
+}
+
+size_t framePoolBytesFor(int maxWidth, int maxHeight) {
+  size_t bytes[FRAME_POOL_KIND_COUNT];
+  slotBytesFor(maxWidth, maxHeight, bytes);
+  size_t total = 0;
+  for (int k = 0; k < FRAME_POOL_KIND_COUNT; ++k) total += bytes[k] * kSlotsPerKind[k];
+  return total;
+}
+
+bool framePoolBegin(int maxWidth, int maxHeight) {
+  for (int k = 0; k < FRAME_POOL_KIND_COUNT; ++k) {
+    if (gStats.inUse[k] != 0) return false;
+  }
+  freeSlots();
+  if (maxWidth <= 0 || maxHeight <= 0 || !psramFound()) return false;
+
+  size_t bytes[FRAME_POOL_KIND_COUNT];
+  slotBytesFor(maxWidth, maxHeight, bytes);
+
+  bool ok = true;
+  for (int k = 0; k < FRAME_POOL_KIND_COUNT; ++k) {
+    for (int i = 0; i < kSlotsPerKind[k]; ++i) {
+      uint8_t* buf = (uint8_t*)heap_caps_malloc(bytes[k], MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+      if (!buf) {
+        ok = false;
+        break;
+      }
+      gSlots[k][i].buf = buf;
+      gStats.slots[k]++;
+    }
+    gStats.slotBytes[k] = gStats.slots[k] ? bytes[k] : 0;
+  }
+  return ok;
+}
+
+uint8_t* framePoolAcquire(FramePoolKind kind, size_t bytes) {
+  uint8_t* out = nullptr;
+  portENTER_CRITICAL(&gPoolMux);
+  if (bytes <= gStats.slotBytes[kind]) {
+    for (int i = 0; i < gStats.slots[kind]; ++i) {
+      if (!gSlots[kind][i].leased) {
+        gSlots[kind][i].leased = true;
+        out = gSlots[kind][i].buf;
+        break;
+      }
+    }
+  }
+  if (out) {
+    gStats.leases++;
+    gStats.inUse[kind]++;
+    if (gStats.inUse[kind] > gStats.peakInUse[kind]) gStats.peakInUse[kind] = gStats.inUse[kind];
+  } else {
+    gStats.failures++;
+  }
+  portEXIT_CRITICAL(&gPoolMux);
+  return out;
+}
+
+void framePoolRelease(uint8_t* buf) {
+  if (!buf) return;
+  portENTER_CRITICAL(&gPoolMux);
+  for (int k = 0; k < FRAME_POOL_KIND_COUNT; ++k) {
+    for (int i = 0; i < gStats.slots[k]; ++i) {
+      if (gSlots[k][i].buf == buf && gSlots[k][i].leased) {
+        gSlots[k][i].leased = false;
+        gStats.inUse[k]--;
+      }
+    }
+  }
+  portEXIT_CRITICAL(&gPoolMux);
+}
+
+size_t framePoolSlotBytes(FramePoolKind kind) {
+  return gStats.slotBytes[kind];
+}
+
+void framePoolGetStats(FramePoolStats& out) {
+  portENTER_CRITICAL(&gPoolMux);
+  out = gStats;
+  portEXIT_CRITICAL(&gPoolMux);
+}
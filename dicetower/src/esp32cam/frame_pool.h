@@ -0,0 +1,37 @@
+#pragma once
+#include <Arduino.h>
+
+// Kinds of per-frame scratch buffers handed out by the pool.
+enum FramePoolKind {
+  FRAME_POOL_GRAY = 0,  // 8-bit luma decode target (width * height)
+  FRAME_POOL_JPEG = 1,  // Whole JPEG frame (stream ring slots, tray crops)
+  FRAME_POOL_KIND_COUNT
+};
+
+struct FramePoolStats {
+  size_t slotBytes[FRAME_POOL_KIND_COUNT];
+  uint8_t slots[FRAME_POOL_KIND_COUNT];
+  uint8_t inUse[FRAME_POOL_KIND_COUNT];
+  uint8_t peakInUse[FRAME_POOL_KIND_COUNT];
+  uint32_t leases;
+  uint32_t failures;  // Lease requests that found no free or large-enough slot
+};
+
+// Preallocates every slot in PSRAM, sized for frames up to maxWidth x maxHeight.
+// Call once at boot; safe to call again only while nothing is leased.
+bool framePoolBegin(int maxWidth, int maxHeight);
+
+// PSRAM framePoolBegin would allocate for frames up to maxWidth x maxHeight.
+size_t framePoolBytesFor(int maxWidth, int maxHeight);
+
+// Leases a buffer of at least `bytes`. Returns nullptr (and counts a failure)
+// when the pool is exhausted or the request exceeds the slot size.
+uint8_t* framePoolAcquire(FramePoolKind kind, size_t bytes);
+
+// Returns a leased buffer. Passing nullptr is a no-op.
+void framePoolRelease(uint8_t* buf);
+
+// Capacity of one slot of the given kind (0 if the pool is not allocated).
+size_t framePoolSlotBytes(FramePoolKind kind);
+
+void framePoolGetStats(FramePoolStats& out);
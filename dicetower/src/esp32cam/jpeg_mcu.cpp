@@ -0,0 +1,718 @@
+#include "jpeg_mcu.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+// Zigzag position -> natural (row-major) index.
+const uint8_t kZigzag[64] = {
+   0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+  12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+  35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+  58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+const int kMaxComponents = 3;
+const int kLookBits = 8;
+
+struct HuffTable {
+  bool present;
+  // Decoding (canonical code ranges per length plus an 8-bit lookahead).
+  int32_t maxcode[18];
+  int32_t valptr[17];
+  int32_t mincode[17];
+  uint8_t vals[256];
+  uint8_t lookLen[1 << kLookBits];
+  uint8_t lookVal[1 << kLookBits];
+  // Encoding.
+  uint16_t code[256];
+  uint8_t size[256];
+};
+
+struct Component {
+  uint8_t id;
+  uint8_t h;
+  uint8_t v;
+  uint8_t tq;
+  uint8_t td;
+  uint8_t ta;
+  int dcPred;
+};
+
+struct BitReader {
+  const uint8_t* p;
+  const uint8_t* end;
+  uint32_t buf;
+  int bits;
+  bool marker;  // Reached a marker: feed zero bits until reset()
+};
+
+struct BitWriter {
+  uint8_t* p;
+  uint8_t* end;
+  uint32_t buf;
+  int bits;
+  bool overflow;
+};
+
+}  // namespace
+
+struct JpegCodec {
+  int width;
+  int height;
+  int ncomp;
+  int mcuW;
+  int mcuH;
+  int mcusX;
+  int mcusY;
+  int restartInterval;
+  Component comp[kMaxComponents];
+  const uint8_t* qt[4];
+  HuffTable dc[2];
+  HuffTable ac[2];
+  size_t scanStart;
+  size_t scanEnd;
+  int16_t encPred[kMaxComponents];
+};
+
+namespace {
+
+float gDct[8][8];  // gDct[x][u] = C(u)/2 * cos((2x+1)u*pi/16), orthonormal
+bool gDctReady = false;
+
+void initDct() {
+  if (gDctReady) return;
+  for (int x = 0; x < 8; ++x) {
+    for (int u = 0; u < 8; ++u) {
+      float cu = (u == 0) ? 0.70710678f : 1.0f;
+      gDct[x][u] = 0.5f * cu * cosf((2 * x + 1) * u * 3.14159265f / 16.0f);
+    }
+  }
+  gDctReady = true;
+}
+
+// Natural-order coefficients -> level-shifted pixels.
+void idct8x8(const float* in, uint8_t* out) {
+  float tmp[64];
+  for (int u = 0; u < 8; ++u) {
+    for (int y = 0; y < 8; ++y) {
+      float s = 0;
+      for (int v = 0; v < 8; ++v) s += gDct[y][v] * in[v * 8 + u];
+      tmp[y * 8 + u] = s;
+    }
+  }
+  for (int y = 0; y < 8; ++y) {
+    for (int x = 0; x < 8; ++x) {
+      float s = 128.0f;
+      for (int u = 0; u < 8; ++u) s += gDct[x][u] * tmp[y * 8 + u];
+      int p = (int)lroundf(s);
+      out[y * 8 + x] = (uint8_t)(p < 0 ? 0 : (p > 255 ? 255 : p));
+    }
+  }
+}
+
+// Pixels -> natural-order coefficients.
+void fdct8x8(const uint8_t* in, float* out) {
+  float tmp[64];
+  for (int y = 0; y < 8; ++y) {
+    for (int u = 0; u < 8; ++u) {
+      float s = 0;
+      for (int x = 0; x < 8; ++x) s += gDct[x][u] * ((float)in[y * 8 + x] - 128.0f);
+      tmp[y * 8 + u] = s;
+    }
+  }
+  for (int v = 0; v < 8; ++v) {
+    for (int u = 0; u < 8; ++u) {
+      float s = 0;
+      for (int y = 0; y < 8; ++y) s += gDct[y][v] * tmp[y * 8 + u];
+      out[v * 8 + u] = s;
+    }
+  }
+}
+
+inline uint16_t be16(const uint8_t* p) {
+  return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+bool buildHuffTable(HuffTable& t, const uint8_t* counts, const uint8_t* vals, int nvals) {
+  memset(&t, 0, sizeof(t));
+  memcpy(t.vals, vals, nvals);
+  int code = 0;
+  int k = 0;
+  for (int len = 1; len <= 16; ++len) {
+    t.valptr[len] = k;
+    t.mincode[len] = code;
+    for (int i = 0; i < counts[len - 1]; ++i) {
+      uint8_t sym = vals[k];
+      t.code[sym] = (uint16_t)code;
+      t.size[sym] = (uint8_t)len;
+      if (len <= kLookBits) {
+        int shift = kLookBits - len;
+        for (int fill = 0; fill < (1 << shift); ++fill) {
+          int idx = (code << shift) | fill;
+          t.lookLen[idx] = (uint8_t)len;
+          t.lookVal[idx] = sym;
+        }
+      }
+      ++code;
+      ++k;
+    }
+    t.maxcode[len] = counts[len - 1] ? code - 1 : -1;
+    if (code > (1 << len)) return false;  // Over-subscribed table
+    code <<= 1;
+  }
+  t.maxcode[17] = 0x7fffffff;
+  t.present = true;
+  return true;
+}
+
+bool parseHeaders(JpegCodec& c, const uint8_t* src, size_t len) {
+  if (len < 4 || src[0] != 0xFF || src[1] != 0xD8) return false;
+  bool haveFrame = false;
+  memset(c.qt, 0, sizeof(c.qt));
+  c.restartInterval = 0;
+  for (int i = 0; i < 2; ++i) {
+    c.dc[i].present = false;
+    c.ac[i].present = false;
+  }
+
+  size_t pos = 2;
+  while (pos + 4 <= len) {
+    if (src[pos] != 0xFF) return false;
+    uint8_t marker = src[pos + 1];
+    if (marker == 0xFF) { ++pos; continue; }
+    size_t segLen = be16(src + pos + 2);
+    const uint8_t* seg = src + pos + 4;
+    size_t segEnd = pos + 2 + segLen;
+    if (segLen < 2 || segEnd > len) return false;
+
+    switch (marker) {
+      case 0xDB: {  // DQT
+        const uint8_t* q = seg;
+        while (q < src + segEnd) {
+          if ((q[0] >> 4) != 0 || q + 65 > src + segEnd) return false;  // 8-bit tables only
+          c.qt[q[0] & 3] = q + 1;
+          q += 65;
+        }
+        break;
+      }
+      case 0xC4: {  // DHT
+        const uint8_t* h = seg;
+        while (h + 17 <= src + segEnd) {
+          int tc = h[0] >> 4;
+          int th = h[0] & 15;
+          int nvals = 0;
+          for (int i = 0; i < 16; ++i) nvals += h[1 + i];
+          if (th > 1 || tc > 1 || nvals > 256 || h + 17 + nvals > src + segEnd) return false;
+          HuffTable& t = tc ? c.ac[th] : c.dc[th];
+          if (!buildHuffTable(t, h + 1, h + 17, nvals)) return false;
+          h += 17 + nvals;
+        }
+        break;
+      }
+      case 0xC0:
+      case 0xC1: {  // Baseline / extended sequential, Huffman
+        if (seg[0] != 8) return false;
+        c.height = be16(seg + 1);
+        c.width = be16(seg + 3);
+        c.ncomp = seg[5];
+        if (c.ncomp != 1 && c.ncomp != 3) return false;
+        int hmax = 1, vmax = 1;
+        for (int i = 0; i < c.ncomp; ++i) {
+          const uint8_t* cs = seg + 6 + i * 3;
+          c.comp[i].id = cs[0];
+          c.comp[i].h = cs[1] >> 4;
+          c.comp[i].v = cs[1] & 15;
+          c.comp[i].tq = cs[2] & 3;
+          if (c.comp[i].h < 1 || c.comp[i].h > 2 || c.comp[i].v < 1 || c.comp[i].v > 2) return false;
+          if (c.comp[i].h > hmax) hmax = c.comp[i].h;
+          if (c.comp[i].v > vmax) vmax = c.comp[i].v;
+        }
+        if (c.ncomp == 1) {
+          // A single-component scan is never interleaved: one block per MCU.
+          c.comp[0].h = c.comp[0].v = 1;
+          hmax = vmax = 1;
+        }
+        c.mcuW = 8 * hmax;
+        c.mcuH = 8 * vmax;
+        c.mcusX = (c.width + c.mcuW - 1) / c.mcuW;
+        c.mcusY = (c.height + c.mcuH - 1) / c.mcuH;
+        haveFrame = true;
+        break;
+      }
+      case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+      case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+        return false;  // Progressive, lossless or arithmetic coding
+      case 0xDD:  // DRI
+        c.restartInterval = be16(seg);
+        break;
+      case 0xDA: {  // SOS: must cover every component in one full-spectrum scan
+        if (!haveFrame || seg[0] != c.ncomp) return false;
+        for (int i = 0; i < c.ncomp; ++i) {
+          const uint8_t* cs = seg + 1 + i * 2;
+          if (cs[0] != c.comp[i].id) return false;
+          c.comp[i].td = cs[1] >> 4;
+          c.comp[i].ta = cs[1] & 15;
+          if (c.comp[i].td > 1 || c.comp[i].ta > 1) return false;
+          if (!c.dc[c.comp[i].td].present || !c.ac[c.comp[i].ta].present || !c.qt[c.comp[i].tq]) return false;
+        }
+        const uint8_t* spec = seg + 1 + c.ncomp * 2;
+        if (spec[0] != 0 || spec[1] != 63 || spec[2] != 0) return false;
+        c.scanStart = segEnd;
+        // The scan runs until the first marker that is neither stuffing nor RSTn.
+        size_t e = segEnd;
+        while (e + 1 < len && !(src[e] == 0xFF && src[e + 1] != 0x00 && (src[e + 1] < 0xD0 || src[e + 1] > 0xD7))) ++e;
+        c.scanEnd = (e + 1 < len) ? e : len;
+        return true;
+      }
+      default:
+        break;  // APPn, COM, etc. are copied verbatim
+    }
+    pos = segEnd;
+  }
+  return false;
+}
+
+inline void brFill(BitReader& br) {
+  while (br.bits <= 24) {
+    uint32_t byte = 0;
+    if (!br.marker && br.p < br.end) {
+      byte = *br.p;
+      if (byte == 0xFF) {
+        uint8_t next = (br.p + 1 < br.end) ? br.p[1] : 0xD9;
+        if (next == 0x00) {
+          br.p += 2;
+        } else {
+          br.marker = true;
+          byte = 0;
+        }
+      } else {
+        ++br.p;
+      }
+    } else {
+      br.marker = true;
+    }
+    br.buf |= byte << (24 - br.bits);
+    br.bits += 8;
+  }
+}
+
+inline uint32_t brGet(BitReader& br, int n) {
+  if (n == 0) return 0;
+  brFill(br);
+  uint32_t v = br.buf >> (32 - n);
+  br.buf <<= n;
+  br.bits -= n;
+  return v;
+}
+
+// Drops buffered padding and consumes the RSTn marker that must follow.
+bool brRestart(BitReader& br) {
+  br.buf = 0;
+  br.bits = 0;
+  br.marker = false;
+  if (br.p + 1 < br.end && br.p[0] == 0xFF && br.p[1] >= 0xD0 && br.p[1] <= 0xD7) {
+    br.p += 2;
+    return true;
+  }
+  return false;
+}
+
+inline int decodeSymbol(BitReader& br, const HuffTable& t) {
+  brFill(br);
+  uint32_t look = br.buf >> (32 - kLookBits);
+  int len = t.lookLen[look];
+  if (len) {
+    br.buf <<= len;
+    br.bits -= len;
+    return t.lookVal[look];
+  }
+  for (len = kLookBits + 1; len <= 16; ++len) {
+    int32_t code = (int32_t)(br.buf >> (32 - len));
+    if (code <= t.maxcode[len]) {
+      br.buf <<= len;
+      br.bits -= len;
+      return t.vals[t.valptr[len] + code - t.mincode[len]];
+    }
+  }
+  return -1;
+}
+
+inline int extend(uint32_t v, int s) {
+  return (v < (1u << (s - 1))) ? (int)v - (1 << s) + 1 : (int)v;
+}
+
+// Decodes one block into zigzag-ordered coefficients with an absolute DC.
+bool decodeBlock(BitReader& br, const HuffTable& dc, const HuffTable& ac, int& pred, int16_t* zz) {
+  memset(zz, 0, 64 * sizeof(int16_t));
+  int s = decodeSymbol(br, dc);
+  if (s < 0 || s > 11) return false;
+  pred += s ? extend(brGet(br, s), s) : 0;
+  zz[0] = (int16_t)pred;
+  for (int k = 1; k < 64;) {
+    int rs = decodeSymbol(br, ac);
+    if (rs < 0) return false;
+    int r = rs >> 4;
+    s = rs & 15;
+    if (s == 0) {
+      if (r != 15) break;  // EOB
+      k += 16;             // ZRL
+      continue;
+    }
+    k += r;
+    if (k > 63) return false;
+    zz[k++] = (int16_t)extend(brGet(br, s), s);
+  }
+  return true;
+}
+
+inline void bwEmit(BitWriter& bw, uint8_t byte) {
+  if (bw.p + 2 > bw.end) {
+    bw.overflow = true;
+    return;
+  }
+  *bw.p++ = byte;
+  if (byte == 0xFF) *bw.p++ = 0x00;
+}
+
+inline void bwPut(BitWriter& bw, uint32_t code, int size) {
+  bw.buf = (bw.buf << size) | (code & ((1u << size) - 1));
+  bw.bits += size;
+  while (bw.bits >= 8) {
+    bwEmit(bw, (uint8_t)(bw.buf >> (bw.bits - 8)));
+    bw.bits -= 8;
+  }
+  bw.buf &= (1u << bw.bits) - 1;
+}
+
+// Pads the last byte with 1-bits, as the standard requires before a marker.
+void bwFlush(BitWriter& bw) {
+  if (bw.bits > 0) bwPut(bw, 0x7F, 8 - bw.bits);
+}
+
+void bwMarker(BitWriter& bw, uint8_t marker) {
+  if (bw.p + 2 > bw.end) {
+    bw.overflow = true;
+    return;
+  }
+  *bw.p++ = 0xFF;
+  *bw.p++ = marker;
+}
+
+inline int bitLength(int v) {
+  if (v < 0) v = -v;
+  int n = 0;
+  while (v) {
+    ++n;
+    v >>= 1;
+  }
+  return n;
+}
+
+bool encodeBlock(BitWriter& bw, const HuffTable& dc, const HuffTable& ac, int16_t& pred, const int16_t* zz) {
+  int diff = zz[0] - pred;
+  pred = zz[0];
+  int n = bitLength(diff);
+  if (!dc.size[n]) return false;
+  bwPut(bw, dc.code[n], dc.size[n]);
+  if (n) bwPut(bw, (uint32_t)(diff < 0 ? diff - 1 : diff), n);
+
+  int run = 0;
+  for (int k = 1; k < 64; ++k) {
+    int v = zz[k];
+    if (v == 0) {
+      ++run;
+      continue;
+    }
+    while (run > 15) {
+      if (!ac.size[0xF0]) return false;
+      bwPut(bw, ac.code[0xF0], ac.size[0xF0]);
+      run -= 16;
+    }
+    n = bitLength(v);
+    uint8_t sym = (uint8_t)((run << 4) | n);
+    if (!ac.size[sym]) return false;
+    bwPut(bw, ac.code[sym], ac.size[sym]);
+    bwPut(bw, (uint32_t)(v < 0 ? v - 1 : v), n);
+    run = 0;
+  }
+  if (run > 0) {
+    if (!ac.size[0x00]) return false;
+    bwPut(bw, ac.code[0x00], ac.size[0x00]);
+  }
+  return !bw.overflow;
+}
+
+bool blockTouches(int x0, int y0, const JpegRect* rects, int count) {
+  for (int i = 0; i < count; ++i) {
+    const JpegRect& r = rects[i];
+    if (r.w <= 0 || r.h <= 0) continue;
+    if (x0 < r.x + r.w && x0 + 8 > r.x && y0 < r.y + r.h && y0 + 8 > r.y) return true;
+  }
+  return false;
+}
+
+// Dequantize -> IDCT -> paint -> FDCT -> quantize, all in place on zz.
+void repaintBlock(int16_t* zz, const uint8_t* q, int x0, int y0, JpegLumaPainter paint, void* ctx) {
+  float coef[64];
+  for (int k = 0; k < 64; ++k) coef[kZigzag[k]] = (float)zz[k] * q[k];
+  uint8_t tile[64];
+  idct8x8(coef, tile);
+  paint(ctx, x0, y0, tile);
+  fdct8x8(tile, coef);
+  for (int k = 0; k < 64; ++k) {
+    int limit = (k == 0) ? 2047 : 1023;
+    int v = (int)lroundf(coef[kZigzag[k]] / (float)(q[k] ? q[k] : 1));
+    zz[k] = (int16_t)(v < -limit ? -limit : (v > limit ? limit : v));
+  }
+}
+
+}  // namespace
+
+JpegCodec* jpegCodecCreate() {
+  initDct();
+  JpegCodec* codec = (JpegCodec*)calloc(1, sizeof(JpegCodec));
+  return codec;
+}
+
+void jpegCodecDestroy(JpegCodec* codec) {
+  free(codec);
+}
+
+size_t jpegPaintLuma(JpegCodec* codec, const uint8_t* src, size_t srcLen,
+                     const JpegRect* rects, int rectCount,
+                     JpegLumaPainter paint, void* ctx,
+                     uint8_t* dst, size_t dstCap) {
+  if (!codec || !src || !dst || !paint) return 0;
+  JpegCodec& c = *codec;
+  if (!parseHeaders(c, src, srcLen) || c.scanStart + 2 > dstCap) return 0;
+
+  memcpy(dst, src, c.scanStart);
+  BitReader br = {src + c.scanStart, src + c.scanEnd, 0, 0, false};
+  BitWriter bw = {dst + c.scanStart, dst + dstCap - 2, 0, 0, false};  // Reserve EOI
+  int decPred[kMaxComponents] = {0, 0, 0};
+  for (int i = 0; i < kMaxComponents; ++i) c.encPred[i] = 0;
+
+  int16_t zz[64];
+  int mcuCount = 0;
+  for (int my = 0; my < c.mcusY; ++my) {
+    for (int mx = 0; mx < c.mcusX; ++mx) {
+      if (c.restartInterval && mcuCount > 0 && mcuCount % c.restartInterval == 0) {
+        if (!brRestart(br)) return 0;
+        bwFlush(bw);
+        bwMarker(bw, (uint8_t)(0xD0 + ((mcuCount / c.restartInterval - 1) & 7)));
+        for (int i = 0; i < kMaxComponents; ++i) {
+          decPred[i] = 0;
+          c.encPred[i] = 0;
+        }
+      }
+      for (int ci = 0; ci < c.ncomp; ++ci) {
+        const Component& comp = c.comp[ci];
+        const HuffTable& dc = c.dc[comp.td];
+        const HuffTable& ac = c.ac[comp.ta];
+        for (int by = 0; by < comp.v; ++by) {
+          for (int bx = 0; bx < comp.h; ++bx) {
+            if (!decodeBlock(br, dc, ac, decPred[ci], zz)) return 0;
+            if (ci == 0) {
+              int x0 = mx * c.mcuW + bx * 8;
+              int y0 = my * c.mcuH + by * 8;
+              if (blockTouches(x0, y0, rects, rectCount)) {
+                repaintBlock(zz, c.qt[comp.tq], x0, y0, paint, ctx);
+              }
+            }
+            if (!encodeBlock(bw, dc, ac, c.encPred[ci], zz)) return 0;
+          }
+        }
+      }
+      ++mcuCount;
+    }
+  }
+  bwFlush(bw);
+  if (bw.overflow) return 0;
+  *bw.p++ = 0xFF;
+  *bw.p++ = 0xD9;
+  return (size_t)(bw.p - dst);
+}
+
+bool jpegLumaThumbnail(JpegCodec* codec, const uint8_t* src, size_t srcLen,
+                       uint8_t* out, size_t outCap, int* outW, int* outH) {
+  if (!codec || !src || !out) return false;
+  JpegCodec& c = *codec;
+  if (!parseHeaders(c, src, srcLen)) return false;
+  int tw = (c.width + 7) / 8;
+  int th = (c.height + 7) / 8;
+  if ((size_t)tw * th > outCap) return false;
+
+  BitReader br = {src + c.scanStart, src + c.scanEnd, 0, 0, false};
+  int decPred[kMaxComponents] = {0, 0, 0};
+  const int dcScale = c.qt[c.comp[0].tq][0];
+
+  int16_t zz[64];
+  int mcuCount = 0;
+  for (int my = 0; my < c.mcusY; ++my) {
+    for (int mx = 0; mx < c.mcusX; ++mx) {
+      if (c.restartInterval && mcuCount > 0 && mcuCount % c.restartInterval == 0) {
+        if (!brRestart(br)) return false;
+        for (int i = 0; i < kMaxComponents; ++i) decPred[i] = 0;
+      }
+      for (int ci = 0; ci < c.ncomp; ++ci) {
+        const Component& comp = c.comp[ci];
+        for (int by = 0; by < comp.v; ++by) {
+          for (int bx = 0; bx < comp.h; ++bx) {
+            if (!decodeBlock(br, c.dc[comp.td], c.ac[comp.ta], decPred[ci], zz)) return false;
+            if (ci != 0) continue;
+            int tx = (mx * c.mcuW) / 8 + bx;
+            int ty = (my * c.mcuH) / 8 + by;
+            if (tx >= tw || ty >= th) continue;
+            // Orthonormal DCT: block mean = DC * q / 8, plus the level shift.
+            int v = (zz[0] * dcScale) / 8 + 128;
+            out[ty * tw + tx] = (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+          }
+        }
+      }
+      ++mcuCount;
+    }
+  }
+  if (outW) *outW = tw;
+  if (outH) *outH = th;
+  return true;
+}
+
+size_t jpegCrop(JpegCodec* codec, const uint8_t* src, size_t srcLen,
+                const JpegRect& roi, uint8_t* dst, size_t dstCap, JpegRect* outRect) {
+  if (!codec || !src || !dst) return 0;
+  JpegCodec& c = *codec;
+  if (!parseHeaders(c, src, srcLen)) return 0;
+
+  int rx0 = roi.x < 0 ? 0 : roi.x;
+  int ry0 = roi.y < 0 ? 0 : roi.y;
+  int rx1 = roi.x + roi.w > c.width ? c.width : roi.x + roi.w;
+  int ry1 = roi.y + roi.h > c.height ? c.height : roi.y + roi.h;
+  if (rx1 <= rx0 || ry1 <= ry0) return 0;
+  int mx0 = rx0 / c.mcuW;
+  int my0 = ry0 / c.mcuH;
+  int mx1 = (rx1 + c.mcuW - 1) / c.mcuW;
+  int my1 = (ry1 + c.mcuH - 1) / c.mcuH;
+  int x0 = mx0 * c.mcuW;
+  int y0 = my0 * c.mcuH;
+  int outW = (mx1 * c.mcuW > c.width ? c.width : mx1 * c.mcuW) - x0;
+  int outH = (my1 * c.mcuH > c.height ? c.height : my1 * c.mcuH) - y0;
+
+  // Headers: copy every segment up to and including SOS, patching SOF and
+  // dropping DRI (the cropped scan has no restart markers).
+  uint8_t* out = dst;
+  uint8_t* outEnd = dst + dstCap;
+  *out++ = 0xFF;
+  *out++ = 0xD8;
+  size_t pos = 2;
+  while (pos < c.scanStart) {
+    if (src[pos + 1] == 0xFF) { ++pos; continue; }
+    uint8_t marker = src[pos + 1];
+    size_t segEnd = pos + 2 + be16(src + pos + 2);
+    if (marker != 0xDD) {
+      size_t n = segEnd - pos;
+      if (out + n + 2 > outEnd) return 0;
+      memcpy(out, src + pos, n);
+      if (marker == 0xC0 || marker == 0xC1) {
+        out[5] = (uint8_t)(outH >> 8);
+        out[6] = (uint8_t)outH;
+        out[7] = (uint8_t)(outW >> 8);
+        out[8] = (uint8_t)outW;
+      }
+      out += n;
+    }
+    pos = segEnd;
+  }
+
+  BitReader br = {src + c.scanStart, src + c.scanEnd, 0, 0, false};
+  BitWriter bw = {out, outEnd - 2, 0, 0, false};  // Reserve EOI
+  int decPred[kMaxComponents] = {0, 0, 0};
+  for (int i = 0; i < kMaxComponents; ++i) c.encPred[i] = 0;
+
+  int16_t zz[64];
+  int mcuCount = 0;
+  for (int my = 0; my < my1; ++my) {
+    for (int mx = 0; mx < c.mcusX; ++mx) {
+      if (c.restartInterval && mcuCount > 0 && mcuCount % c.restartInterval == 0) {
+        if (!brRestart(br)) return 0;
+        for (int i = 0; i < kMaxComponents; ++i) decPred[i] = 0;
+      }
+      bool keep = my >= my0 && mx >= mx0 && mx < mx1;
+      for (int ci = 0; ci < c.ncomp; ++ci) {
+        const Component& comp = c.comp[ci];
+        const HuffTable& dc = c.dc[comp.td];
+        const HuffTable& ac = c.ac[comp.ta];
+        for (int b = 0; b < comp.h * comp.v; ++b) {
+          if (!decodeBlock(br, dc, ac, decPred[ci], zz)) return 0;
+          if (keep && !encodeBlock(bw, dc, ac, c.encPred[ci], zz)) return 0;
+        }
+      }
+      ++mcuCount;
+    }
+  }
+  bwFlush(bw);
+  if (bw.overflow) return 0;
+  *bw.p++ = 0xFF;
+  *bw.p++ = 0xD9;
+  if (outRect) *outRect = {x0, y0, outW, outH};
+  return (size_t)(bw.p - dst);
+}
+
+bool jpegDecodeLuma(JpegCodec* codec, const uint8_t* src, size_t srcLen,
+                    uint8_t* out, size_t outCap, int* outW, int* outH) {
+  if (!codec || !src || !out) return false;
+  JpegCodec& c = *codec;
+  if (!parseHeaders(c, src, srcLen)) return false;
+  if ((size_t)c.width * c.height > outCap) return false;
+
+  BitReader br = {src + c.scanStart, src + c.scanEnd, 0, 0, false};
+  int decPred[kMaxComponents] = {0, 0, 0};
+  const Component& luma = c.comp[0];
+  const uint8_t* q = c.qt[luma.tq];
+
+  int16_t zz[64];
+  float coef[64];
+  uint8_t tile[64];
+  int mcuCount = 0;
+  for (int my = 0; my < c.mcusY; ++my) {
+    for (int mx = 0; mx < c.mcusX; ++mx) {
+      if (c.restartInterval && mcuCount > 0 && mcuCount % c.restartInterval == 0) {
+        if (!brRestart(br)) return false;
+        for (int i = 0; i < kMaxComponents; ++i) decPred[i] = 0;
+      }
+      for (int ci = 0; ci < c.ncomp; ++ci) {
+        const Component& comp = c.comp[ci];
+        for (int by = 0; by < comp.v; ++by) {
+          for (int bx = 0; bx < comp.h; ++bx) {
+            if (!decodeBlock(br, c.dc[comp.td], c.ac[comp.ta], decPred[ci], zz)) return false;
+            if (ci != 0) continue;
+            int x0 = mx * c.mcuW + bx * 8;
+            int y0 = my * c.mcuH + by * 8;
+            if (x0 >= c.width || y0 >= c.height) continue;
+
+            bool flat = true;
+            for (int k = 1; k < 64 && flat; ++k) flat = zz[k] == 0;
+            if (flat) {
+              int dc = zz[0] * q[0];
+              int v = (dc + (dc >= 0 ? 4 : -4)) / 8 + 128;  // Same rounding as the IDCT
+              memset(tile, v < 0 ? 0 : (v > 255 ? 255 : v), sizeof(tile));
+            } else {
+              for (int k = 0; k < 64; ++k) coef[kZigzag[k]] = (float)zz[k] * q[k];
+              idct8x8(coef, tile);
+            }
+            int tw = c.width - x0 < 8 ? c.width - x0 : 8;
+            int th = c.height - y0 < 8 ? c.height - y0 : 8;
+            for (int ty = 0; ty < th; ++ty) {
+              memcpy(out + (size_t)(y0 + ty) * c.width + x0, tile + ty * 8, tw);
+            }
+          }
+        }
+      }
+      ++mcuCount;
+    }
+  }
+  if (outW) *outW = c.width;
+  if (outH) *outH = c.height;
+  return true;
+}
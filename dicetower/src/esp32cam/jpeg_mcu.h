@@ -0,0 +1,54 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Coefficient-level editing of baseline JPEGs (the OV2640 output format).
+// The entropy-coded scan is Huffman-decoded and re-encoded with the frame's own
+// tables, so only blocks that are actually edited go through IDCT/FDCT; every
+// other block is carried over coefficient-for-coefficient and all headers are
+// copied verbatim. No Arduino dependencies, so it also builds on a host.
+
+struct JpegRect {
+  int x;
+  int y;
+  int w;
+  int h;
+};
+
+// Paints one 8x8 luma tile in place. (x0, y0) is the tile's top-left pixel in
+// the frame; tile[] is row-major and may extend past the frame edge.
+typedef void (*JpegLumaPainter)(void* ctx, int x0, int y0, uint8_t tile[64]);
+
+// Per-caller decoder/encoder state (Huffman tables, ~6 KB). Allocate once per
+// task that transcodes; instances are not shared between tasks.
+struct JpegCodec;
+JpegCodec* jpegCodecCreate();
+void jpegCodecDestroy(JpegCodec* codec);
+
+// Copies `src` to `dst`, passing every luma block that intersects one of
+// `rects` through `paint`. Returns the output length, or 0 if the input is not
+// a baseline Huffman JPEG, is corrupt, or the result does not fit in dstCap.
+size_t jpegPaintLuma(JpegCodec* codec, const uint8_t* src, size_t srcLen,
+                     const JpegRect* rects, int rectCount,
+                     JpegLumaPainter paint, void* ctx,
+                     uint8_t* dst, size_t dstCap);
+
+// Writes a 1/8-scale luma thumbnail (one pixel per 8x8 block, taken from the DC
+// coefficient, so no IDCT) into `out`, row-major. Returns false if the input is
+// not a baseline Huffman JPEG or the thumbnail needs more than outCap bytes.
+bool jpegLumaThumbnail(JpegCodec* codec, const uint8_t* src, size_t srcLen,
+                       uint8_t* out, size_t outCap, int* outW, int* outH);
+
+// Losslessly crops `src` to the MCU-aligned rectangle that covers `roi`
+// (clamped to the frame): blocks inside are re-entropy-coded unchanged, blocks
+// outside are dropped, SOF is rewritten and restart markers are removed.
+// `outRect` receives the rectangle actually kept, in source pixels. Returns the
+// output length, or 0 on unsupported/corrupt input, an empty ROI or overflow.
+size_t jpegCrop(JpegCodec* codec, const uint8_t* src, size_t srcLen,
+                const JpegRect& roi, uint8_t* dst, size_t dstCap, JpegRect* outRect);
+
+// Decodes only the luma plane into `out` (width * height bytes, row-major).
+// Chroma is entropy-decoded and discarded; blocks without AC terms skip the
+// IDCT. Returns false on unsupported/corrupt input or if outCap is too small.
+bool jpegDecodeLuma(JpegCodec* codec, const uint8_t* src, size_t srcLen,
+                    uint8_t* out, size_t outCap, int* outW, int* outH);
@@ -11,6 +11,23 @@
 #include "esp_camera.h"
 #include "esp_http_server.h"
 #include "dice_detection.h"
+#include "frame_pool.h"
+#include "stream_hub.h"
+#include "jpeg_mcu.h"
+#include "roll_settle.h"
+#include "dice_model.h"
+#include "detect_jobs.h"
+#include "event_hub.h"
+#include "detection_wire.h"
+#include "detection_history.h"
+#include "detection_state.h"
+#include "burst_capture.h"
+#include "detect_pipeline.h"
+#include "camera_sensor.h"
+#include "camera_mode.h"
+#include "shared/json_writer.h"
+#include "web_ui.h"
+#include <uri/UriBraces.h>
 
 // Suppress deprecation warning for DynamicJsonDocument - we need fixed-size allocation
 #pragma GCC diagnostic push
@@ -36,8 +53,16 @@
 
 static constexpr bool kOverlayEnabled = true;
 
-// 0 = QVGA 320x240, 1 = VGA 640x480 (runtime switchable via UI)
-static int frameSizeMode = 0;
+// Selected frame size, an index into camera_mode's table (1 = QVGA 320x240).
+// The largest selectable one is chosen at boot from the PSRAM budget.
+static int frameSizeMode = 1;
+static constexpr int kLegacyFrameModes[2] = {1, 3};  // frame_size_mode 0/1: QVGA, VGA
+static constexpr int kCameraFrameBuffers = 2;
+// PSRAM left for everything sized after the camera: model arena and input,
+// pip counter scratch, HTTP and TLS buffers.
+static constexpr size_t kPsramReserveBytes = 768 * 1024;
+static constexpr uint32_t kModeSwitchDrainMs = 1500;  // A snapshot holds its frame while it is sent
+static constexpr uint32_t kRateSwitchDrainMs = 50;    // Rate controller retries on its next change
 
 // Simple 5x7 bitmap font for drawing numeric overlays
 static const uint8_t kDigitFont5x7[10][7] = {
@@ -56,8 +81,6 @@ static const uint8_t kDigitFont5x7[10][7] = {
 static WebServer httpServer(80);
 static bool cameraInitialized = false;
 
-static DiceDetection lastDetection = {false, 0, 0, 0, 0, 0, 0.0f, 0};
-static unsigned long lastDetectionTimestamp = 0;
 
 // Wi-Fi state tracking
 static String currentApSsid;
@@ -67,85 +90,137 @@ static IPAddress staIp;
 
 // Dedicated HTTP server for MJPEG stream
 static httpd_handle_t streamHttpd = nullptr;
-static volatile bool streamStopRequested = false;  // Flag to stop active stream
+static JpegCodec* overlayCodec = nullptr;  // Owned by the stream capture task's render hook
 
 // Camera settings (runtime adjustable)
 static int streamDelayMs = 1;  // Latency control
+static int jpegQuality = 12;   // OV2640 scale, 4 (best) .. 63; the stream rate controller moves it while viewers are connected
+static StreamRateConfig streamRateConfig = {true, 15, 10, 40, 0};
+static bool streamRateAllowFrameSize = false;  // Let the controller step the frame size down on a slow link
+static int streamDownshift = 0;  // Frame-size steps the controller currently has applied
+static bool streamOverlay = false;  // Burn the last detection into the stream (costs a decode + re-encode per frame)
+
+// Dice tray region, as fractions of the frame so it survives frame-size changes.
+// w == 0 uploads the whole frame.
+struct TrayRoi {
+  float x;
+  float y;
+  float w;
+  float h;
+};
 
 // External detection server (optional - set via /detection/server endpoint)
-static String externalDetectionServer = "";  // e.g., "http://192.168.1.100:5000/detect"
+// and the tray ROI. Handlers set them on the loop task while the job worker,
+// the pipeline tasks and roll-settle read them, so both live in fixed storage
+// behind detectConfigMux and readers take a copy before each request.
+static constexpr size_t kServerUrlMax = 128;
+static char externalDetectionServer[kServerUrlMax] = "";  // e.g., "http://192.168.1.100:5000/detect"
+static TrayRoi trayRoi = {0.0f, 0.0f, 0.0f, 0.0f};
+static portMUX_TYPE detectConfigMux = portMUX_INITIALIZER_UNLOCKED;
+static const char* kTrayRoiPath = "/tray_roi.txt";
+static constexpr uint32_t kServerTimeoutWithModelMs = 1500;
+static constexpr uint32_t kMaxJobWaitMs = 15000;
+static constexpr uint32_t kWifiWatchMs = 500;
+static const char* kDetectTestServerUrl = "http://192.168.0.102:8003/detect";
+// Tray crop and luma decode for detection; shared by the HTTP loop and the roll-settle task.
+static JpegCodec* detectCodec = nullptr;
+static SemaphoreHandle_t detectCodecLock = nullptr;
 
-static inline int clampCoord(int v, int lo, int hi) {
+static inline int clampi(int v, int lo, int hi) {
   if (v < lo) return lo;
   if (v > hi) return hi;
   return v;
 }
 
-static inline int clampi(int v, int lo, int hi) {
+static inline float clampf(float v, float lo, float hi) {
   if (v < lo) return lo;
   if (v > hi) return hi;
   return v;
 }
 
-static void drawRectRGB(uint8_t* rgb, int w, int h, int x, int y, int bw, int bh, uint8_t rr, uint8_t gg, uint8_t bb) {
-  if (bw <= 0 || bh <= 0) return;
-  int x1 = clampCoord(x, 0, w - 1);
-  int y1 = clampCoord(y, 0, h - 1);
-  int x2 = clampCoord(x + bw - 1, 0, w - 1);
-  int y2 = clampCoord(y + bh - 1, 0, h - 1);
-  for (int i = x1; i <= x2; ++i) {
-    size_t topIdx = ((size_t)y1 * w + i) * 3;
-    size_t bottomIdx = ((size_t)y2 * w + i) * 3;
-    rgb[topIdx] = rr; rgb[topIdx + 1] = gg; rgb[topIdx + 2] = bb;
-    rgb[bottomIdx] = rr; rgb[bottomIdx + 1] = gg; rgb[bottomIdx + 2] = bb;
-  }
-  for (int j = y1; j <= y2; ++j) {
-    size_t leftIdx = ((size_t)j * w + x1) * 3;
-    size_t rightIdx = ((size_t)j * w + x2) * 3;
-    rgb[leftIdx] = rr; rgb[leftIdx + 1] = gg; rgb[leftIdx + 2] = bb;
-    rgb[rightIdx] = rr; rgb[rightIdx + 1] = gg; rgb[rightIdx + 2] = bb;
-  }
-}
-
-static void drawDigitScaled(uint8_t* rgb, int w, int h, int x, int y, int digit, uint8_t rr, uint8_t gg, uint8_t bb, int scale) {
-  if (digit < 0 || digit > 9 || scale <= 0) return;
-  for (int row = 0; row < 7; ++row) {
-    uint8_t bits = kDigitFont5x7[digit][row];
-    for (int col = 0; col < 5; ++col) {
-      if (bits & (1 << (4 - col))) {
-        for (int sy = 0; sy < scale; ++sy) {
-          for (int sx = 0; sx < scale; ++sx) {
-            int px = x + col * scale + sx;
-            int py = y + row * scale + sy;
-            if ((unsigned)px < (unsigned)w && (unsigned)py < (unsigned)h) {
-              size_t idx = ((size_t)py * w + px) * 3;
-              rgb[idx] = rr; rgb[idx + 1] = gg; rgb[idx + 2] = bb;
-            }
-          }
-        }
+struct LumaOverlay {
+  int boxX, boxY, boxW, boxH;  // boxW <= 0: no box
+  int labelX, labelY, scale;
+  char text[16];
+  int textLen;
+};
+
+static constexpr int kOverlayLine = 2;  // 1px lines do not survive requantization
+
+static void buildLumaOverlay(const DiceDetection& det, LumaOverlay& o) {
+  o.boxX = det.x;
+  o.boxY = det.y;
+  o.boxW = det.w;
+  o.boxH = det.h;
+  o.labelX = 8;
+  o.labelY = 8;
+  o.scale = 3;
+  if (det.value == -1) {
+    snprintf(o.text, sizeof(o.text), "d20-");
+  } else {
+    snprintf(o.text, sizeof(o.text), "%d", det.value);
+  }
+  o.textLen = (int)strlen(o.text);
+}
+
+// 5x7 digits advanced by 6 * scale.
+static bool labelPixelOn(const LumaOverlay& o, int x, int y) {
+  int dx = x - o.labelX;
+  int dy = y - o.labelY;
+  if (dx < 0 || dy < 0 || dy >= 7 * o.scale) return false;
+  int advance = 6 * o.scale;
+  int idx = dx / advance;
+  int col = (dx % advance) / o.scale;
+  if (idx >= o.textLen || col >= 5) return false;
+  int d = o.text[idx] - '0';
+  if (d < 0 || d > 9) return false;
+  return (kDigitFont5x7[d][dy / o.scale] & (1 << (4 - col))) != 0;
+}
+
+static bool boxPixelOn(const LumaOverlay& o, int x, int y) {
+  if (o.boxW <= 0 || o.boxH <= 0) return false;
+  if (x < o.boxX || y < o.boxY || x >= o.boxX + o.boxW || y >= o.boxY + o.boxH) return false;
+  return x < o.boxX + kOverlayLine || y < o.boxY + kOverlayLine ||
+         x >= o.boxX + o.boxW - kOverlayLine || y >= o.boxY + o.boxH - kOverlayLine;
+}
+
+// JpegLumaPainter for jpegPaintLuma.
+static void paintOverlayTile(void* ctx, int x0, int y0, uint8_t tile[64]) {
+  const LumaOverlay& o = *(const LumaOverlay*)ctx;
+  for (int i = 0; i < 64; ++i) {
+    int x = x0 + (i & 7);
+    int y = y0 + (i >> 3);
+    if (boxPixelOn(o, x, y) || labelPixelOn(o, x, y)) tile[i] = 255;
+  }
+}
+
+// Paints the overlay straight into a full 8-bit luma frame.
+static void paintOverlayGray(const LumaOverlay& o, const JpegRect* rects, int rectCount, uint8_t* gray, int w, int h) {
+  for (int r = 0; r < rectCount; ++r) {
+    int x1 = clampi(rects[r].x, 0, w);
+    int y1 = clampi(rects[r].y, 0, h);
+    int x2 = clampi(rects[r].x + rects[r].w, 0, w);
+    int y2 = clampi(rects[r].y + rects[r].h, 0, h);
+    for (int y = y1; y < y2; ++y) {
+      for (int x = x1; x < x2; ++x) {
+        if (boxPixelOn(o, x, y) || labelPixelOn(o, x, y)) gray[(size_t)y * w + x] = 255;
       }
     }
   }
 }
 
-static void drawValueLabel(uint8_t* rgb, int w, int h, int x, int y, int value, uint8_t rr, uint8_t gg, uint8_t bb, int scale) {
-  char buf[16];
-  if (value == -1) {
-    // Special case: draw "d20-" prefix
-    snprintf(buf, sizeof(buf), "d20-");
-  } else {
-    snprintf(buf, sizeof(buf), "%d", value);
-  }
-  int len = (int)strlen(buf);
-  int digitWidth = 5 * scale;
-  int spacing = scale;
-  int cursorX = x;
-  for (int i = 0; i < len; ++i) {
-    int d = buf[i] - '0';
-    drawDigitScaled(rgb, w, h, cursorX, y, d, rr, gg, bb, scale);
-    cursorX += digitWidth + spacing;
-    if (cursorX >= w) break;
+// Areas the overlay can touch: the four box edges and the label. Only blocks
+// intersecting these are re-encoded; the box interior passes through.
+static int lumaOverlayRects(const LumaOverlay& o, JpegRect* rects) {
+  int n = 0;
+  rects[n++] = {o.labelX, o.labelY, o.textLen * 6 * o.scale, 7 * o.scale};
+  if (o.boxW > 0 && o.boxH > 0) {
+    rects[n++] = {o.boxX, o.boxY, o.boxW, kOverlayLine};
+    rects[n++] = {o.boxX, o.boxY + o.boxH - kOverlayLine, o.boxW, kOverlayLine};
+    rects[n++] = {o.boxX, o.boxY, kOverlayLine, o.boxH};
+    rects[n++] = {o.boxX + o.boxW - kOverlayLine, o.boxY, kOverlayLine, o.boxH};
   }
+  return n;
 }
 
 // --- HTTP helpers ---
@@ -155,7 +230,8 @@ static void addNoCacheAndCors() {
   httpServer.sendHeader("Expires", "0");
   httpServer.sendHeader("Access-Control-Allow-Origin", "*");
   httpServer.sendHeader("Access-Control-Allow-Methods", "GET, POST, OPTIONS");
-  httpServer.sendHeader("Access-Control-Allow-Headers", "Content-Type, Accept");
+  httpServer.sendHeader("Access-Control-Allow-Headers", "Content-Type, Accept, If-None-Match");
+  httpServer.sendHeader("Access-Control-Expose-Headers", "ETag");
 }
 
 static void handleOptions() {
@@ -163,6 +239,31 @@ static void handleOptions() {
   httpServer.send(204);
 }
 
+// Sends a JsonWriter body straight from its buffer (no String copy); answers
+// 500 instead if the body did not fit.
+static void sendJson(int code, const JsonWriter& w) {
+  addNoCacheAndCors();
+  if (!w.ok()) {
+    httpServer.send(500, "application/json", "{\"ok\":false,\"error\":\"response too large\"}");
+    return;
+  }
+  httpServer.send_P(code, "application/json", w.c_str(), w.length());
+}
+
+// Dotted quad into `out` (16 bytes) without IPAddress::toString()'s String.
+static const char* formatIp(const IPAddress& ip, char* out) {
+  char* p = out;
+  for (int i = 0; i < 4; ++i) {
+    uint8_t octet = ip[i];
+    if (octet >= 100) *p++ = (char)('0' + octet / 100);
+    if (octet >= 10) *p++ = (char)('0' + (octet / 10) % 10);
+    *p++ = (char)('0' + octet % 10);
+    if (i < 3) *p++ = '.';
+  }
+  *p = '\0';
+  return out;
+}
+
 // --- Provisioning storage ---
 struct WifiCredentials {
   String ssid;
@@ -266,16 +367,20 @@ static bool initCamera() {
   config.xclk_freq_hz = 20000000;
   config.pixel_format = PIXFORMAT_JPEG;
   
-  // Default resolution: QVGA for speed; can be switched to VGA at runtime
+  // The driver sizes its JPEG buffers for the frame size it starts with, so
+  // start with the largest mode the PSRAM budget allows and drop to the
+  // selected one afterwards. Without PSRAM only QVGA fits.
+  int maxMode = 1;
   if (psramFound()) {
-    config.frame_size = FRAMESIZE_QVGA; // 320x240
-    config.jpeg_quality = 12;
-    config.fb_count = 2;
+    size_t psramFree = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    size_t budget = psramFree > kPsramReserveBytes ? psramFree - kPsramReserveBytes : 0;
+    maxMode = cameraModeLargestFitting(budget, kCameraFrameBuffers);
+    config.fb_count = kCameraFrameBuffers;
   } else {
-    config.frame_size = FRAMESIZE_QVGA;
-    config.jpeg_quality = 12;
     config.fb_count = 1;
   }
+  config.frame_size = cameraModeInfo(maxMode).size;
+  config.jpeg_quality = jpegQuality;
 
   // Camera init
   esp_err_t err = esp_camera_init(&config);
@@ -284,412 +389,753 @@ static bool initCamera() {
     return false;
   }
   
-  sensor_t * s = esp_camera_sensor_get();
-  s->set_brightness(s, 2);     // -2 to 2
-  s->set_contrast(s, 1);       // -2 to 2
-  s->set_saturation(s, 1);     // -2 to 2
-  s->set_special_effect(s, 2); // 2 = Grayscale output
-  s->set_whitebal(s, 1);       // 0 = disable , 1 = enable
-  s->set_awb_gain(s, 1);       // 0 = disable , 1 = enable
-  s->set_wb_mode(s, 0);        // 0 to 4 - if awb_gain enabled (0 - Auto, 1 - Sunny, 2 - Cloudy, 3 - Office, 4 - Home)
-  s->set_exposure_ctrl(s, 1);  // 0 = disable , 1 = enable
-  s->set_aec2(s, 0);           // 0 = disable , 1 = enable
-  s->set_ae_level(s, 2);       // -2 to 2
-  s->set_aec_value(s, 600);    // 0 to 1200
-  s->set_gain_ctrl(s, 1);      // 0 = disable , 1 = enable
-  s->set_agc_gain(s, 0);       // 0 to 30
-  s->set_gainceiling(s, (gainceiling_t)2);  // 0 to 6
-  s->set_bpc(s, 0);            // 0 = disable , 1 = enable
-  s->set_wpc(s, 1);            // 0 = disable , 1 = enable
-  s->set_raw_gma(s, 1);        // 0 = disable , 1 = enable
-  s->set_lenc(s, 1);           // 0 = disable , 1 = enable
-  s->set_hmirror(s, 0);        // 0 = disable , 1 = enable
-  s->set_vflip(s, 0);          // 0 = disable , 1 = enable
-  s->set_dcw(s, 1);            // 0 = disable , 1 = enable
-  s->set_colorbar(s, 0);       // 0 = disable , 1 = enable
+  sensor_t* s = esp_camera_sensor_get();
+  if (frameSizeMode > maxMode) frameSizeMode = maxMode;
+  s->set_framesize(s, cameraModeInfo(frameSizeMode).size);
+  cameraModeBegin(maxMode, frameSizeMode, streamHubFlush);
+  Serial.printf("Frame sizes up to %s (%u KB PSRAM budget)\n", cameraModeInfo(maxMode).name,
+                (unsigned)(cameraModeBudgetBytes(maxMode, kCameraFrameBuffers) / 1024));
+
+  // Saved image settings (or the defaults) replace the driver's power-on values.
+  cameraSensorLoad();
+  cameraSensorApplyAll(s);
 
   Serial.println("Camera initialized successfully");
   return true;
 }
 
 // --- HTTP handlers ---
+// The page lives in web/index.html and is embedded gzipped by
+// scripts/embed_web_ui.py. It is written from flash in segment-sized pieces
+// (no heap copy) and revalidated by ETag, so a reload costs a 304. Every
+// browser that can run the page accepts gzip, so there is no identity copy.
 static void handleRoot() {
-  addNoCacheAndCors();
-  const char* html =
-    "<html><head><meta name='viewport' content='width=device-width, initial-scale=1'/>"
-    "<style>body{font-family:sans-serif;padding:16px;max-width:640px;margin:auto}"
-    "input,button{font-size:16px;padding:8px;margin:6px 0;width:100%}"
-    "#mjpeg{display:block;width:320px;height:240px;max-width:100%;object-fit:contain;background:#000;margin:8px 0}</style>"
-    "</head><body>"
-    "<h3>DiceTower ESP32-CAM</h3>"
-    "<div id='msg' style='white-space:pre-wrap;font-family:monospace;background:#111;color:#0f0;padding:8px;min-height:2em'></div>"
-    "<h4>Camera Stream</h4>"
-    "<div style='display:flex;gap:8px;align-items:flex-start'>"
-      "<div>"
-        "<img id='mjpeg' alt='Stream will appear here'/>"
-        "<div style='display:flex;gap:8px;margin-top:8px'>"
-          "<button onclick=startStream() title='GET /camera/stream - Starts MJPEG video stream'>Start Stream</button>"
-          "<button onclick=stopStream() title='Stops the video stream'>Stop Stream</button>"
-        "</div>"
-      "</div>"
-      "<div style='display:flex;flex-direction:column;gap:8px'>"
-        "<button id='mostLikelyBtn' style='min-width:80px;padding:12px;font-size:18px;font-weight:bold;background:#4CAF50;color:#fff' disabled>--</button>"
-        "<button id='secondLikelyBtn' style='min-width:80px;padding:12px;font-size:18px;font-weight:bold;background:#FF9800;color:#fff' disabled>--</button>"
-      "</div>"
-    "</div>"
-    "<h4>Dice Recognition</h4>"
-    "<div style='display:flex;flex-wrap:wrap;gap:8px'>"
-      "<button onclick='doGetAndUpdate(\"/dice/capture\")' title='GET /dice/capture - Captures a frame and runs local/ML detection'>Capture & Recognize Dice</button>"
-      "<button onclick='doGetAndUpdate(\"/dice/capture_test\")' title='Send to test server (multipart form-data)'>Test Server</button>"
-      "<button onclick='doGetAndUpdate(\"/dice/capture_gpt\")' title='GET /dice/capture_gpt - Captures a frame and asks ChatGPT to guess the value'>ChatGPT Guess</button>"
-      "<button onclick=doGet('/dice/status') title='GET /dice/status - Returns last detection result'>Get Last Result</button>"
-    "</div>"
-    "<div id='detectionInfo' style='margin-top:10px;font-family:monospace;color:#0cf;'>Waiting for detections...</div>"
-    "<button id='statusToggle' onclick=toggleStatusPolling() style='margin-top:8px'>Start Status Updates</button>"
-    "<h4>External Detection Server</h4>"
-    "<p style='line-height:1.4'>1) Run <code>dice_detection_server.py</code> on your PC.<br>"
-    "2) Enter the full URL (e.g. <code>http://192.168.0.102:5000/detect</code>) below.<br>"
-    "3) Click Save, then use Capture, Test Server, or ChatGPT to send frames through the server.</p>"
-    "<input id='serverUrl' placeholder='http://192.168.0.102:5000/detect' style='width:100%;padding:8px;margin-bottom:6px'/>"
-    "<div style='display:flex;flex-wrap:wrap;gap:8px;margin-bottom:6px'>"
-      "<button onclick=saveDetectionServer()>Save Server URL</button>"
-      "<button onclick=clearDetectionServer() style='background:#555;color:#fff'>Disable External Detection</button>"
-      "<button onclick=loadDetectionServer()>Refresh Status</button>"
-    "</div>"
-    "<div id='serverStatus' style='font-family:monospace;background:#111;color:#0ff;padding:8px;border-radius:4px'>Detection server not configured.</div>"
-    "<h4>Camera Settings</h4>"
-    "<div style='margin-bottom:8px'><label>Brightness (overall lightness): <span id='brightnessVal'>2</span></label><br><input type='range' id='brightness' min='-2' max='2' step='1' value='2' oninput='updateBrightness(this.value)'/><small>Negative = darker, positive = brighter (5 steps)</small></div>"
-    "<div style='margin-bottom:8px'><label>Contrast (difference between dark/light): <span id='contrastVal'>1</span></label><br><input type='range' id='contrast' min='-2' max='2' step='1' value='1' oninput='updateContrast(this.value)'/><small>Lower values flatten the image, higher values increase punch</small></div>"
-    "<div style='margin-bottom:8px'><label>Saturation (color intensity): <span id='saturationVal'>1</span></label><br><input type='range' id='saturation' min='-2' max='2' step='1' value='1' oninput='updateSaturation(this.value)'/><small>-2 = grayscale, +2 = vivid colors</small></div>"
-    "<div style='margin-bottom:8px'><label>Exposure Level (auto bias): <span id='aeLevelVal'>2</span></label><br><input type='range' id='aeLevel' min='-2' max='2' step='1' value='2' oninput='updateAeLevel(this.value)'/><small>Tells auto exposure to favor darker (-) or brighter (+) scenes</small></div>"
-    "<div style='margin-bottom:8px'><label>Exposure Value (manual shutter): <span id='aecValueVal'>600</span></label><br><input type='range' id='aecValue' min='0' max='1200' step='1' value='600' oninput='previewAecValue(this.value)' onchange='commitAecValue(this.value)'/><small>0 = darkest, 1200 = brightest (use when auto exposure struggles)</small></div>"
-    "<div style='margin-bottom:8px'><label>Stream Latency (ms): <span id='delayVal'>1</span></label><br><input type='range' id='delay' min='0' max='100' step='1' value='1' oninput='updateDelay(this.value)'/><small>Increase if Wi-Fi is noisy; 0 = lowest latency</small></div>"
-    "<div style='margin-bottom:8px'><label>Resolution: <span id='resLabel'>320x240</span></label><br>"
-      "<div style='display:flex;gap:8px;margin-top:4px'>"
-        "<button onclick='setResolution(0)' title='Use 320x240 (faster, less detail)'>320x240</button>"
-        "<button onclick='setResolution(1)' title='Use 640x480 (slower, more detail)'>640x480</button>"
-      "</div>"
-      "<small>Higher resolution gives sharper input for the model but uses more memory and bandwidth.</small>"
-    "</div>"
-    "<button onclick=loadCameraSettings()>Load Current Settings</button>"
-    "<h4>Provision Wi‑Fi</h4>"
-    "<input id='ssid' placeholder='SSID'/>"
-    "<input id='pass' type='password' placeholder='Password (optional)'/>"
-    "<button onclick=provision() title='GET /provision?ssid=...&pass=... - Saves Wi-Fi credentials and connects'>Save & Connect</button>"
-    "<div id='wifiStatus' style='white-space:pre-line;font-family:monospace;border:1px solid #ccc;padding:8px;margin-top:8px;background:#f4f8ff;color:#123'>Loading Wi-Fi status...</div>"
-    "<h4>API Endpoints</h4>"
-    "<div style='background:#fff;border:1px solid #ccc;padding:12px;border-radius:4px;font-family:monospace;font-size:12px;line-height:1.6;color:#222'>"
-    "<strong>GET /</strong> - This page<br>"
-    "<strong>GET /status</strong> - Camera and dice detection status (JSON)<br>"
-    "<strong>GET /camera/stream</strong> - MJPEG video stream<br>"
-    "<strong>GET /dice/capture</strong> - Capture frame and detect dice (JSON)<br>"
-    "<strong>GET /dice/capture_test</strong> - Capture frame and send to test server (multipart)<br>"
-    "<strong>GET /dice/status</strong> - Last detection result (JSON)<br>"
-    "<strong>POST /external/detection</strong> - Accept external detection (JSON body)<br>"
-    "<strong>GET /provision?ssid=...&pass=...</strong> - Save Wi-Fi credentials<br>"
-    "<strong>GET /name?action=get</strong> - Get device name<br>"
-    "<strong>GET /name?action=set&name=...</strong> - Set device name<br>"
-    "<strong>GET /camera/settings</strong> - Get camera settings (JSON)<br>"
-    "<strong>POST /camera/settings</strong> - Update camera settings (JSON body)<br>"
-    "<strong>GET /wipe</strong> - Wipe credentials and reboot<br>"
-    "</div>"
-    "<h4>Danger Zone</h4>"
-    "<button onclick=doGet('/wipe') style='background:#b00;color:#fff' title='GET /wipe - Wipes saved Wi-Fi credentials and reboots'>Wipe Credentials & Reboot</button>"
-    "<script>"
-    "function show(o){document.getElementById('msg').textContent=(typeof o==='string')?o:JSON.stringify(o,null,2);}"
-    "async function doGet(path){try{const r=await fetch(path,{cache:'no-store'});const t=await r.text();show(t);}catch(e){show('ERR '+e);}}"
-    "async function doGetAndUpdate(path){try{const r=await fetch(path,{cache:'no-store'});const t=await r.text();show(t);try{const data=JSON.parse(t);if(data.ok!==undefined && data.detected!==undefined){updateDetectionButtons({detected:!!data.detected,value:parseInt(data.value)||0,confidence:parseFloat(data.confidence)||0,second_most_likely:parseInt(data.second_most_likely)||0});}else{updateDetectionButtons(data);}try{const st=await fetch('/dice/status?ts='+Date.now(),{cache:'no-store'});const stText=await st.text();const stData=JSON.parse(stText);updateDetectionButtons(stData);}catch(err2){/* best effort */}}catch(e){console.error('Parse error:',e,t.substring(0,100));}}catch(e){show('ERR '+e);}}"
-    "function updateDetectionButtons(data){const mostBtn=document.getElementById('mostLikelyBtn');const secondBtn=document.getElementById('secondLikelyBtn');const info=document.getElementById('detectionInfo');if(!mostBtn || !secondBtn){console.error('Buttons not found');return;}if(data && data.detected && data.value>0){mostBtn.textContent=data.value;mostBtn.disabled=false;if(data.second_most_likely && data.second_most_likely>0){secondBtn.textContent=data.second_most_likely;secondBtn.disabled=false;}else{secondBtn.textContent='--';secondBtn.disabled=true;}if(info){const conf=(data.confidence||0).toFixed(2);info.textContent=`Die=${data.value}  conf=${conf}`;}}else if(data && data.dice && data.dice.detected && data.dice.value>0){mostBtn.textContent=data.dice.value;mostBtn.disabled=false;if(data.dice.second_most_likely && data.dice.second_most_likely>0){secondBtn.textContent=data.dice.second_most_likely;secondBtn.disabled=false;}else{secondBtn.textContent='--';secondBtn.disabled=true;}if(info){const conf=(data.dice.confidence||0).toFixed(2);info.textContent=`Die=${data.dice.value}  conf=${conf}`;}}else{mostBtn.textContent='--';mostBtn.disabled=true;secondBtn.textContent='--';secondBtn.disabled=true;}}"
-    "async function provision(){const ssid=document.getElementById('ssid').value;const pass=document.getElementById('pass').value;"
-    "if(!ssid){show('Missing SSID');return;}"
-    "const url='/provision?ssid='+encodeURIComponent(ssid)+'&pass='+encodeURIComponent(pass);"
-    "try{const r=await fetch(url,{cache:'no-store'});const t=await r.text();show(t);}catch(e){show('ERR '+e);}}"
-    "const streamHostPort=window.location.hostname+':81';"
-    "const streamUrl=window.location.protocol+'//'+streamHostPort+'/camera/stream';"
-    "let statusPolling=false;"
-    "let statusTimer=null;"
-    "function updateStatusToggleText(){const btn=document.getElementById('statusToggle');if(btn){btn.textContent=statusPolling?'Stop Status Updates':'Start Status Updates';}}"
-    "function setStatusPolling(enabled){statusPolling=!!enabled;updateStatusToggleText();if(statusPolling){if(!statusTimer){pollStatus();}}else if(statusTimer){clearTimeout(statusTimer);statusTimer=null;}}"
-    "function toggleStatusPolling(){setStatusPolling(!statusPolling);}"
-"function startStream(){const img=document.getElementById('mjpeg');img.src=streamUrl+'?t='+Date.now();}"
-"function stopStream(){const img=document.getElementById('mjpeg');img.removeAttribute('src');img.src='';setStatusPolling(false);}"
-    "async function loadDetectionServer(){try{const res=await fetch('/detection/server',{cache:'no-store'});if(!res.ok)throw new Error('HTTP '+res.status);const data=await res.json();const input=document.getElementById('serverUrl');if(input && data.server_url){input.value=data.server_url;}const box=document.getElementById('serverStatus');if(box){box.textContent=(data.enabled&&data.server_url)?'Using '+data.server_url:'Detection server disabled.';}}catch(err){const box=document.getElementById('serverStatus');if(box){box.textContent='Unable to load detection server info.';}show('ERR loading server: '+err);}}"
-    "async function saveDetectionServer(){const input=document.getElementById('serverUrl');const url=input?input.value.trim():'';if(!url){show('Enter server URL first');return;}try{const res=await fetch('/detection/server',{method:'POST',headers:{'Content-Type':'application/json'},body:JSON.stringify({server_url:url}),cache:'no-store'});if(!res.ok){throw new Error('HTTP '+res.status);}show('Detection server saved');loadDetectionServer();}catch(err){show('ERR saving detection server: '+err);}}"
-    "async function clearDetectionServer(){try{const res=await fetch('/detection/server',{method:'POST',headers:{'Content-Type':'application/json'},body:JSON.stringify({enabled:false}),cache:'no-store'});if(!res.ok){throw new Error('HTTP '+res.status);}show('Detection server disabled');const input=document.getElementById('serverUrl');if(input){input.value='';}loadDetectionServer();}catch(err){show('ERR disabling detection server: '+err);}}"
-    "async function pollStatus(){"
-    "  if(!statusPolling){statusTimer=null;return;}"
-    "  try{"
-    "    const res=await fetch('/status',{cache:'no-store'});"
-    "    const data=await res.json();"
-    "    const info=document.getElementById('detectionInfo');"
-    "    const mostBtn=document.getElementById('mostLikelyBtn');"
-    "    const secondBtn=document.getElementById('secondLikelyBtn');"
-    "    updateDetectionButtons(data);"
-    "    const wifiBox=document.getElementById('wifiStatus');"
-    "    if(wifiBox && data && data.wifi){"
-    "      const ap=data.wifi.ap||{};"
-    "      const sta=data.wifi.sta||{};"
-    "      const apLine=`AP: ${ap.ssid||'n/a'} (${ap.ip||'-'})`;"
-    "      const staLine=sta.connected?`STA: connected (${sta.ip||'-'})`:'STA: not connected';"
-    "      wifiBox.textContent=apLine+'\\n'+staLine;"
-    "    }"
-    "  }catch(e){"
-    "    document.getElementById('detectionInfo').textContent='Waiting for device...';"
-    "  }finally{"
-    "    if(statusPolling){statusTimer=setTimeout(pollStatus,2000);}else{statusTimer=null;}"
-    "  }"
-    "}"
-    "let camSettings={brightness:2,contrast:1,saturation:1,ae_level:2,aec_value:600,stream_delay_ms:1};"
-    "async function loadCameraSettings(){try{const r=await fetch('/camera/settings',{cache:'no-store'});const d=await r.json();if(d.ok){camSettings=d;document.getElementById('brightness').value=d.brightness||2;document.getElementById('brightnessVal').textContent=d.brightness||2;document.getElementById('contrast').value=d.contrast||1;document.getElementById('contrastVal').textContent=d.contrast||1;document.getElementById('saturation').value=d.saturation||1;document.getElementById('saturationVal').textContent=d.saturation||1;document.getElementById('aeLevel').value=d.ae_level||2;document.getElementById('aeLevelVal').textContent=d.ae_level||2;document.getElementById('aecValue').value=d.aec_value||600;document.getElementById('aecValueVal').textContent=d.aec_value||600;document.getElementById('delay').value=d.stream_delay_ms||1;document.getElementById('delayVal').textContent=d.stream_delay_ms||1;const mode=(typeof d.frame_size_mode==='number')?d.frame_size_mode:0;document.getElementById('resLabel').textContent=mode? '640x480':'320x240';show('Settings loaded');}}catch(e){show('ERR loading settings: '+e);}}"
-    "async function updateCameraSetting(key,val){camSettings[key]=parseInt(val);try{const r=await fetch('/camera/settings',{method:'POST',headers:{'Content-Type':'application/json'},body:JSON.stringify(camSettings),cache:'no-store'});if(r.ok){show(key+' updated');}else{show('Failed to update '+key);}}catch(e){show('ERR updating '+key+': '+e);}}"
-    "function updateBrightness(v){document.getElementById('brightnessVal').textContent=v;updateCameraSetting('brightness',v);}"
-    "function updateContrast(v){document.getElementById('contrastVal').textContent=v;updateCameraSetting('contrast',v);}"
-    "function updateSaturation(v){document.getElementById('saturationVal').textContent=v;updateCameraSetting('saturation',v);}"
-"function updateAeLevel(v){document.getElementById('aeLevelVal').textContent=v;updateCameraSetting('ae_level',v);}"
-"function previewAecValue(v){document.getElementById('aecValueVal').textContent=v;}"
-"function commitAecValue(v){previewAecValue(v);updateCameraSetting('aec_value',v);}"
-    "function updateDelay(v){document.getElementById('delayVal').textContent=v;updateCameraSetting('stream_delay_ms',v);}"
-    "function setResolution(mode){mode=parseInt(mode);camSettings.frame_size_mode=mode;document.getElementById('resLabel').textContent=mode? '640x480':'320x240';updateCameraSetting('frame_size_mode',mode);}"
-    "document.addEventListener('DOMContentLoaded',()=>{loadDetectionServer();});"
-    "</script>"
-    "</body></html>";
-  httpServer.send(200, "text/html", html);
+  String inm = httpServer.header("If-None-Match");
+  httpServer.sendHeader("ETag", kWebUiEtag);
+  httpServer.sendHeader("Cache-Control", "no-cache");
+  if (inm.length() && (inm == "*" || strstr(inm.c_str(), kWebUiEtag))) {
+    httpServer.send(304);
+    return;
+  }
+  httpServer.sendHeader("Content-Encoding", "gzip");
+  httpServer.sendHeader("Vary", "Accept-Encoding");
+  httpServer.setContentLength(kWebUiGzLen);
+  httpServer.send(200, "text/html", "");
+  const size_t kChunk = 1436;  // One TCP segment on the default lwIP MSS
+  for (size_t off = 0; off < kWebUiGzLen; off += kChunk) {
+    size_t n = kWebUiGzLen - off < kChunk ? kWebUiGzLen - off : kChunk;
+    httpServer.sendContent_P((PGM_P)kWebUiGz + off, n);
+  }
 }
 
 static void handleStatus() {
-  // Use DynamicJsonDocument with fixed size to avoid heap fragmentation on ESP32
-  DynamicJsonDocument doc(512);
-  doc["camera"] = cameraInitialized;
-  JsonObject dice = doc["dice"].to<JsonObject>();
-  dice["detected"] = lastDetection.detected;
-  dice["value"] = lastDetection.value;
-  dice["timestamp"] = lastDetectionTimestamp;
-  dice["confidence"] = lastDetection.confidence;
-  dice["second_most_likely"] = lastDetection.second_most_likely;
-
-  JsonObject wifi = doc["wifi"].to<JsonObject>();
-  JsonObject ap = wifi["ap"].to<JsonObject>();
-  ap["ssid"] = currentApSsid;
-  ap["ip"] = currentApIp.toString();
-  JsonObject sta = wifi["sta"].to<JsonObject>();
-  sta["connected"] = staConnected;
-  sta["ip"] = staConnected ? staIp.toString() : "";
-
-  String json;
-  serializeJson(doc, json);
-  addNoCacheAndCors();
-  httpServer.send(200, "application/json", json);
+  char buf[2048];
+  char apIp[16];
+  char staIpText[16];
+
+  DetectionSnapshot last;
+  uint32_t version = detectionStateRead(last);
+
+  JsonWriter w(buf, sizeof(buf));
+  w.beginObject();
+  w.add("camera", cameraInitialized);
+  w.beginObject("dice")
+    .add("version", version)
+    .add("seq", last.seq)
+    .add("detected", last.detection.detected)
+    .add("value", last.detection.value)
+    .add("timestamp", last.timestampMs)
+    .add("confidence", last.detection.confidence)
+    .add("second_most_likely", last.detection.second_most_likely)
+    .endObject();
+
+  w.beginObject("wifi");
+  w.beginObject("ap").add("ssid", currentApSsid.c_str()).add("ip", formatIp(currentApIp, apIp)).endObject();
+  w.beginObject("sta").add("connected", staConnected).add("ip", staConnected ? formatIp(staIp, staIpText) : "").endObject();
+  w.endObject();
+
+  FramePoolStats pool;
+  framePoolGetStats(pool);
+  w.beginObject("memory")
+    .add("heap_free", ESP.getFreeHeap())
+    .add("heap_largest_block", heap_caps_get_largest_free_block(MALLOC_CAP_8BIT))
+    .add("pool_gray_in_use", pool.inUse[FRAME_POOL_GRAY])
+    .add("pool_jpeg_in_use", pool.inUse[FRAME_POOL_JPEG])
+    .add("pool_slots", pool.slots[FRAME_POOL_GRAY] + pool.slots[FRAME_POOL_JPEG])
+    .add("pool_leases", pool.leases)
+    .add("pool_failures", pool.failures)
+    .endObject();
+
+  StreamHubStats hub;
+  streamHubGetStats(hub);
+  w.beginObject("stream")
+    .add("viewers", hub.subscribers)
+    .add("captured", hub.captured)
+    .add("published", hub.published)
+    .add("dropped", hub.droppedNoSlot)
+    .endObject();
+
+  DiceModelStats model;
+  diceModelGetStats(model);
+  w.beginObject("model")
+    .add("available", diceModelAvailable())
+    .add("runs", model.runs)
+    .add("busy", model.busy)
+    .add("timeouts", model.timeouts)
+    .add("prep_us", model.lastPrepUs)
+    .add("dsp_us", model.lastDspUs)
+    .add("infer_us", model.lastInferUs)
+    .endObject();
+
+  DetectServerStats server;
+  detectServerGetStats(server);
+  w.beginObject("detect_server")
+    .add("requests", server.requests)
+    .add("reused", server.reused)
+    .add("reuse_ratio", server.requests ? (float)server.reused / server.requests : 0.0f)
+    .add("reconnects", server.reconnects)
+    .add("failures", server.failures)
+    .add("last_ms", server.lastMs)
+    .endObject();
+
+  // Per-stage work and backpressure (time stalled on a full downstream queue).
+  PipelineStats pipeline;
+  pipelineGetStats(pipeline);
+  w.beginObject("pipeline")
+    .add("capture_failures", pipeline.captureFailures)
+    .add("skipped", pipeline.skipped);
+  for (int i = 0; i < PIPELINE_STAGE_COUNT; ++i) {
+    const PipelineStageStats& st = pipeline.stages[i];
+    w.beginObject(pipelineStageName((PipelineStage)i))
+      .add("items", st.items)
+      .add("last_us", st.lastUs)
+      .add("max_us", st.maxUs)
+      .add("avg_us", st.items ? (uint32_t)(st.busyUs / st.items) : 0u)
+      .add("blocked_ms", (uint32_t)(st.blockedUs / 1000))
+      .endObject();
+  }
+  w.endObject();
+  w.endObject();
+
+  sendJson(200, w);
 }
 
 // --- MJPEG stream (/camera/stream) ---
-static const char* kStreamBoundary = "--frame";
+// Overlay is only worth a decode/re-encode when there is something to draw.
+static bool streamOverlayActive(const DiceDetection& det) {
+  return kOverlayEnabled && streamOverlay && det.detected && det.value != 0;
+}
 
-static esp_err_t streamHttpdHandler(httpd_req_t* req) {
-  if (!cameraInitialized) {
-    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Camera not initialized");
-    return ESP_FAIL;
+// fmt2jpg_cb sink that writes into a fixed buffer.
+struct JpegSink {
+  uint8_t* buf;
+  size_t cap;
+  size_t len;
+  bool overflow;
+};
+
+static size_t jpegSinkWrite(void* arg, size_t index, const void* data, size_t len) {
+  JpegSink* sink = (JpegSink*)arg;
+  if (!data || len == 0) return 0;
+  if (sink->overflow || index + len > sink->cap) {
+    sink->overflow = true;
+    return 0;
   }
-  
-  // Reset stop flag when new stream starts
-  streamStopRequested = false;
-  
-  httpd_resp_set_type(req, "multipart/x-mixed-replace; boundary=frame");
-  httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+  memcpy(sink->buf + index, data, len);
+  if (index + len > sink->len) sink->len = index + len;
+  return len;
+}
 
-  while (true) {
-    // Check if stop was requested
-    if (streamStopRequested) {
-      break;
-    }
-    camera_fb_t* fb = esp_camera_fb_get();
-    if (!fb) {
-      return ESP_FAIL;
-    }
+// stream_hub render hook. Only the JPEG blocks under the box edges and the
+// label are decoded and re-encoded; if that does not fit the slot, the luma
+// plane is decoded, painted and re-encoded as a grayscale JPEG (the sensor
+// runs in grayscale anyway). Returning false publishes the sensor JPEG untouched.
+static bool renderOverlayFrame(camera_fb_t* fb, uint8_t* dst, size_t cap, size_t* outLen) {
+  if (!overlayCodec) return false;
+  DetectionSnapshot last;
+  detectionStateRead(last);
+  const DiceDetection& det = last.detection;
+  if (!streamOverlayActive(det)) return false;
+
+  LumaOverlay overlay;
+  buildLumaOverlay(det, overlay);
+  JpegRect rects[5];
+  int rectCount = lumaOverlayRects(overlay, rects);
+  size_t len = jpegPaintLuma(overlayCodec, fb->buf, fb->len, rects, rectCount, paintOverlayTile, &overlay, dst, cap);
+  if (len > 0) {
+    *outLen = len;
+    return true;
+  }
 
-    uint8_t* rgb = nullptr;
-    uint8_t* outJpg = nullptr;
-    size_t outLen = 0;
-    const uint8_t* payload = fb->buf;
-    size_t payloadLen = fb->len;
-
-    size_t rgbBytes = (size_t)fb->width * (size_t)fb->height * 3;
-    rgb = (uint8_t*)malloc(rgbBytes);
-    if (rgb && fmt2rgb888(fb->buf, fb->len, fb->format, rgb)) {
-      // Box drawing removed - using frontend buttons instead
-      if (fmt2jpg(rgb, fb->width * fb->height * 3, fb->width, fb->height, PIXFORMAT_RGB888, 80, &outJpg, &outLen)) {
-        payload = outJpg;
-        payloadLen = outLen;
-      }
-    }
+  size_t grayBytes = (size_t)fb->width * (size_t)fb->height;
+  uint8_t* gray = framePoolAcquire(FRAME_POOL_GRAY, grayBytes);
+  if (!gray) return false;
+  JpegSink sink = {dst, cap, 0, false};
+  int w = 0;
+  int h = 0;
+  bool ok = false;
+  if (jpegDecodeLuma(overlayCodec, fb->buf, fb->len, gray, grayBytes, &w, &h)) {
+    paintOverlayGray(overlay, rects, rectCount, gray, w, h);
+    ok = fmt2jpg_cb(gray, grayBytes, w, h, PIXFORMAT_GRAYSCALE, 80, jpegSinkWrite, &sink) &&
+         !sink.overflow && sink.len > 0;
+  }
+  framePoolRelease(gray);
+  if (ok) *outLen = sink.len;
+  return ok;
+}
 
-    char partHeader[128];
-    int headerLen = snprintf(partHeader, sizeof(partHeader),
-                             "%s\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n",
-                             kStreamBoundary, (unsigned)payloadLen);
-    if (httpd_resp_send_chunk(req, partHeader, headerLen) != ESP_OK ||
-        httpd_resp_send_chunk(req, (const char*)payload, payloadLen) != ESP_OK ||
-        httpd_resp_send_chunk(req, "\r\n", 2) != ESP_OK) {
-      if (rgb) free(rgb);
-      if (outJpg) free(outJpg);
-      esp_camera_fb_return(fb);
-      break;
-    }
+static int streamFrameMode(int downshift) {
+  return clampi(frameSizeMode - downshift, 0, frameSizeMode);
+}
 
-    esp_camera_fb_return(fb);
-    if (rgb) free(rgb);
-    if (outJpg) free(outJpg);
+// Sensor registers are written only from the loop task (camera_sensor, the
+// settings handler, resetStreamRate): an OV2640 setter is a bank select
+// followed by a register write, and two tasks interleaving them write the
+// wrong bank. The rate controller runs on the stream capture task, so its
+// decisions are queued here and applied by loop().
+static portMUX_TYPE streamRateMux = portMUX_INITIALIZER_UNLOCKED;
+static StreamRateState pendingStreamRate;
+static bool streamRatePending = false;
+static bool streamRateRestorePending = false;  // Last viewer left; back to the manual settings
+
+// Rate controller hook (stream capture task).
+static void applyStreamRate(const StreamRateState& rate) {
+  portENTER_CRITICAL(&streamRateMux);
+  pendingStreamRate = rate;
+  streamRatePending = true;
+  portEXIT_CRITICAL(&streamRateMux);
+}
 
-    if (streamDelayMs > 0) {
-      vTaskDelay(streamDelayMs / portTICK_PERIOD_MS);
-    } else {
-      taskYIELD();
-    }
+// Idle hook (stream capture task).
+static void restoreStreamRate() {
+  portENTER_CRITICAL(&streamRateMux);
+  streamRateRestorePending = true;
+  streamRatePending = false;
+  portEXIT_CRITICAL(&streamRateMux);
+}
+
+// Pushes the manual settings to the sensor and restarts the controller from them.
+static void resetStreamRate() {
+  streamRateConfig.maxDownshift = streamRateAllowFrameSize ? frameSizeMode : 0;
+  streamRateConfigure(streamRateConfig);
+  streamRateReset(jpegQuality, streamDelayMs);
+  streamHubSetFrameDelay(streamDelayMs);
+  portENTER_CRITICAL(&streamRateMux);
+  streamRatePending = false;  // Decided against the old settings
+  portEXIT_CRITICAL(&streamRateMux);
+  streamDownshift = 0;
+  sensor_t* s = esp_camera_sensor_get();
+  if (s) s->set_quality(s, jpegQuality);
+  const char* error = nullptr;
+  if (!cameraModeSwitch(frameSizeMode, kModeSwitchDrainMs, &error)) {
+    Serial.printf("Frame size restore failed: %s\n", error);
   }
+}
 
-  httpd_resp_send_chunk(req, nullptr, 0);
-  return ESP_OK;
+// Loop task; holds no frame, so it may switch sizes through camera_mode.
+static void applyPendingStreamRate() {
+  portENTER_CRITICAL(&streamRateMux);
+  bool restore = streamRateRestorePending;
+  streamRateRestorePending = false;
+  portEXIT_CRITICAL(&streamRateMux);
+  if (restore) resetStreamRate();
+
+  portENTER_CRITICAL(&streamRateMux);
+  bool pending = streamRatePending;
+  StreamRateState rate = pendingStreamRate;
+  streamRatePending = false;
+  portEXIT_CRITICAL(&streamRateMux);
+  if (!pending) return;
+
+  sensor_t* s = esp_camera_sensor_get();
+  if (!s) return;
+  s->set_quality(s, rate.quality);
+  const char* error = nullptr;
+  if (rate.downshift != streamDownshift &&
+      cameraModeSwitch(streamFrameMode(rate.downshift), kRateSwitchDrainMs, &error)) {
+    streamDownshift = rate.downshift;
+  }
 }
 
-static void handleDiceCapture() {
+// Frames are produced by the stream_hub capture task; this handler only hands
+// the connection over to a per-viewer sender task and returns.
+static esp_err_t streamHttpdHandler(httpd_req_t* req) {
   if (!cameraInitialized) {
-    addNoCacheAndCors();
-    httpServer.send(500, "application/json", "{\"ok\":false,\"error\":\"camera not initialized\"}");
-    return;
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Camera not initialized");
+    return ESP_FAIL;
   }
-
-  camera_fb_t* fb = esp_camera_fb_get();
-  if (!fb) {
-    addNoCacheAndCors();
-    httpServer.send(500, "application/json", "{\"ok\":false,\"error\":\"camera capture failed\"}");
-    return;
+  if (!streamHubSubscribe(req)) {
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_send(req, "Too many stream viewers", HTTPD_RESP_USE_STRLEN);
   }
+  return ESP_OK;
+}
 
-  DiceDetection detection = {false, 0, 0, 0, 0, 0, 0.0f, 0};
-  if (fb->format == PIXFORMAT_JPEG) {
-    // Try external server first if configured
-    if (externalDetectionServer.length() > 0 && WiFi.status() == WL_CONNECTED) {
-      detectDiceFromJPEG(fb->buf, fb->len, externalDetectionServer, detection);
-    }
+// Server-Sent Events: detections and Wi-Fi changes, pushed by event_hub.
+static esp_err_t eventsHttpdHandler(httpd_req_t* req) {
+  if (!eventHubSubscribe(req)) {
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_send(req, "Too many event listeners", HTTPD_RESP_USE_STRLEN);
   }
+  return ESP_OK;
+}
 
-  esp_camera_fb_return(fb);
-  lastDetection = detection;
-  lastDetectionTimestamp = millis();
+// Every new result goes through here so /dice/history keeps it, the shared
+// detection state (detection_state.h) moves on and /events subscribers see it
+// at once. Called from the job worker, the roll-settle task and the HTTP loop.
+static DetectionSnapshot recordDetection(const DiceDetection& detection, DetectionSource source,
+                                         uint32_t latencyMs = kDetectionLatencyUnknown) {
+  DetectionSnapshot snap;
+  snap.detection = detection;
+  snap.timestampMs = millis();
+  snap.source = source;
+  snap.seq = detectionHistoryAdd(detection, source, latencyMs, snap.timestampMs);
+  // A result that lost the race to a newer one stays in the history only;
+  // pushing it would make /events replay a stale roll.
+  if (!detectionStatePublish(snap)) return snap;
+  char json[224];
+  snprintf(json, sizeof(json),
+           "{\"seq\":%u,\"detected\":%s,\"value\":%d,\"timestamp\":%u,\"confidence\":%.3f,"
+           "\"second_most_likely\":%d,\"x\":%d,\"y\":%d,\"w\":%d,\"h\":%d,\"source\":\"%s\"}",
+           (unsigned)snap.seq, detection.detected ? "true" : "false", detection.value, (unsigned)snap.timestampMs,
+           detection.confidence, detection.second_most_likely, detection.x, detection.y, detection.w, detection.h,
+           detectionSourceName(source));
+  eventHubPublish("detection", json);
+  return snap;
+}
 
-  String json = String("{\"ok\":true,\"detected\":") + (detection.detected?"true":"false") +
-                ",\"value\":" + detection.value +
-                ",\"timestamp\":" + lastDetectionTimestamp +
-                ",\"confidence\":" + String(detection.confidence, 3) +
-                ",\"second_most_likely\":" + detection.second_most_likely +
-                ",\"x\":" + detection.x +
-                ",\"y\":" + detection.y +
-                ",\"w\":" + detection.w +
-                ",\"h\":" + detection.h + "}";
-  
+// Binary detection records (detection_wire.h) for clients that ask for them.
+static bool clientWantsWire() {
+  return detectionWireMatches(httpServer.header("Accept").c_str());
+}
+
+static void sendDetectionWire(const DiceDetection& detection, uint32_t seq, uint32_t timestampMs) {
+  uint8_t wire[kDetectionWireBytes];
+  size_t len = detectionWireEncode(detection, seq, timestampMs, wire, sizeof(wire));
   addNoCacheAndCors();
-  httpServer.send(200, "application/json", json);
+  httpServer.send_P(200, DETECTION_WIRE_MIME, (PGM_P)wire, len);
 }
 
-// Capture frame and send to GPT-backed detector on the external server.
-// Uses the same externalDetectionServer URL but swaps `/detect` for `/gpt_detect`.
-static void handleDiceCaptureGpt() {
-  if (!cameraInitialized) {
-    addNoCacheAndCors();
-    httpServer.send(500, "application/json", "{\"ok\":false,\"error\":\"camera not initialized\"}");
-    return;
+static String detectionServerUrl() {
+  char url[kServerUrlMax];
+  portENTER_CRITICAL(&detectConfigMux);
+  memcpy(url, externalDetectionServer, sizeof(url));
+  portEXIT_CRITICAL(&detectConfigMux);
+  return String(url);
+}
+
+// False (URL unchanged) when it does not fit.
+static bool setDetectionServerUrl(const char* url) {
+  if (strlen(url) >= kServerUrlMax) return false;
+  portENTER_CRITICAL(&detectConfigMux);
+  strcpy(externalDetectionServer, url);
+  portEXIT_CRITICAL(&detectConfigMux);
+  return true;
+}
+
+static TrayRoi currentTrayRoi() {
+  portENTER_CRITICAL(&detectConfigMux);
+  TrayRoi roi = trayRoi;
+  portEXIT_CRITICAL(&detectConfigMux);
+  return roi;
+}
+
+static void setTrayRoi(const TrayRoi& roi) {
+  portENTER_CRITICAL(&detectConfigMux);
+  trayRoi = roi;
+  portEXIT_CRITICAL(&detectConfigMux);
+}
+
+// Losslessly crops a width x height JPEG to the tray ROI into a pool lease.
+// Returns nullptr when no ROI is set or the crop is not possible; the caller
+// then uploads the full frame.
+static uint8_t* cropToTray(const uint8_t* jpeg, size_t jpegLen, int width, int height, size_t* outLen,
+                           JpegRect* kept) {
+  TrayRoi tray = currentTrayRoi();
+  if (tray.w <= 0.0f || tray.h <= 0.0f || !detectCodec || !detectCodecLock) return nullptr;
+  uint8_t* buf = framePoolAcquire(FRAME_POOL_JPEG, jpegLen);
+  if (!buf) return nullptr;
+  JpegRect roi = {
+    (int)(tray.x * width), (int)(tray.y * height),
+    (int)(tray.w * width + 0.5f), (int)(tray.h * height + 0.5f)
+  };
+  xSemaphoreTake(detectCodecLock, portMAX_DELAY);
+  size_t len = jpegCrop(detectCodec, jpeg, jpegLen, roi, buf, framePoolSlotBytes(FRAME_POOL_JPEG), kept);
+  xSemaphoreGive(detectCodecLock);
+  if (!len) {
+    framePoolRelease(buf);
+    return nullptr;
   }
+  *outLen = len;
+  return buf;
+}
 
-  if (externalDetectionServer.length() == 0 || WiFi.status() != WL_CONNECTED) {
-    addNoCacheAndCors();
-    httpServer.send(500, "application/json", "{\"ok\":false,\"error\":\"detection server not configured or STA not connected\"}");
-    return;
+// Decodes the luma plane of a JPEG into a pool lease (1 byte per pixel) and
+// runs on-device detection (pip counter, model) on it.
+static bool detectOnDevice(const uint8_t* jpeg, size_t len, int width, int height, DiceDetection& out) {
+  if (!detectCodec || !detectCodecLock) return false;
+  size_t grayBytes = (size_t)width * (size_t)height;
+  uint8_t* gray = framePoolAcquire(FRAME_POOL_GRAY, grayBytes);
+  if (!gray) return false;
+  xSemaphoreTake(detectCodecLock, portMAX_DELAY);
+  bool decoded = jpegDecodeLuma(detectCodec, jpeg, len, gray, grayBytes, &width, &height);
+  xSemaphoreGive(detectCodecLock);
+  bool ok = decoded && detectDiceFromGray(gray, width, height, out);
+  framePoolRelease(gray);
+  return ok;
+}
+
+// Boxes are relative to the image that was analysed; report full-frame
+// pixels. Readers without a box (the server, classifier models) leave 0x0,
+// which stays 0x0 rather than becoming a point at the crop origin.
+static void offsetBox(DiceDetection& detection, const JpegRect& kept) {
+  if (detection.w <= 0 || detection.h <= 0) return;
+  detection.x += kept.x;
+  detection.y += kept.y;
+}
+
+// Reads one tray image. The PC server is asked first; when it is unreachable,
+// slow or finds nothing, the pip counter and the on-device model (if built in)
+// read the same image. `kept` is where the image sits in the full frame.
+// Returns the reader that produced the detection; a miss is reported as the
+// server's when it was asked, as it is the primary reader.
+static DetectionSource detectTrayImage(const uint8_t* jpeg, size_t jpegLen, const JpegRect& kept,
+                                       DiceDetection& detection) {
+  bool askedServer = false;
+  // Try external server first if configured
+  String serverUrl = detectionServerUrl();
+  if (serverUrl.length() > 0 && WiFi.status() == WL_CONNECTED) {
+    askedServer = true;
+    // With a local fallback there is no point waiting out a stalled server.
+    uint32_t timeoutMs = diceModelAvailable() ? kServerTimeoutWithModelMs : 5000;
+    if (detectDiceFromJPEG(jpeg, jpegLen, serverUrl, detection, timeoutMs)) {
+      offsetBox(detection, kept);
+      return DETECTION_SOURCE_SERVER;
+    }
   }
+  // Nothing the server may have half-written survives into the fallback.
+  detection = {false, 0, 0, 0, 0, 0, 0.0f, 0};
+  if (detectOnDevice(jpeg, jpegLen, kept.w, kept.h, detection) && detection.detected) {
+    offsetBox(detection, kept);
+    return DETECTION_SOURCE_LOCAL;
+  }
+  detection = {false, 0, 0, 0, 0, 0, 0.0f, 0};
+  return askedServer ? DETECTION_SOURCE_SERVER : DETECTION_SOURCE_LOCAL;
+}
+
+// detect_pipeline hooks. Prep swaps the full-frame lease for a tray crop
+// when an ROI is set; upload reads whatever prep left.
+static void prepareTrayFrame(PipelineFrame& frame) {
+  size_t cropLen = 0;
+  JpegRect kept = frame.kept;
+  uint8_t* crop = cropToTray(frame.jpeg, frame.len, frame.width, frame.height, &cropLen, &kept);
+  if (!crop) return;
+  framePoolRelease(frame.jpeg);
+  frame.jpeg = crop;
+  frame.len = cropLen;
+  frame.kept = kept;
+}
+
+static DetectionSource detectPipelineFrame(const PipelineFrame& frame, DiceDetection& out) {
+  return detectTrayImage(frame.jpeg, frame.len, frame.kept, out);
+}
+
+// Shared by /dice/capture and the roll-settle watcher; records the result.
+// `first` (may be null) is a leased copy of a frame the caller already
+// captured, taken over by the burst. With bursts on (/dice/burst) it is the
+// first of several frames whose readings are voted on; `burst` receives the
+// vote either way.
+static DiceDetection runDiceDetection(PipelineFrame* first, uint32_t* seq = nullptr, BurstResult* burst = nullptr) {
+  uint32_t startMs = millis();
+  BurstResult result;
+  burstRun(first, result);
+  uint32_t recorded = recordDetection(result.detection, result.source, millis() - startMs).seq;
+  if (seq) *seq = recorded;
+  if (burst) *burst = result;
+  return result.detection;
+}
+
+static void onRollSettled(camera_fb_t* fb) {
+  // The camera gets its buffer back before the burst and its upload run.
+  PipelineFrame settled;
+  pipelineLease(fb, settled);
+  cameraFrameReturn(fb);
+  DiceDetection detection = runDiceDetection(&settled);
+  Serial.printf("Roll settled: detected=%d value=%d conf=%.2f\n",
+                detection.detected ? 1 : 0, detection.value, detection.confidence);
+}
 
-  // Build GPT endpoint URL from configured /detect URL
-  String gptUrl = externalDetectionServer;
+// GPT endpoint next to the configured /detect URL.
+static String gptDetectUrl() {
+  String gptUrl = detectionServerUrl();
   int slash = gptUrl.lastIndexOf('/');
   if (slash > 0) {
     gptUrl = gptUrl.substring(0, slash) + "/gpt_detect";
   } else {
     gptUrl += "/gpt_detect";
   }
+  return gptUrl;
+}
+
+// Worker side of /dice/capture, /dice/capture_gpt and /dice/capture_test (detect_jobs.h).
+static bool runDetectJob(DetectJobKind kind, DetectJob& job, const char** error) {
+  if (!cameraInitialized) {
+    *error = "camera not initialized";
+    return false;
+  }
+  if (kind == DETECT_JOB_GPT && (detectionServerUrl().length() == 0 || WiFi.status() != WL_CONNECTED)) {
+    *error = "detection server not configured or STA not connected";
+    return false;
+  }
+  if (kind == DETECT_JOB_TEST && WiFi.status() != WL_CONNECTED) {
+    *error = "STA not connected";
+    return false;
+  }
+
+  if (kind == DETECT_JOB_CAPTURE) {
+    // The pipeline grabs (and immediately returns) its own frames.
+    BurstResult burst;
+    job.result = runDiceDetection(nullptr, &job.seq, &burst);
+    if (!burst.captured) {
+      *error = "camera capture failed";
+      return false;
+    }
+    job.frames = (uint8_t)burst.captured;
+    job.agreement = burst.agreement;
+    return true;
+  }
 
-  camera_fb_t* fb = esp_camera_fb_get();
+  // The upload can take seconds; work from a pool copy so the camera gets
+  // its buffer back at once.
+  camera_fb_t* fb = cameraFrameGet();
   if (!fb) {
-    addNoCacheAndCors();
-    httpServer.send(500, "application/json", "{\"ok\":false,\"error\":\"camera capture failed\"}");
-    return;
+    *error = "camera capture failed";
+    return false;
+  }
+  PipelineFrame frame;
+  pipelineLease(fb, frame);
+  cameraFrameReturn(fb);
+  if (!frame.jpeg) {
+    *error = "no free frame buffer";
+    return false;
   }
 
+  uint32_t startMs = millis();
   DiceDetection detection = {false, 0, 0, 0, 0, 0, 0.0f, 0};
-  if (fb->format == PIXFORMAT_JPEG) {
-    detectDiceFromJPEG(fb->buf, fb->len, gptUrl, detection);
+  if (kind == DETECT_JOB_GPT) {
+    detectDiceFromJPEG(frame.jpeg, frame.len, gptDetectUrl(), detection);
+  } else {
+    detectDiceToTestServer(frame.jpeg, frame.len, kDetectTestServerUrl, detection);
   }
+  framePoolRelease(frame.jpeg);
+  job.seq = recordDetection(detection, kind == DETECT_JOB_GPT ? DETECTION_SOURCE_GPT : DETECTION_SOURCE_TEST,
+                            millis() - startMs).seq;
+  job.result = detection;
+  return true;
+}
 
-  esp_camera_fb_return(fb);
-  lastDetection = detection;
-  lastDetectionTimestamp = millis();
+// Finished jobs carry the same fields /dice/capture used to return directly.
+static void sendDetectJob(const DetectJob& job) {
+  if (job.state == DETECT_JOB_DONE && clientWantsWire()) {
+    sendDetectionWire(job.result, job.seq, job.finishedMs);
+    return;
+  }
+  char buf[384];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginObject()
+    .add("ok", job.state != DETECT_JOB_FAILED)
+    .add("job", job.id)
+    .add("kind", detectJobKindName(job.kind))
+    .add("state", detectJobStateName(job.state));
+  if (job.state == DETECT_JOB_FAILED) {
+    w.add("error", job.error);
+  } else if (job.state == DETECT_JOB_DONE) {
+    w.add("seq", job.seq)
+      .add("detected", job.result.detected)
+      .add("value", job.result.value)
+      .add("timestamp", job.finishedMs)
+      .add("confidence", job.result.confidence)
+      .add("second_most_likely", job.result.second_most_likely)
+      .add("x", job.result.x)
+      .add("y", job.result.y)
+      .add("w", job.result.w)
+      .add("h", job.result.h)
+      .add("frames", job.frames)
+      .add("queued_ms", job.startedMs - job.submittedMs)
+      .add("run_ms", job.finishedMs - job.startedMs);
+    if (job.frames > 1) w.add("agreement", job.agreement);
+  }
+  w.endObject();
+  sendJson(job.state == DETECT_JOB_QUEUED || job.state == DETECT_JOB_RUNNING ? 202 : 200, w);
+}
 
-  String json = String("{\"ok\":true,\"detected\":") + (detection.detected?"true":"false") +
-                ",\"value\":" + detection.value +
-                ",\"timestamp\":" + lastDetectionTimestamp +
-                ",\"confidence\":" + String(detection.confidence, 3) +
-                ",\"second_most_likely\":" + detection.second_most_likely + "}";
-  
-  addNoCacheAndCors();
-  httpServer.send(200, "application/json", json);
+// ?wait=<ms> holds the request until the job finishes or the deadline passes.
+// It blocks this server loop meanwhile, so pollers should prefer /dice/job/<id>.
+static uint32_t jobWaitArg() {
+  if (!httpServer.hasArg("wait")) return 0;
+  long ms = httpServer.arg("wait").toInt();
+  return (uint32_t)clampi((int)ms, 0, (int)kMaxJobWaitMs);
 }
 
-// Capture frame and send to fixed test server via multipart/form-data.
-static void handleDiceCaptureTest() {
+static void submitDetectJob(DetectJobKind kind) {
   if (!cameraInitialized) {
     addNoCacheAndCors();
     httpServer.send(500, "application/json", "{\"ok\":false,\"error\":\"camera not initialized\"}");
     return;
   }
+  uint32_t id = detectJobSubmit(kind);
+  if (!id) {
+    addNoCacheAndCors();
+    httpServer.send(503, "application/json", "{\"ok\":false,\"error\":\"detection queue full\"}");
+    return;
+  }
+  DetectJob job;
+  uint32_t waitMs = jobWaitArg();
+  if (waitMs) {
+    detectJobWait(id, waitMs, job);
+  } else {
+    detectJobGet(id, job);
+  }
+  sendDetectJob(job);
+}
 
+static void handleDiceCapture() {
+  submitDetectJob(DETECT_JOB_CAPTURE);
+}
+
+// Capture frame and send to GPT-backed detector on the external server.
+// Uses the same detection server URL but swaps `/detect` for `/gpt_detect`.
+static void handleDiceCaptureGpt() {
+  if (detectionServerUrl().length() == 0 || WiFi.status() != WL_CONNECTED) {
+    addNoCacheAndCors();
+    httpServer.send(500, "application/json", "{\"ok\":false,\"error\":\"detection server not configured or STA not connected\"}");
+    return;
+  }
+  submitDetectJob(DETECT_JOB_GPT);
+}
+
+// Capture frame and send to fixed test server via multipart/form-data.
+static void handleDiceCaptureTest() {
   if (WiFi.status() != WL_CONNECTED) {
     addNoCacheAndCors();
     httpServer.send(500, "application/json", "{\"ok\":false,\"error\":\"STA not connected\"}");
     return;
   }
+  submitDetectJob(DETECT_JOB_TEST);
+}
 
-  const String testUrl = "http://192.168.0.102:8003/detect";
-
-  camera_fb_t* fb = esp_camera_fb_get();
-  if (!fb) {
+// GET /dice/job/<id>[?wait=<ms>]
+static void handleDiceJob() {
+  uint32_t id = (uint32_t)httpServer.pathArg(0).toInt();
+  DetectJob job;
+  uint32_t waitMs = jobWaitArg();
+  bool found = waitMs ? (detectJobWait(id, waitMs, job) || detectJobGet(id, job)) : detectJobGet(id, job);
+  if (!found) {
     addNoCacheAndCors();
-    httpServer.send(500, "application/json", "{\"ok\":false,\"error\":\"camera capture failed\"}");
+    httpServer.send(404, "application/json", "{\"ok\":false,\"error\":\"unknown job\"}");
     return;
   }
+  sendDetectJob(job);
+}
 
-  DiceDetection detection = {false, 0, 0, 0, 0, 0, 0.0f, 0};
-  if (fb->format == PIXFORMAT_JPEG) {
-    detectDiceToTestServer(fb->buf, fb->len, testUrl, detection);
+// The ETag is the detection state version, so a poller that sends it back in
+// If-None-Match gets an empty 304 until the next result is recorded.
+static void handleDiceStatus() {
+  DetectionSnapshot last;
+  uint32_t version = detectionStateRead(last);
+  char etag[16];
+  snprintf(etag, sizeof(etag), "\"d%u\"", (unsigned)version);
+  if (httpServer.header("If-None-Match") == etag) {
+    addNoCacheAndCors();
+    httpServer.sendHeader("ETag", etag);
+    httpServer.send(304);
+    return;
   }
-  
-  esp_camera_fb_return(fb);
-  lastDetection = detection;
-  lastDetectionTimestamp = millis();
-
-  String json = String("{\"ok\":true,\"detected\":") + (detection.detected?"true":"false") +
-                ",\"value\":" + detection.value +
-                ",\"timestamp\":" + lastDetectionTimestamp +
-                ",\"confidence\":" + String(detection.confidence, 3) +
-                ",\"second_most_likely\":" + detection.second_most_likely + "}";
-  
-  addNoCacheAndCors();
-  httpServer.send(200, "application/json", json);
+  if (clientWantsWire()) {
+    httpServer.sendHeader("ETag", etag);
+    sendDetectionWire(last.detection, last.seq, last.timestampMs);
+    return;
+  }
+  char buf[224];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginObject()
+    .add("ok", true)
+    .add("version", version)
+    .add("seq", last.seq)
+    .add("source", detectionSourceName(last.source))
+    .add("detected", last.detection.detected)
+    .add("value", last.detection.value)
+    .add("timestamp", last.timestampMs)
+    .add("confidence", last.detection.confidence)
+    .add("second_most_likely", last.detection.second_most_likely)
+    .endObject();
+  httpServer.sendHeader("ETag", etag);
+  sendJson(200, w);
 }
 
-static void handleDiceStatus() {
-  String json = String("{\"ok\":true,\"detected\":") + (lastDetection.detected?"true":"false") +
-                ",\"value\":" + lastDetection.value +
-                ",\"timestamp\":" + lastDetectionTimestamp +
-                ",\"confidence\":" + String(lastDetection.confidence, 3) +
-                ",\"second_most_likely\":" + lastDetection.second_most_likely + "}";
-  addNoCacheAndCors();
-  httpServer.send(200, "application/json", json);
+// Everything after ?since=<seq> still in the ring, plus the running totals.
+// The body goes into a static buffer: a full ring is ~5 KB, too much for the
+// loop task's stack, and handlers only ever run on that one task.
+static void handleDiceHistory() {
+  static char buf[6144];
+  uint32_t since = httpServer.hasArg("since") ? strtoul(httpServer.arg("since").c_str(), nullptr, 10) : 0;
+  DetectionRecord records[kDetectionHistoryCapacity];
+  uint32_t latest = 0;
+  bool truncated = false;
+  int count = detectionHistorySince(since, records, kDetectionHistoryCapacity, &latest, &truncated);
+  DetectionHistoryStats stats;
+  detectionHistoryGetStats(stats);
+
+  JsonWriter w(buf, sizeof(buf));
+  w.beginObject()
+    .add("ok", true)
+    .add("seq", latest)
+    .add("truncated", truncated)
+    .add("capacity", kDetectionHistoryCapacity);
+  w.beginArray("detections");
+  for (int i = 0; i < count; ++i) {
+    const DetectionRecord& r = records[i];
+    w.beginObject()
+      .add("seq", r.seq)
+      .add("timestamp", r.timestampMs)
+      .add("source", detectionSourceName((DetectionSource)r.source))
+      .add("detected", r.detected)
+      .add("value", r.value)
+      .add("confidence", r.confidence)
+      .add("second_most_likely", r.second);
+    if (r.latencyMs != kDetectionLatencyUnknown) w.add("latency_ms", r.latencyMs);
+    w.endObject();
+  }
+  w.endArray();
+
+  w.beginObject("stats")
+    .add("recorded", stats.recorded)
+    .add("detected", stats.detected);
+  w.beginObject("faces");
+  for (int face = 1; face <= kDetectionMaxFace; ++face) {
+    if (!stats.faces[face]) continue;
+    char key[4];
+    snprintf(key, sizeof(key), "%d", face);
+    w.add(key, stats.faces[face]);
+  }
+  w.endObject();
+  w.beginObject("sources");
+  for (int i = 0; i < DETECTION_SOURCE_COUNT; ++i) {
+    const DetectionSourceStats& src = stats.sources[i];
+    if (!src.count) continue;
+    w.beginObject(detectionSourceName((DetectionSource)i)).add("count", src.count);
+    if (src.timed) {
+      w.add("latency_min_ms", src.minMs)
+        .add("latency_max_ms", src.maxMs)
+        .add("latency_avg_ms", (double)src.sumMs / src.timed, 1)
+        .add("latency_last_ms", src.lastMs);
+    }
+    w.endObject();
+  }
+  w.endObject();
+  w.endObject();
+  w.endObject();
+  sendJson(200, w);
 }
 
 // Return a single JPEG snapshot for external processing.
@@ -699,7 +1145,7 @@ static void handleCameraSnapshot() {
     httpServer.send(500, "text/plain", "camera not initialized");
     return;
   }
-  camera_fb_t* fb = esp_camera_fb_get();
+  camera_fb_t* fb = cameraFrameGet();
   if (!fb) {
     addNoCacheAndCors();
     httpServer.send(500, "text/plain", "capture failed");
@@ -713,7 +1159,31 @@ static void handleCameraSnapshot() {
   httpServer.send(200);
   WiFiClient client = httpServer.client();
   client.write((const uint8_t*)fb->buf, fb->len);
-  esp_camera_fb_return(fb);
+  cameraFrameReturn(fb);
+}
+
+// Raw body of POST /external/detection. With an upload callback registered the
+// WebServer streams every non-form body here instead of filling arg("plain"),
+// which could not carry binary records anyway (it stops at the first NUL).
+static uint8_t externalBody[512];
+static size_t externalBodyLen = 0;
+static bool externalBodyOverflow = false;
+
+static void handleExternalDetectionRaw() {
+  HTTPRaw& raw = httpServer.raw();
+  if (raw.status == RAW_START) {
+    externalBodyLen = 0;
+    externalBodyOverflow = false;
+  } else if (raw.status == RAW_WRITE) {
+    if (externalBodyLen + raw.currentSize > sizeof(externalBody)) {
+      externalBodyOverflow = true;
+      return;
+    }
+    memcpy(externalBody + externalBodyLen, raw.buf, raw.currentSize);
+    externalBodyLen += raw.currentSize;
+  } else if (raw.status == RAW_ABORTED) {
+    externalBodyLen = 0;
+  }
 }
 
 static void handleExternalDetection() {
@@ -726,22 +1196,45 @@ static void handleExternalDetection() {
     httpServer.send(405, "application/json", "{\"ok\":false,\"error\":\"method not allowed\"}");
     return;
   }
-  String body = httpServer.arg("plain");
-  if (!body.length()) {
+  if (externalBodyOverflow) {
+    addNoCacheAndCors();
+    httpServer.send(413, "application/json", "{\"ok\":false,\"error\":\"body too large\"}");
+    return;
+  }
+  if (!externalBodyLen) {
     addNoCacheAndCors();
     httpServer.send(400, "application/json", "{\"ok\":false,\"error\":\"empty body\"}");
     return;
   }
 
+  if (detectionWireMatches(httpServer.header("Content-Type").c_str())) {
+    DiceDetection incoming;
+    if (!detectionWireDecode(externalBody, externalBodyLen, incoming, nullptr, nullptr)) {
+      addNoCacheAndCors();
+      httpServer.send(400, "application/json", "{\"ok\":false,\"error\":\"invalid detection record\"}");
+      return;
+    }
+    DetectionSnapshot recorded = recordDetection(incoming, DETECTION_SOURCE_EXTERNAL);
+    if (clientWantsWire()) {
+      sendDetectionWire(incoming, recorded.seq, recorded.timestampMs);
+      return;
+    }
+    addNoCacheAndCors();
+    httpServer.send(200, "application/json", "{\"ok\":true}");
+    return;
+  }
+
   JsonDocument doc;
-  DeserializationError err = deserializeJson(doc, body);
+  DeserializationError err = deserializeJson(doc, (const char*)externalBody, externalBodyLen);
   if (err) {
     addNoCacheAndCors();
     httpServer.send(400, "application/json", "{\"ok\":false,\"error\":\"invalid json\"}");
     return;
   }
 
-  DiceDetection incoming = lastDetection;
+  DetectionSnapshot last;
+  detectionStateRead(last);
+  DiceDetection incoming = last.detection;
   incoming.detected = doc["detected"] | true;
   incoming.value = doc["value"] | incoming.value;
   incoming.confidence = doc["confidence"] | incoming.confidence;
@@ -751,8 +1244,7 @@ static void handleExternalDetection() {
   incoming.h = 0;
   incoming.second_most_likely = doc["second_most_likely"] | 0;
 
-  lastDetection = incoming;
-  lastDetectionTimestamp = millis();
+  recordDetection(incoming, DETECTION_SOURCE_EXTERNAL);
 
   addNoCacheAndCors();
   httpServer.send(200, "application/json", "{\"ok\":true}");
@@ -783,12 +1275,16 @@ static void handleProvision() {
   if (!connected) {
     staConnected = false;
   }
-  String json = String("{\"ok\":") + (saved?"true":"false") + 
-                ",\"connected\":" + (connected?"true":"false") + 
-                ",\"ip\":\"" + (connected ? WiFi.localIP().toString() : "") + 
-                "\",\"name\":\"" + creds.name + "\"}";
-  addNoCacheAndCors();
-  httpServer.send(saved ? 200 : 500, "application/json", json);
+  char buf[192];
+  char ip[16];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginObject()
+    .add("ok", saved)
+    .add("connected", connected)
+    .add("ip", connected ? formatIp(WiFi.localIP(), ip) : "")
+    .add("name", creds.name.c_str())
+    .endObject();
+  sendJson(saved ? 200 : 500, w);
 }
 
 static void handleWipe() {
@@ -797,7 +1293,7 @@ static void handleWipe() {
     removed = LittleFS.remove(kCredsPath);
   }
   addNoCacheAndCors();
-  httpServer.send(200, "application/json", String("{\"ok\":" ) + (removed?"true":"false") + "}\nRebooting...");
+  httpServer.send(200, "application/json", removed ? "{\"ok\":true}\nRebooting..." : "{\"ok\":false}\nRebooting...");
   delay(200);
   ESP.restart();
 }
@@ -808,8 +1304,10 @@ static void handleName() {
   if (action == "get") {
     WifiCredentials creds;
     if (loadCredentials(creds)) {
-      addNoCacheAndCors();
-      httpServer.send(200, "application/json", String("{\"ok\":true,\"name\":\"") + creds.name + "\"}");
+      char buf[128];
+      JsonWriter w(buf, sizeof(buf));
+      w.beginObject().add("ok", true).add("name", creds.name.c_str()).endObject();
+      sendJson(200, w);
     } else {
       addNoCacheAndCors();
       httpServer.send(200, "application/json", "{\"ok\":true,\"name\":\"\"}");
@@ -820,8 +1318,10 @@ static void handleName() {
     if (loadCredentials(creds)) {
       creds.name = newName;
       bool saved = saveCredentials(creds);
-      addNoCacheAndCors();
-      httpServer.send(saved ? 200 : 500, "application/json", String("{\"ok\":") + (saved?"true":"false") + ",\"name\":\"" + newName + "\"}");
+      char buf[128];
+      JsonWriter w(buf, sizeof(buf));
+      w.beginObject().add("ok", saved).add("name", newName.c_str()).endObject();
+      sendJson(saved ? 200 : 500, w);
     } else {
       addNoCacheAndCors();
       httpServer.send(404, "application/json", "{\"ok\":false,\"error\":\"no credentials found\"}");
@@ -852,24 +1352,65 @@ static void handleCameraSettings() {
   }
   
   if (httpServer.method() == HTTP_GET) {
-    // Return current settings
-    JsonDocument doc;
-    doc["ok"] = true;
-    doc["brightness"] = 2;  // Default, sensor doesn't expose getter
-    doc["contrast"] = 1;
-    doc["saturation"] = 1;
-    doc["special_effect"] = 2;
-    doc["ae_level"] = 2;
-    doc["aec_value"] = 600;
-    doc["agc_gain"] = 0;
-    doc["gainceiling"] = 2;
-    doc["stream_delay_ms"] = streamDelayMs;
-    doc["frame_size_mode"] = frameSizeMode;
-    
-    String json;
-    serializeJson(doc, json);
-    addNoCacheAndCors();
-    httpServer.send(200, "application/json", json);
+    // Sensor values come from the camera_sensor cache, not the registers.
+    char buf[1536];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject().add("ok", true);
+    for (int i = 0; i < SENSOR_FIELD_COUNT; ++i) {
+      w.add(cameraSensorKey((SensorField)i), cameraSensorGet((SensorField)i));
+    }
+    w.add("stream_delay_ms", streamDelayMs)
+      .add("frame_size", cameraModeInfo(frameSizeMode).name)
+      .add("frame_size_active", cameraModeInfo(cameraModeCurrent()).name)
+      .add("stream_overlay", streamOverlay)
+      .add("jpeg_quality", jpegQuality);
+
+    StreamRateState rate;
+    streamRateGetState(rate);
+    w.beginObject("abr")
+      .add("enabled", streamRateConfig.enabled)
+      .add("target_fps", streamRateConfig.targetFps)
+      .add("allow_frame_size", streamRateAllowFrameSize)
+      .add("quality", rate.quality)
+      .add("delay_ms", rate.frameDelayMs)
+      .add("downshift", rate.downshift)
+      .add("fps", rate.fps)
+      .add("send_ms", rate.sendMs)
+      .add("kbps", rate.kbps)
+      .endObject();
+
+    // Selectable sizes stop at the largest one the PSRAM budget allowed at boot.
+    w.beginArray("frame_sizes");
+    for (int i = 0; i <= cameraModeMax(); ++i) {
+      const CameraMode& mode = cameraModeInfo(i);
+      w.beginObject().add("name", mode.name).add("width", (int)mode.width).add("height", (int)mode.height).endObject();
+    }
+    w.endArray();
+
+    CameraModeStats modeStats;
+    cameraModeGetStats(modeStats);
+    w.beginObject("frame_switch")
+      .add("switches", modeStats.switches)
+      .add("rejected", modeStats.rejected)
+      .add("discarded", modeStats.discarded)
+      .add("last_drain_ms", modeStats.lastDrainMs)
+      .add("last_first_frame_ms", modeStats.lastFirstFrameMs)
+      .add("last_switch_ms", modeStats.lastSwitchMs)
+      .add("first_frame_timeouts", modeStats.firstFrameTimeouts)
+      .endObject();
+
+    CameraSensorStats sensor;
+    cameraSensorGetStats(sensor);
+    w.beginObject("sccb")
+      .add("writes", sensor.writes)
+      .add("failures", sensor.failures)
+      .add("unchanged", sensor.unchanged)
+      .add("coalesced", sensor.coalesced)
+      .add("pending", sensor.pending)
+      .add("saves", sensor.saves)
+      .endObject();
+    w.endObject();
+    sendJson(200, w);
     return;
   }
   
@@ -889,52 +1430,80 @@ static void handleCameraSettings() {
       return;
     }
     
-    // Apply settings
-    if (doc["brightness"].is<int>()) {
-      int val = doc["brightness"];
-      s->set_brightness(s, clampi(val, -2, 2));
-    }
-    if (doc["contrast"].is<int>()) {
-      int val = doc["contrast"];
-      s->set_contrast(s, clampi(val, -2, 2));
+    // Only fields present in the body are touched; the registers are
+    // written by cameraSensorPoll() once the client pauses.
+    for (int i = 0; i < SENSOR_FIELD_COUNT; ++i) {
+      JsonVariant v = doc[cameraSensorKey((SensorField)i)];
+      if (v.is<int>()) cameraSensorSet((SensorField)i, v.as<int>());
     }
-    if (doc["saturation"].is<int>()) {
-      int val = doc["saturation"];
-      s->set_saturation(s, clampi(val, -2, 2));
+    // Resetting the controller rewrites quality and frame size over SCCB, so
+    // only a value that actually differs counts as a change.
+    bool rateChanged = false;
+    if (doc["stream_delay_ms"].is<int>()) {
+      int val = clampi((int)doc["stream_delay_ms"], 0, 100);
+      rateChanged |= val != streamDelayMs;
+      streamDelayMs = val;
     }
-    if (doc["special_effect"].is<int>()) {
-      int val = doc["special_effect"];
-      s->set_special_effect(s, clampi(val, 0, 6));
+    if (doc["jpeg_quality"].is<int>()) {
+      int val = clampi((int)doc["jpeg_quality"], 4, 63);
+      rateChanged |= val != jpegQuality;
+      jpegQuality = val;
     }
-    if (doc["ae_level"].is<int>()) {
-      int val = doc["ae_level"];
-      s->set_ae_level(s, clampi(val, -2, 2));
+    if (doc["abr_enabled"].is<bool>()) {
+      bool val = doc["abr_enabled"].as<bool>();
+      rateChanged |= val != streamRateConfig.enabled;
+      streamRateConfig.enabled = val;
     }
-    if (doc["aec_value"].is<int>()) {
-      int val = doc["aec_value"];
-      s->set_aec_value(s, clampi(val, 0, 1200));
+    if (doc["abr_target_fps"].is<int>()) {
+      int val = clampi((int)doc["abr_target_fps"], 1, 30);
+      rateChanged |= val != streamRateConfig.targetFps;
+      streamRateConfig.targetFps = val;
     }
-    if (doc["agc_gain"].is<int>()) {
-      int val = doc["agc_gain"];
-      s->set_agc_gain(s, clampi(val, 0, 30));
+    if (doc["abr_allow_frame_size"].is<bool>()) {
+      bool val = doc["abr_allow_frame_size"].as<bool>();
+      rateChanged |= val != streamRateAllowFrameSize;
+      streamRateAllowFrameSize = val;
     }
-    if (doc["gainceiling"].is<int>()) {
-      int val = doc["gainceiling"];
-      s->set_gainceiling(s, (gainceiling_t)clampi(val, 0, 6));
+    if (doc["stream_overlay"].is<bool>()) {
+      streamOverlay = doc["stream_overlay"].as<bool>();
     }
-    if (doc["stream_delay_ms"].is<int>()) {
-      int val = doc["stream_delay_ms"];
-      streamDelayMs = clampi(val, 0, 100);
+    // frame_size names a camera_mode entry; frame_size_mode 0/1 is the old
+    // QVGA/VGA toggle. The switch drains every frame user before the sensor
+    // changes size, so it can fail if one is busy.
+    int targetMode = -1;
+    if (doc["frame_size"].is<const char*>()) {
+      targetMode = cameraModeFind(doc["frame_size"].as<const char*>());
+    } else if (doc["frame_size_mode"].is<int>()) {
+      targetMode = kLegacyFrameModes[clampi((int)doc["frame_size_mode"], 0, 1)];
     }
-    if (doc["frame_size_mode"].is<int>()) {
-      int val = clampi((int)doc["frame_size_mode"], 0, 1);
-      frameSizeMode = val;
-      sensor_t * sensor = esp_camera_sensor_get();
-      if (sensor) {
-        sensor->set_framesize(sensor, frameSizeMode ? FRAMESIZE_VGA : FRAMESIZE_QVGA);
+    const char* frameError = nullptr;
+    if (targetMode < 0 && doc["frame_size"].is<const char*>()) {
+      frameError = "unknown frame size";
+    } else if (targetMode > cameraModeMax()) {
+      frameError = "frame size exceeds the memory budget";
+    } else if (targetMode >= 0 && targetMode != frameSizeMode) {
+      if (cameraModeSwitch(targetMode, kModeSwitchDrainMs, &frameError)) {
+        frameSizeMode = targetMode;
+        rateChanged = true;
       }
     }
-    
+    // Manual values become the controller's new starting point.
+    if (rateChanged) {
+      resetStreamRate();
+    }
+
+    if (frameError) {
+      // Everything else in the body was applied; only the frame size stayed.
+      char buf[160];
+      JsonWriter w(buf, sizeof(buf));
+      w.beginObject()
+        .add("ok", false)
+        .add("error", frameError)
+        .add("frame_size", cameraModeInfo(frameSizeMode).name)
+        .endObject();
+      sendJson(targetMode > cameraModeMax() || targetMode < 0 ? 400 : 503, w);
+      return;
+    }
     addNoCacheAndCors();
     httpServer.send(200, "application/json", "{\"ok\":true}");
     return;
@@ -944,6 +1513,102 @@ static void handleCameraSettings() {
   httpServer.send(405, "application/json", "{\"ok\":false,\"error\":\"method not allowed\"}");
 }
 
+// GET/POST /dice/auto - roll-settle auto capture configuration and counters.
+static void handleDiceAuto() {
+  if (httpServer.method() == HTTP_GET) {
+    RollSettleConfig cfg;
+    RollSettleStats stats;
+    rollSettleGetConfig(cfg);
+    rollSettleGetStats(stats);
+
+    char buf[320];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject()
+      .add("ok", true)
+      .add("enabled", cfg.enabled)
+      .add("period_ms", cfg.periodMs)
+      .add("motion_delta", cfg.motionDelta)
+      .add("motion_blocks", cfg.motionBlocks)
+      .add("stable_frames", cfg.stableFrames)
+      .add("moving", stats.phase == ROLL_SETTLE_MOVING)
+      .add("frames", stats.frames)
+      .add("settles", stats.settles)
+      .add("changed_blocks", stats.changedBlocks)
+      .add("last_motion_ms", stats.lastMotionMs)
+      .add("last_settle_ms", stats.lastSettleMs)
+      .endObject();
+    sendJson(200, w);
+    return;
+  }
+
+  String body = httpServer.arg("plain");
+  JsonDocument doc;
+  if (!body.length() || deserializeJson(doc, body)) {
+    addNoCacheAndCors();
+    httpServer.send(400, "application/json", "{\"ok\":false,\"error\":\"invalid json\"}");
+    return;
+  }
+
+  RollSettleConfig cfg;
+  rollSettleGetConfig(cfg);
+  if (doc["enabled"].is<bool>()) cfg.enabled = doc["enabled"].as<bool>();
+  if (doc["period_ms"].is<int>()) cfg.periodMs = clampi((int)doc["period_ms"], 10, 2000);
+  if (doc["motion_delta"].is<int>()) cfg.motionDelta = clampi((int)doc["motion_delta"], 1, 255);
+  if (doc["motion_blocks"].is<int>()) cfg.motionBlocks = clampi((int)doc["motion_blocks"], 1, 4800);
+  if (doc["stable_frames"].is<int>()) cfg.stableFrames = clampi((int)doc["stable_frames"], 1, 50);
+  rollSettleConfigure(cfg);
+
+  addNoCacheAndCors();
+  httpServer.send(200, "application/json", "{\"ok\":true}");
+}
+
+// GET/POST /dice/burst - multi-frame voting for /dice/capture and auto capture.
+static void handleDiceBurst() {
+  if (httpServer.method() == HTTP_GET) {
+    BurstConfig cfg;
+    BurstStats stats;
+    burstGetConfig(cfg);
+    burstGetStats(stats);
+
+    char buf[320];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject()
+      .add("ok", true)
+      .add("frames", cfg.frames)
+      .add("agree_frames", cfg.agreeFrames)
+      .add("min_confidence", cfg.minConfidence)
+      .add("bursts", stats.bursts)
+      .add("frames_captured", stats.frames)
+      .add("frames_skipped", stats.skipped)
+      .add("early_exits", stats.earlyExits)
+      .add("capture_failures", stats.captureFailures)
+      .add("last_frames", stats.lastFrames)
+      .add("last_agreement", stats.lastAgreement)
+      .add("last_ms", stats.lastMs)
+      .endObject();
+    sendJson(200, w);
+    return;
+  }
+
+  String body = httpServer.arg("plain");
+  JsonDocument doc;
+  if (!body.length() || deserializeJson(doc, body)) {
+    addNoCacheAndCors();
+    httpServer.send(400, "application/json", "{\"ok\":false,\"error\":\"invalid json\"}");
+    return;
+  }
+
+  BurstConfig cfg;
+  burstGetConfig(cfg);
+  if (doc["frames"].is<int>()) cfg.frames = clampi((int)doc["frames"], 1, kBurstMaxFrames);
+  if (doc["agree_frames"].is<int>()) cfg.agreeFrames = clampi((int)doc["agree_frames"], 1, kBurstMaxFrames);
+  if (doc["min_confidence"].is<float>()) cfg.minConfidence = doc["min_confidence"].as<float>();
+  burstConfigure(cfg);
+
+  addNoCacheAndCors();
+  httpServer.send(200, "application/json", "{\"ok\":true}");
+}
+
 static void handleDetectionServer() {
   if (httpServer.method() == HTTP_OPTIONS) {
     handleOptions();
@@ -951,15 +1616,22 @@ static void handleDetectionServer() {
   }
   
   if (httpServer.method() == HTTP_GET) {
-    JsonDocument doc;
-    doc["ok"] = true;
-    doc["server_url"] = externalDetectionServer;
-    doc["enabled"] = (externalDetectionServer.length() > 0);
-    
-    String json;
-    serializeJson(doc, json);
-    addNoCacheAndCors();
-    httpServer.send(200, "application/json", json);
+    String serverUrl = detectionServerUrl();
+    TrayRoi tray = currentTrayRoi();
+    char buf[384];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject()
+      .add("ok", true)
+      .add("server_url", serverUrl.c_str())
+      .add("enabled", serverUrl.length() > 0);
+    w.beginObject("tray_roi")
+      .add("x", tray.x)
+      .add("y", tray.y)
+      .add("w", tray.w)
+      .add("h", tray.h)
+      .endObject();
+    w.endObject();
+    sendJson(200, w);
     return;
   }
   
@@ -979,22 +1651,49 @@ static void handleDetectionServer() {
       return;
     }
     
-    if (doc["server_url"].is<String>()) {
-      externalDetectionServer = doc["server_url"].as<String>();
+    if (doc["server_url"].is<const char*>()) {
+      const char* url = doc["server_url"].as<const char*>();
+      if (!setDetectionServerUrl(url)) {
+        addNoCacheAndCors();
+        httpServer.send(400, "application/json", "{\"ok\":false,\"error\":\"server_url too long\"}");
+        return;
+      }
+      if (!url[0]) detectServerDisconnect();
       // Save to LittleFS for persistence
       const char* serverPath = "/detection_server.txt";
       File f = LittleFS.open(serverPath, "w");
       if (f) {
-        f.print(externalDetectionServer);
+        f.print(url);
         f.close();
       }
     } else if (doc["enabled"].is<bool>() && !doc["enabled"].as<bool>()) {
-      externalDetectionServer = "";
+      setDetectionServerUrl("");
+      detectServerDisconnect();
       const char* serverPath = "/detection_server.txt";
       if (LittleFS.exists(serverPath)) {
         LittleFS.remove(serverPath);
       }
     }
+
+    // Tray ROI as fractions of the frame; {"tray_roi":{"w":0}} goes back to full frames.
+    if (doc["tray_roi"].is<JsonObject>()) {
+      JsonObject roi = doc["tray_roi"];
+      TrayRoi tray;
+      tray.x = clampf(roi["x"] | 0.0f, 0.0f, 1.0f);
+      tray.y = clampf(roi["y"] | 0.0f, 0.0f, 1.0f);
+      tray.w = clampf(roi["w"] | 0.0f, 0.0f, 1.0f - tray.x);
+      tray.h = clampf(roi["h"] | 0.0f, 0.0f, 1.0f - tray.y);
+      setTrayRoi(tray);
+      if (tray.w > 0.0f && tray.h > 0.0f) {
+        File f = LittleFS.open(kTrayRoiPath, "w");
+        if (f) {
+          f.printf("%.4f,%.4f,%.4f,%.4f", tray.x, tray.y, tray.w, tray.h);
+          f.close();
+        }
+      } else if (LittleFS.exists(kTrayRoiPath)) {
+        LittleFS.remove(kTrayRoiPath);
+      }
+    }
     
     addNoCacheAndCors();
     httpServer.send(200, "application/json", "{\"ok\":true}");
@@ -1005,18 +1704,88 @@ static void handleDetectionServer() {
   httpServer.send(405, "application/json", "{\"ok\":false,\"error\":\"method not allowed\"}");
 }
 
-// Stop the active MJPEG stream by setting a flag
+// POST /camera/stream/stop[?id=N] - ends one session, or every session without an id.
 static void handleStreamStop() {
-  streamStopRequested = true;
+  if (httpServer.hasArg("id")) {
+    uint32_t id = (uint32_t)httpServer.arg("id").toInt();
+    bool found = streamHubStop(id);
+    addNoCacheAndCors();
+    if (!found) {
+      httpServer.send(404, "application/json", "{\"ok\":false,\"error\":\"no such session\"}");
+      return;
+    }
+    httpServer.send(200, "application/json", "{\"ok\":true,\"message\":\"session stop requested\"}");
+    return;
+  }
+  streamHubStopAll();
   addNoCacheAndCors();
   httpServer.send(200, "application/json", "{\"ok\":true,\"message\":\"stream stop requested\"}");
 }
 
+static void handleStreamSessions() {
+  StreamSessionInfo sessions[4];
+  int count = streamHubListSessions(sessions, 4);
+
+  char buf[768];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginObject().add("ok", true).beginArray("sessions");
+  for (int i = 0; i < count; ++i) {
+    const StreamSessionInfo& info = sessions[i];
+    w.beginObject()
+      .add("id", info.id)
+      .add("peer", info.peer)
+      .add("connected_ms", info.connectedMs)
+      .add("frames", info.frames)
+      .add("bytes", info.bytes)
+      .add("avg_send_ms", info.avgSendMs)
+      .add("dropped", info.dropped)
+      .endObject();
+  }
+  w.endArray().endObject();
+  sendJson(200, w);
+}
+
+// Keeps staConnected/staIp current when the STA link drops or comes back on
+// its own, and pushes a `wifi` event on every change.
+static void watchWifiState() {
+  static uint32_t lastCheckMs = 0;
+  static bool published = false;
+  uint32_t now = millis();
+  if (published && now - lastCheckMs < kWifiWatchMs) return;
+  lastCheckMs = now;
+
+  bool connected = WiFi.status() == WL_CONNECTED;
+  IPAddress ip = connected ? WiFi.localIP() : IPAddress();
+  if (published && connected == staConnected && ip == staIp) return;
+  staConnected = connected;
+  if (connected) staIp = ip;
+  published = true;
+
+  char json[160];
+  char apIp[16];
+  char staIpText[16];
+  JsonWriter w(json, sizeof(json));
+  w.beginObject();
+  w.beginObject("ap").add("ssid", currentApSsid.c_str()).add("ip", formatIp(currentApIp, apIp)).endObject();
+  w.beginObject("sta").add("connected", connected).add("ip", connected ? formatIp(staIp, staIpText) : "").endObject();
+  w.endObject();
+  eventHubPublish("wifi", json);
+}
+
+// Port 81 holds every SSE client and stream viewer open at once, plus one
+// socket to answer the next connection with a 503. LRU purge only reclaims
+// sockets beyond that, so a refused client never evicts a live one.
+static constexpr int kStreamServerSockets = kEventHubMaxClients + kStreamHubMaxSubscribers + 1;
+// httpd keeps 3 sockets of its own; the rest is port 80 (listener + client) and
+// the detection server keep-alive plus a one-off GPT upload.
+static_assert(kStreamServerSockets + 3 + 4 <= CONFIG_LWIP_MAX_SOCKETS, "port 81 limits exceed LWIP_MAX_SOCKETS");
+
 static void startStreamServer() {
   httpd_config_t config = HTTPD_DEFAULT_CONFIG();
   config.server_port = 81;
   config.ctrl_port = 32817;
   config.max_resp_headers = 16;
+  config.max_open_sockets = kStreamServerSockets;
   config.lru_purge_enable = true;
   if (httpd_start(&streamHttpd, &config) == ESP_OK) {
     httpd_uri_t streamUri = {
@@ -1026,6 +1795,23 @@ static void startStreamServer() {
       .user_ctx = nullptr
     };
     httpd_register_uri_handler(streamHttpd, &streamUri);
+    httpd_uri_t eventsUri = {
+      .uri = "/events",
+      .method = HTTP_GET,
+      .handler = eventsHttpdHandler,
+      .user_ctx = nullptr
+    };
+    httpd_register_uri_handler(streamHttpd, &eventsUri);
+    if (!eventHubBegin(streamHttpd)) {
+      Serial.println("Event hub failed to start");
+    }
+    resetStreamRate();
+    streamHubSetRateHook(applyStreamRate);
+    streamHubSetIdleHook(restoreStreamRate);
+    overlayCodec = jpegCodecCreate();
+    if (!streamHubBegin(streamHttpd, renderOverlayFrame)) {
+      Serial.println("Stream hub failed to start (frame pool exhausted?)");
+    }
     Serial.println("Stream server started on port 81");
   } else {
     Serial.println("Failed to start stream server");
@@ -1051,15 +1837,35 @@ void setup() {
   if (LittleFS.exists(serverPath)) {
     File f = LittleFS.open(serverPath, "r");
     if (f) {
-      externalDetectionServer = f.readString();
+      String url = f.readString();
+      f.close();
+      if (setDetectionServerUrl(url.c_str())) {
+        Serial.print("Loaded detection server: ");
+        Serial.println(url);
+      }
+    }
+  }
+  if (LittleFS.exists(kTrayRoiPath)) {
+    File f = LittleFS.open(kTrayRoiPath, "r");
+    if (f) {
+      String roi = f.readString();
       f.close();
-      Serial.print("Loaded detection server: ");
-      Serial.println(externalDetectionServer);
+      TrayRoi tray = {0.0f, 0.0f, 0.0f, 0.0f};
+      if (sscanf(roi.c_str(), "%f,%f,%f,%f", &tray.x, &tray.y, &tray.w, &tray.h) == 4) setTrayRoi(tray);
     }
   }
+  detectCodec = jpegCodecCreate();
+  detectCodecLock = xSemaphoreCreateMutex();
 
   // Initialize camera
   cameraInitialized = initCamera();
+  const CameraMode& largest = cameraModeInfo(cameraModeMax());
+  if (cameraInitialized && !framePoolBegin(largest.width, largest.height)) {
+    Serial.println("Frame pool allocation failed; stream overlay disabled");
+  }
+  if (cameraInitialized && diceModelBegin()) {
+    Serial.println("On-device dice model ready");
+  }
 
   // Wi-Fi setup
   WiFi.persistent(false);
@@ -1123,14 +1929,26 @@ void setup() {
   httpServer.on("/dice/capture", HTTP_OPTIONS, handleOptions);
   httpServer.on("/dice/capture_gpt", handleDiceCaptureGpt);
   httpServer.on("/dice/capture_gpt", HTTP_OPTIONS, handleOptions);
+  httpServer.on(UriBraces("/dice/job/{}"), HTTP_GET, handleDiceJob);
+  httpServer.on(UriBraces("/dice/job/{}"), HTTP_OPTIONS, handleOptions);
   httpServer.on("/dice/status", handleDiceStatus);
   httpServer.on("/dice/status", HTTP_OPTIONS, handleOptions);
-  httpServer.on("/external/detection", HTTP_POST, handleExternalDetection);
+  httpServer.on("/dice/history", HTTP_GET, handleDiceHistory);
+  httpServer.on("/dice/history", HTTP_OPTIONS, handleOptions);
+  httpServer.on("/dice/auto", HTTP_GET, handleDiceAuto);
+  httpServer.on("/dice/auto", HTTP_POST, handleDiceAuto);
+  httpServer.on("/dice/auto", HTTP_OPTIONS, handleOptions);
+  httpServer.on("/dice/burst", HTTP_GET, handleDiceBurst);
+  httpServer.on("/dice/burst", HTTP_POST, handleDiceBurst);
+  httpServer.on("/dice/burst", HTTP_OPTIONS, handleOptions);
+  httpServer.on("/external/detection", HTTP_POST, handleExternalDetection, handleExternalDetectionRaw);
   httpServer.on("/external/detection", HTTP_OPTIONS, handleOptions);
   httpServer.on("/camera/snapshot", HTTP_GET, handleCameraSnapshot);
   httpServer.on("/camera/snapshot", HTTP_OPTIONS, handleOptions);
   httpServer.on("/camera/stream/stop", HTTP_POST, handleStreamStop);
   httpServer.on("/camera/stream/stop", HTTP_OPTIONS, handleOptions);
+  httpServer.on("/camera/stream/sessions", HTTP_GET, handleStreamSessions);
+  httpServer.on("/camera/stream/sessions", HTTP_OPTIONS, handleOptions);
   httpServer.on("/provision", handleProvision);
   httpServer.on("/provision", HTTP_OPTIONS, handleOptions);
   httpServer.on("/wipe", handleWipe);
@@ -1146,32 +1964,52 @@ void setup() {
   httpServer.on("/dice/capture_test", handleDiceCaptureTest);
   httpServer.on("/dice/capture_test", HTTP_OPTIONS, handleOptions);
   httpServer.on("/whoami", HTTP_GET, []() {
-    JsonDocument doc;
-    doc["ok"] = true;
-    doc["sta_connected"] = (WiFi.status() == WL_CONNECTED);
-    doc["sta_ip"] = WiFi.localIP().toString();
-    doc["ap_ip"] = WiFi.softAPIP().toString();
-    doc["ap_ssid"] = currentApSsid;
-    String json;
-    serializeJson(doc, json);
-    addNoCacheAndCors();
-    httpServer.send(200, "application/json", json);
+    char buf[192];
+    char staIpText[16];
+    char apIp[16];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject()
+      .add("ok", true)
+      .add("sta_connected", WiFi.status() == WL_CONNECTED)
+      .add("sta_ip", formatIp(WiFi.localIP(), staIpText))
+      .add("ap_ip", formatIp(WiFi.softAPIP(), apIp))
+      .add("ap_ssid", currentApSsid.c_str())
+      .endObject();
+    sendJson(200, w);
   });
   httpServer.onNotFound([](){
     addNoCacheAndCors();
     httpServer.send(404, "text/plain", "Not Found");
   });
+  if (!detectJobsBegin(runDetectJob)) {
+    Serial.println("Detection worker failed to start");
+  }
+  if (!pipelineBegin(prepareTrayFrame, detectPipelineFrame) || !burstBegin()) {
+    Serial.println("Detection pipeline failed to start");
+  }
+  // Content negotiation for binary detection records (detection_wire.h) and
+  // ETag revalidation of the UI.
+  static const char* kCollectHeaders[] = {"Accept", "Content-Type", "If-None-Match"};
+  httpServer.collectHeaders(kCollectHeaders, 3);
   httpServer.begin();
   Serial.println("HTTP server started on port 80");
 
   if (cameraInitialized) {
     startStreamServer();
+    if (!rollSettleBegin(largest.width, largest.height, onRollSettled)) {
+      Serial.println("Roll-settle watcher failed to start");
+    }
   }
 }
 #pragma GCC diagnostic pop
 
 void loop() {
   httpServer.handleClient();
+  if (cameraInitialized) {
+    applyPendingStreamRate();
+    cameraSensorPoll();
+  }
+  watchWifiState();
   delay(1);
 }
 
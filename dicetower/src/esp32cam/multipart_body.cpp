@@ -0,0 +1,108 @@
+#include "multipart_body.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+MultipartBody::MultipartBody(const char* b)
+    : textUsed(0), segmentCount(0), parts(0), closed(false), total(0), seg(0), off(0), consumed(0) {
+  snprintf(boundary, sizeof(boundary), "%s", b);
+}
+
+bool MultipartBody::addSegment(const uint8_t* data, size_t len) {
+  if (segmentCount == kMaxSegments) return false;
+  segments[segmentCount++] = {data, len};
+  total += len;
+  return true;
+}
+
+// Formats into the inline text buffer and adds it as one segment.
+bool MultipartBody::appendText(const char* fmt, ...) {
+  if (segmentCount == kMaxSegments) return false;
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(text + textUsed, kTextBytes - textUsed, fmt, ap);
+  va_end(ap);
+  if (n < 0 || (size_t)n >= kTextBytes - textUsed) return false;
+  const uint8_t* start = (const uint8_t*)text + textUsed;
+  textUsed += n;
+  return addSegment(start, n);
+}
+
+bool MultipartBody::addFile(const char* name, const char* filename, const char* type, const uint8_t* data,
+                            size_t len) {
+  if (closed || segmentCount + 2 > kMaxSegments) return false;
+  // Parts after the first start with the CRLF that ends the previous payload.
+  if (!appendText("%s--%s\r\nContent-Disposition: form-data; name=\"%s\"; filename=\"%s\"\r\n"
+                  "Content-Type: %s\r\n\r\n",
+                  parts ? "\r\n" : "", boundary, name, filename, type)) {
+    return false;
+  }
+  parts++;
+  return addSegment(data, len);
+}
+
+bool MultipartBody::addField(const char* name, const char* value) {
+  if (closed) return false;
+  if (!appendText("%s--%s\r\nContent-Disposition: form-data; name=\"%s\"\r\n\r\n%s",
+                  parts ? "\r\n" : "", boundary, name, value)) {
+    return false;
+  }
+  parts++;
+  return true;
+}
+
+bool MultipartBody::finish() {
+  if (closed) return true;
+  closed = appendText("\r\n--%s--\r\n", boundary);
+  return closed;
+}
+
+String MultipartBody::contentType() const {
+  return String("multipart/form-data; boundary=") + boundary;
+}
+
+void MultipartBody::rewind() {
+  seg = 0;
+  off = 0;
+  consumed = 0;
+}
+
+int MultipartBody::available() {
+  size_t left = total - consumed;
+  return left > 0x7fffffff ? 0x7fffffff : (int)left;
+}
+
+int MultipartBody::peek() {
+  while (seg < segmentCount && off >= segments[seg].len) {
+    seg++;
+    off = 0;
+  }
+  return seg < segmentCount ? segments[seg].data[off] : -1;
+}
+
+int MultipartBody::read() {
+  int c = peek();
+  if (c >= 0) {
+    off++;
+    consumed++;
+  }
+  return c;
+}
+
+size_t MultipartBody::readBytes(char* buffer, size_t length) {
+  size_t n = 0;
+  while (n < length && seg < segmentCount) {
+    const Segment& s = segments[seg];
+    size_t chunk = s.len - off;
+    if (chunk > length - n) chunk = length - n;
+    memcpy(buffer + n, s.data + off, chunk);
+    n += chunk;
+    off += chunk;
+    if (off == s.len) {
+      seg++;
+      off = 0;
+    }
+  }
+  consumed += n;
+  return n;
+}
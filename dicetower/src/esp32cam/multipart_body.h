@@ -0,0 +1,57 @@
+#pragma once
+#include <Arduino.h>
+
+// multipart/form-data request body that is never assembled in memory. Part
+// headers and the closing boundary are formatted into a small inline buffer;
+// payloads (frame buffers) are read in place. Pass it to
+// HTTPClient::sendRequest("POST", &body, body.length()) and the bytes go from
+// the original buffers straight to the socket.
+class MultipartBody : public Stream {
+ public:
+  explicit MultipartBody(const char* boundary = "----esp32boundary");
+
+  // Adds a file part. `data` is not copied and must stay valid until the
+  // request has been sent. Returns false if the part table or header buffer
+  // is full.
+  bool addFile(const char* name, const char* filename, const char* contentType, const uint8_t* data, size_t len);
+  // Adds a short text field (the value is copied).
+  bool addField(const char* name, const char* value);
+  // Appends the closing boundary; no parts can be added afterwards.
+  bool finish();
+
+  size_t length() const { return total; }
+  String contentType() const;
+  // Starts reading from the beginning again (e.g. to retry the request).
+  void rewind();
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t readBytes(char* buffer, size_t length) override;
+  size_t write(uint8_t) override { return 0; }
+
+ private:
+  static const int kMaxSegments = 10;
+  static const size_t kTextBytes = 512;
+
+  struct Segment {
+    const uint8_t* data;
+    size_t len;
+  };
+
+  bool appendText(const char* fmt, ...);
+  bool addSegment(const uint8_t* data, size_t len);
+
+  char boundary[48];
+  char text[kTextBytes];  // Boundaries and part headers, referenced by segments
+  size_t textUsed;
+  Segment segments[kMaxSegments];
+  int segmentCount;
+  int parts;
+  bool closed;
+  size_t total;
+  // Read cursor
+  int seg;
+  size_t off;
+  size_t consumed;
+};
@@ -0,0 +1,275 @@
+#include "pip_counter.h"
+#include <string.h>
+
+namespace {
+
+const int kMaxLabels = 4096;     // Provisional labels per frame (uint16 ids, 0 = background)
+const int kMaxCandidates = 64;   // Shape-filtered blobs considered for clustering
+const uint32_t kFourPiQ8 = 3217; // 4 * pi * 256
+
+struct Blob {
+  uint32_t area;
+  uint32_t perimeter;
+  int16_t minX;
+  int16_t maxX;
+  int16_t minY;
+  int16_t maxY;
+};
+
+struct Candidate {
+  int cx;
+  int cy;
+  int area;
+  int circQ8;
+  int minX;
+  int maxX;
+  int minY;
+  int maxY;
+};
+
+inline size_t align4(size_t n) {
+  return (n + 3) & ~(size_t)3;
+}
+
+inline uint16_t findRoot(uint16_t* parent, uint16_t a) {
+  while (parent[a] != a) {
+    parent[a] = parent[parent[a]];  // Path halving
+    a = parent[a];
+  }
+  return a;
+}
+
+inline uint16_t unite(uint16_t* parent, uint16_t a, uint16_t b) {
+  a = findRoot(parent, a);
+  b = findRoot(parent, b);
+  if (a == b) return a;
+  if (a < b) {
+    parent[b] = a;
+    return a;
+  }
+  parent[a] = b;
+  return b;
+}
+
+int isqrt(int v) {
+  if (v <= 0) return 0;
+  int r = 0;
+  int bit = 1 << 30;
+  while (bit > v) bit >>= 2;
+  while (bit) {
+    if (v >= r + bit) {
+      v -= r + bit;
+      r = (r >> 1) + bit;
+    } else {
+      r >>= 1;
+    }
+    bit >>= 2;
+  }
+  return r;
+}
+
+}  // namespace
+
+void pipParamsDefault(PipParams& params) {
+  params.windowRadius = 0;
+  params.thresholdPct = 20;
+  params.minContrast = 24;
+  params.minArea = 0;
+  params.maxArea = 0;
+  params.minCircularityQ8 = 154;  // ~0.6
+}
+
+size_t pipScratchBytes(int width, int height) {
+  if (width <= 0 || height <= 0) return 0;
+  return align4((size_t)(width + 1) * (height + 1) * sizeof(uint32_t)) +
+         align4((size_t)width * height * sizeof(uint16_t)) +
+         align4(kMaxLabels * sizeof(uint16_t)) +
+         kMaxLabels * sizeof(Blob);
+}
+
+bool pipCount(const uint8_t* px, int width, int height, int pixelStride, int rowStride,
+              const PipParams& params, void* scratch, size_t scratchBytes, PipResult& out) {
+  memset(&out, 0, sizeof(out));
+  if (!px || !scratch || width < 8 || height < 8 || width > 32767 || height > 32767) return false;
+  if (scratchBytes < pipScratchBytes(width, height)) return false;
+
+  uint8_t* mem = (uint8_t*)scratch;
+  const int iw = width + 1;
+  uint32_t* integral = (uint32_t*)mem;
+  mem += align4((size_t)iw * (height + 1) * sizeof(uint32_t));
+  uint16_t* labels = (uint16_t*)mem;
+  mem += align4((size_t)width * height * sizeof(uint16_t));
+  uint16_t* parent = (uint16_t*)mem;
+  mem += align4(kMaxLabels * sizeof(uint16_t));
+  Blob* blobs = (Blob*)mem;
+
+  const int minDim = width < height ? width : height;
+  int radius = params.windowRadius > 0 ? params.windowRadius : minDim / 16;
+  if (radius < 4) radius = 4;
+  int minArea = params.minArea > 0 ? params.minArea : (minDim / 60) * (minDim / 60);
+  if (minArea < 6) minArea = 6;
+  int maxArea = params.maxArea > 0 ? params.maxArea : (minDim / 8) * (minDim / 8);
+  const uint32_t keepPct = (uint32_t)(100 - params.thresholdPct);
+
+  // Integral image: integral[(y + 1) * iw + (x + 1)] = sum of px over [0..x] x [0..y].
+  memset(integral, 0, (size_t)iw * sizeof(uint32_t));
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* row = px + (size_t)y * rowStride;
+    uint32_t rowSum = 0;
+    uint32_t* dst = integral + (size_t)(y + 1) * iw;
+    const uint32_t* above = dst - iw;
+    dst[0] = 0;
+    for (int x = 0; x < width; ++x) {
+      rowSum += row[x * pixelStride];
+      dst[x + 1] = above[x + 1] + rowSum;
+    }
+  }
+
+  // Pass 1: adaptive threshold and provisional 8-connected labels.
+  int nextLabel = 1;
+  parent[0] = 0;
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* row = px + (size_t)y * rowStride;
+    const int y0 = y - radius < 0 ? 0 : y - radius;
+    const int y1 = y + radius + 1 > height ? height : y + radius + 1;
+    const uint32_t* top = integral + (size_t)y0 * iw;
+    const uint32_t* bot = integral + (size_t)y1 * iw;
+    uint16_t* lab = labels + (size_t)y * width;
+    const uint16_t* labUp = y > 0 ? lab - width : nullptr;
+    for (int x = 0; x < width; ++x) {
+      const int x0 = x - radius < 0 ? 0 : x - radius;
+      const int x1 = x + radius + 1 > width ? width : x + radius + 1;
+      const uint32_t count = (uint32_t)(x1 - x0) * (uint32_t)(y1 - y0);
+      const uint32_t sum = bot[x1] - bot[x0] - top[x1] + top[x0];
+      const uint32_t p = row[x * pixelStride];
+      // p < mean * keepPct / 100 and mean - p >= minContrast, without dividing.
+      const bool dark = p * count * 100 < sum * keepPct &&
+                        sum >= (p + (uint32_t)params.minContrast) * count;
+      if (!dark) {
+        lab[x] = 0;
+        continue;
+      }
+
+      uint16_t l = 0;
+      uint16_t neighbours[4] = {
+        x > 0 ? lab[x - 1] : (uint16_t)0,
+        (labUp && x > 0) ? labUp[x - 1] : (uint16_t)0,
+        labUp ? labUp[x] : (uint16_t)0,
+        (labUp && x + 1 < width) ? labUp[x + 1] : (uint16_t)0,
+      };
+      for (int i = 0; i < 4; ++i) {
+        if (!neighbours[i]) continue;
+        l = l ? unite(parent, l, neighbours[i]) : findRoot(parent, neighbours[i]);
+      }
+      if (!l) {
+        if (nextLabel >= kMaxLabels) return false;
+        l = (uint16_t)nextLabel++;
+        parent[l] = l;
+      }
+      lab[x] = l;
+    }
+  }
+
+  // Pass 2: resolve labels and gather per-component area, perimeter and bounds.
+  for (int i = 1; i < nextLabel; ++i) {
+    blobs[i] = {0, 0, 32767, -1, 32767, -1};
+  }
+  for (int y = 0; y < height; ++y) {
+    const uint16_t* lab = labels + (size_t)y * width;
+    for (int x = 0; x < width; ++x) {
+      if (!lab[x]) continue;
+      Blob& b = blobs[findRoot(parent, lab[x])];
+      b.area++;
+      const bool edge = x == 0 || y == 0 || x == width - 1 || y == height - 1 ||
+                        !lab[x - 1] || !lab[x + 1] || !lab[x - width] || !lab[x + width];
+      if (edge) b.perimeter++;
+      if (x < b.minX) b.minX = (int16_t)x;
+      if (x > b.maxX) b.maxX = (int16_t)x;
+      if (y < b.minY) b.minY = (int16_t)y;
+      if (y > b.maxY) b.maxY = (int16_t)y;
+    }
+  }
+
+  // Shape filters: area, bounding-box fill (a disc fills ~78%), aspect and circularity.
+  Candidate cands[kMaxCandidates];
+  int nc = 0;
+  for (int i = 1; i < nextLabel; ++i) {
+    if (parent[i] != i) continue;
+    const Blob& b = blobs[i];
+    if ((int)b.area < minArea || (int)b.area > maxArea || b.perimeter == 0) continue;
+    const int bw = b.maxX - b.minX + 1;
+    const int bh = b.maxY - b.minY + 1;
+    if (bw > 2 * bh || bh > 2 * bw) continue;
+    const int fillQ8 = (int)(b.area * 256 / (uint32_t)(bw * bh));
+    if (fillQ8 < 140 || fillQ8 > 236) continue;
+    int circQ8 = (int)(kFourPiQ8 * b.area / (b.perimeter * b.perimeter));
+    if (circQ8 < params.minCircularityQ8) continue;
+    if (circQ8 > 256) circQ8 = 256;
+    if (nc == kMaxCandidates) {
+      out.candidates = nc + 1;  // Too textured to be a clean die face
+      return true;
+    }
+    cands[nc++] = {(b.minX + b.maxX) / 2, (b.minY + b.maxY) / 2, (int)b.area, circQ8,
+                   b.minX, b.maxX, b.minY, b.maxY};
+  }
+  out.candidates = nc;
+  if (nc == 0) return true;
+
+  // Pips on one face are about the same size and within a few diameters of
+  // each other: keep the largest such group.
+  int bestSeed = -1;
+  int bestCount = 0;
+  for (int i = 0; i < nc; ++i) {
+    const int diam = isqrt(cands[i].area * 4 / 3) + 1;
+    const int reach = 5 * diam;
+    int count = 0;
+    for (int j = 0; j < nc; ++j) {
+      const int dx = cands[j].cx - cands[i].cx;
+      const int dy = cands[j].cy - cands[i].cy;
+      if (cands[j].area * 5 < cands[i].area * 3 || cands[j].area * 3 > cands[i].area * 5) continue;
+      if (dx * dx + dy * dy > reach * reach) continue;
+      ++count;
+    }
+    if (count > bestCount || (count == bestCount && bestSeed >= 0 && cands[i].area > cands[bestSeed].area)) {
+      bestCount = count;
+      bestSeed = i;
+    }
+  }
+
+  const Candidate& seed = cands[bestSeed];
+  const int diam = isqrt(seed.area * 4 / 3) + 1;
+  const int reach = 5 * diam;
+  int minX = 32767, maxX = -1, minY = 32767, maxY = -1;
+  int circSum = 0;
+  int minA = 0x7fffffff, maxA = 0;
+  for (int j = 0; j < nc; ++j) {
+    const Candidate& c = cands[j];
+    const int dx = c.cx - seed.cx;
+    const int dy = c.cy - seed.cy;
+    if (c.area * 5 < seed.area * 3 || c.area * 3 > seed.area * 5) continue;
+    if (dx * dx + dy * dy > reach * reach) continue;
+    circSum += c.circQ8;
+    if (c.area < minA) minA = c.area;
+    if (c.area > maxA) maxA = c.area;
+    if (c.minX < minX) minX = c.minX;
+    if (c.maxX > maxX) maxX = c.maxX;
+    if (c.minY < minY) minY = c.minY;
+    if (c.maxY > maxY) maxY = c.maxY;
+  }
+
+  out.pips = bestCount;
+  out.x = minX - diam < 0 ? 0 : minX - diam;
+  out.y = minY - diam < 0 ? 0 : minY - diam;
+  out.w = (maxX + diam >= width ? width - 1 : maxX + diam) - out.x + 1;
+  out.h = (maxY + diam >= height ? height - 1 : maxY + diam) - out.y + 1;
+
+  // Confidence: shape quality x size consistency, halved when stray blobs
+  // outnumber the pips, zero for counts a d6 cannot show.
+  if (bestCount < 1 || bestCount > 6) return true;
+  const int circQ8 = circSum / bestCount;
+  const int spreadQ8 = 256 - (maxA - minA) * 256 / (maxA + minA);
+  int conf = circQ8 * spreadQ8 / 256;
+  if (nc - bestCount > bestCount) conf /= 2;
+  out.confidenceQ8 = conf;
+  return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Classical d6 reader: counts dark pips on a light die in an 8-bit image.
+// Integer-only (adaptive threshold from an integral image, two-pass connected
+// component labelling, area/fill/circularity filters), no Arduino
+// dependencies, so it also builds on a host.
+
+struct PipParams {
+  int windowRadius;    // Half-size of the local-mean window, pixels (0 = derive from image size)
+  int thresholdPct;    // Pixel is "dark" when below local mean by this many percent
+  int minContrast;     // ...and by at least this many grey levels
+  int minArea;         // Pip area bounds, pixels (0 = derive from image size)
+  int maxArea;
+  int minCircularityQ8;  // 4*pi*A/P^2 in Q8 (256 = perfect disc)
+};
+
+struct PipResult {
+  int pips;            // Accepted pips (1..6 means a readable d6)
+  int candidates;      // Components that passed the shape filters before size clustering
+  int x, y, w, h;      // Box around the accepted pips
+  int confidenceQ8;    // 0..256
+};
+
+// Fills `params` with defaults suited to a QVGA-ish view of the tray.
+void pipParamsDefault(PipParams& params);
+
+// Scratch needed for a width x height image.
+size_t pipScratchBytes(int width, int height);
+
+// Reads one channel of an interleaved image: pixel (x, y) is
+// px[y * rowStride + x * pixelStride]. Use pixelStride 1 for grayscale and 3
+// (with px offset to the G byte) for RGB888. Returns false if the scratch is
+// too small or the component table overflowed.
+bool pipCount(const uint8_t* px, int width, int height, int pixelStride, int rowStride,
+              const PipParams& params, void* scratch, size_t scratchBytes, PipResult& out);
@@ -0,0 +1,134 @@
+#include "roll_settle.h"
+#include "esp_heap_caps.h"
+#include "jpeg_mcu.h"
+#include "camera_mode.h"
+
+static const uint32_t kTaskStack = 8192;  // The settled callback runs detection (HTTPClient) on this stack
+
+static RollSettleConfig gConfig = {false, 100, 6, 4, 3};  // Off until POST /dice/auto enables it
+static RollSettleStats gStats = {};
+static RollSettledFn gOnSettled = nullptr;
+static JpegCodec* gCodec = nullptr;
+static uint8_t* gThumb[2] = {nullptr, nullptr};
+static size_t gThumbCap = 0;
+static TaskHandle_t gTask = nullptr;
+static portMUX_TYPE gSettleMux = portMUX_INITIALIZER_UNLOCKED;
+
+static int countChangedBlocks(const uint8_t* a, const uint8_t* b, int n, int delta) {
+  int changed = 0;
+  for (int i = 0; i < n; ++i) {
+    int d = (int)a[i] - (int)b[i];
+    if (d > delta || d < -delta) ++changed;
+  }
+  return changed;
+}
+
+static void settleTask(void*) {
+  int cur = 0;
+  int prevW = 0;
+  int prevH = 0;
+  int stable = 0;
+  RollSettlePhase phase = ROLL_SETTLE_IDLE;
+
+  for (;;) {
+    RollSettleConfig cfg;
+    rollSettleGetConfig(cfg);
+    if (!cfg.enabled) {
+      prevW = prevH = 0;
+      phase = ROLL_SETTLE_IDLE;
+      ulTaskNotifyTake(pdTRUE, 500 / portTICK_PERIOD_MS);
+      continue;
+    }
+
+    camera_fb_t* fb = cameraFrameGet();
+    if (!fb) {
+      vTaskDelay(cfg.periodMs / portTICK_PERIOD_MS);
+      continue;
+    }
+
+    int w = 0;
+    int h = 0;
+    if (fb->format != PIXFORMAT_JPEG ||
+        !jpegLumaThumbnail(gCodec, fb->buf, fb->len, gThumb[cur], gThumbCap, &w, &h)) {
+      cameraFrameReturn(fb);
+      vTaskDelay(cfg.periodMs / portTICK_PERIOD_MS);
+      continue;
+    }
+
+    // A frame-size switch reads as motion; the next frames re-establish stillness.
+    int changed = (w == prevW && h == prevH)
+                    ? countChangedBlocks(gThumb[cur], gThumb[cur ^ 1], w * h, cfg.motionDelta)
+                    : w * h;
+    bool firstFrame = prevW == 0;
+    prevW = w;
+    prevH = h;
+    cur ^= 1;
+
+    uint32_t now = millis();
+    bool settled = false;
+    if (firstFrame) {
+      // Nothing to compare against yet.
+    } else if (changed >= cfg.motionBlocks) {
+      phase = ROLL_SETTLE_MOVING;
+      stable = 0;
+    } else if (phase == ROLL_SETTLE_MOVING && ++stable >= cfg.stableFrames) {
+      phase = ROLL_SETTLE_IDLE;
+      settled = true;
+    }
+
+    portENTER_CRITICAL(&gSettleMux);
+    gStats.phase = phase;
+    gStats.frames++;
+    gStats.changedBlocks = changed;
+    if (phase == ROLL_SETTLE_MOVING && stable == 0) gStats.lastMotionMs = now;
+    if (settled) {
+      gStats.settles++;
+      gStats.lastSettleMs = now;
+    }
+    portEXIT_CRITICAL(&gSettleMux);
+
+    if (settled && gOnSettled) {
+      gOnSettled(fb);
+    } else {
+      cameraFrameReturn(fb);
+    }
+    vTaskDelay(cfg.periodMs / portTICK_PERIOD_MS);
+  }
+}
+
+bool rollSettleBegin(int maxWidth, int maxHeight, RollSettledFn onSettled) {
+  gOnSettled = onSettled;
+  if (!gCodec) gCodec = jpegCodecCreate();
+  gThumbCap = (size_t)((maxWidth + 7) / 8) * ((maxHeight + 7) / 8);
+  for (int i = 0; i < 2; ++i) {
+    if (!gThumb[i]) gThumb[i] = (uint8_t*)heap_caps_malloc(gThumbCap, MALLOC_CAP_8BIT);
+  }
+  if (!gCodec || !gThumb[0] || !gThumb[1]) return false;
+  if (!gTask) {
+    xTaskCreatePinnedToCore(settleTask, "roll_settle", kTaskStack, nullptr, 3, &gTask, tskNO_AFFINITY);
+  }
+  return gTask != nullptr;
+}
+
+void rollSettleConfigure(const RollSettleConfig& config) {
+  portENTER_CRITICAL(&gSettleMux);
+  gConfig = config;
+  if (gConfig.periodMs < 10) gConfig.periodMs = 10;
+  if (gConfig.motionDelta < 1) gConfig.motionDelta = 1;
+  if (gConfig.motionBlocks < 1) gConfig.motionBlocks = 1;
+  if (gConfig.stableFrames < 1) gConfig.stableFrames = 1;
+  portEXIT_CRITICAL(&gSettleMux);
+  if (gTask) xTaskNotifyGive(gTask);
+}
+
+void rollSettleGetConfig(RollSettleConfig& out) {
+  portENTER_CRITICAL(&gSettleMux);
+  out = gConfig;
+  portEXIT_CRITICAL(&gSettleMux);
+}
+
+void rollSettleGetStats(RollSettleStats& out) {
+  portENTER_CRITICAL(&gSettleMux);
+  out = gStats;
+  portEXIT_CRITICAL(&gSettleMux);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <Arduino.h>
+#include "esp_camera.h"
+
+// Background watcher that notices a die coming to rest. It samples the camera
+// at a low rate, compares 1/8-scale luma thumbnails (JPEG DC terms, no full
+// decode) between consecutive frames, and once motion has been followed by
+// `stableFrames` still frames it hands the last frame to the settled callback.
+
+struct RollSettleConfig {
+  bool enabled;
+  int periodMs;      // Pause between sampled frames
+  int motionDelta;   // Luma change (0..255) that marks one 8x8 block as moving
+  int motionBlocks;  // Moving blocks needed to call the frame "in motion"
+  int stableFrames;  // Consecutive still frames after motion that count as settled
+};
+
+enum RollSettlePhase {
+  ROLL_SETTLE_IDLE = 0,    // Waiting for motion
+  ROLL_SETTLE_MOVING = 1,  // Motion seen, counting still frames
+};
+
+struct RollSettleStats {
+  RollSettlePhase phase;
+  uint32_t frames;         // Frames sampled
+  uint32_t settles;        // Times the callback fired
+  int changedBlocks;       // Moving blocks in the last sampled frame
+  uint32_t lastMotionMs;   // millis() of the last frame in motion
+  uint32_t lastSettleMs;   // millis() when the callback last fired
+};
+
+// Runs on the watcher task and takes the frame over: it must hand fb back with
+// cameraFrameReturn(), before any slow work, so the stream keeps its driver
+// buffers and frame-size switches can drain the camera.
+typedef void (*RollSettledFn)(camera_fb_t* fb);
+
+// Allocates thumbnail buffers for frames up to maxWidth x maxHeight and starts the task.
+bool rollSettleBegin(int maxWidth, int maxHeight, RollSettledFn onSettled);
+
+void rollSettleConfigure(const RollSettleConfig& config);
+void rollSettleGetConfig(RollSettleConfig& out);
+void rollSettleGetStats(RollSettleStats& out);
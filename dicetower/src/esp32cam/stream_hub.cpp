@@ -0,0 +1,386 @@
+#include "stream_hub.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "frame_pool.h"
+#include "camera_mode.h"
+
+static const int kRingSlots = kStreamHubMaxSubscribers + 1;  // The producer always finds a free slot
+static const uint32_t kSubscriberStack = 4096;
+static const uint32_t kCaptureStack = 8192;  // Room for the JPEG encoder when rendering overlays
+static const char* kStreamBoundary = "--frame";
+static const char* kStreamResponseHead =
+  "HTTP/1.1 200 OK\r\n"
+  "Content-Type: multipart/x-mixed-replace; boundary=frame\r\n"
+  "Cache-Control: no-cache\r\n"
+  "Access-Control-Allow-Origin: *\r\n"
+  "Connection: close\r\n"
+  "\r\n";
+
+struct RingSlot {
+  uint8_t* buf;
+  size_t cap;
+  size_t len;
+  uint32_t seq;
+  int64_t captureUs;  // fb->timestamp (esp_timer clock, us since boot)
+  int64_t dequeueUs;  // When the capture task got the buffer from the driver
+  uint8_t refs;  // Subscribers currently sending this slot
+};
+
+struct Subscriber {
+  bool active;
+  volatile bool stopRequested;
+  volatile bool closed;  // Set when esp_http_server drops the session under us
+  uint32_t id;
+  int fd;
+  TaskHandle_t task;
+  uint32_t startMs;
+  uint32_t frames;
+  uint64_t bytes;
+  uint64_t sendUs;
+  uint32_t dropped;
+  char peer[16];
+};
+
+static httpd_handle_t gServer = nullptr;
+static StreamRenderFn gRender = nullptr;
+static StreamRateApplyFn gRateApply = nullptr;
+static StreamIdleFn gIdle = nullptr;
+static RingSlot gRing[kRingSlots] = {};
+static int gNewest = -1;
+static uint32_t gSeq = 0;
+static Subscriber gSubs[kStreamHubMaxSubscribers] = {};
+static uint32_t gNextSubId = 1;
+static volatile int gFrameDelayMs = 1;
+static StreamHubStats gStats = {};
+static TaskHandle_t gCaptureTask = nullptr;
+static portMUX_TYPE gHubMux = portMUX_INITIALIZER_UNLOCKED;
+
+static int activeSubscribers() {
+  int n = 0;
+  for (int i = 0; i < kStreamHubMaxSubscribers; ++i) {
+    if (gSubs[i].active) ++n;
+  }
+  return n;
+}
+
+// Picks a slot that nobody is reading and that is not the newest frame.
+static int claimWriteSlot() {
+  int idx = -1;
+  portENTER_CRITICAL(&gHubMux);
+  for (int i = 0; i < kRingSlots; ++i) {
+    if (i != gNewest && gRing[i].refs == 0 && gRing[i].buf) {
+      idx = i;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&gHubMux);
+  return idx;
+}
+
+static void publishSlot(int idx) {
+  portENTER_CRITICAL(&gHubMux);
+  gRing[idx].seq = ++gSeq;
+  gNewest = idx;
+  gStats.published++;
+  for (int i = 0; i < kStreamHubMaxSubscribers; ++i) {
+    if (gSubs[i].active && gSubs[i].task) xTaskNotifyGive(gSubs[i].task);
+  }
+  portEXIT_CRITICAL(&gHubMux);
+}
+
+// Pins the newest slot if it is newer than `cursor`; returns -1 otherwise.
+static int acquireNewest(uint32_t cursor) {
+  int idx = -1;
+  portENTER_CRITICAL(&gHubMux);
+  if (gNewest >= 0 && gRing[gNewest].seq > cursor) {
+    idx = gNewest;
+    gRing[idx].refs++;
+  }
+  portEXIT_CRITICAL(&gHubMux);
+  return idx;
+}
+
+static void releaseSlot(int idx) {
+  portENTER_CRITICAL(&gHubMux);
+  gRing[idx].refs--;
+  portEXIT_CRITICAL(&gHubMux);
+}
+
+static void captureTask(void*) {
+  bool streaming = false;
+  for (;;) {
+    if (activeSubscribers() == 0) {
+      if (streaming && gIdle) gIdle();
+      streaming = false;
+      // Idle until a viewer subscribes.
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+    streaming = true;
+
+    camera_fb_t* fb = cameraFrameGet();
+    int64_t dequeueUs = esp_timer_get_time();
+    if (!fb) {
+      gStats.captureFailed++;
+      vTaskDelay(10 / portTICK_PERIOD_MS);
+      continue;
+    }
+    gStats.captured++;
+
+    int idx = claimWriteSlot();
+    if (idx < 0) {
+      gStats.droppedNoSlot++;
+    } else {
+      RingSlot& slot = gRing[idx];
+      size_t len = 0;
+      bool rendered = gRender && fb->format == PIXFORMAT_JPEG && gRender(fb, slot.buf, slot.cap, &len);
+      if (!rendered && fb->len <= slot.cap) {
+        memcpy(slot.buf, fb->buf, fb->len);
+        len = fb->len;
+      }
+      if (len > 0) {
+        slot.len = len;
+        slot.captureUs = (int64_t)fb->timestamp.tv_sec * 1000000LL + fb->timestamp.tv_usec;
+        slot.dequeueUs = dequeueUs;
+        publishSlot(idx);
+      } else {
+        gStats.droppedNoSlot++;
+      }
+    }
+    cameraFrameReturn(fb);
+
+    StreamRateState rate;
+    if (streamRateUpdate(millis(), activeSubscribers(), rate)) {
+      gFrameDelayMs = rate.frameDelayMs;
+      if (gRateApply) gRateApply(rate);
+    }
+
+    int delayMs = gFrameDelayMs;
+    if (delayMs > 0) {
+      vTaskDelay(delayMs / portTICK_PERIOD_MS);
+    } else {
+      taskYIELD();
+    }
+  }
+}
+
+static bool sendAll(int fd, const char* data, size_t len) {
+  while (len > 0) {
+    int n = httpd_socket_send(gServer, fd, data, len, 0);
+    if (n <= 0) return false;
+    data += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+static void subscriberTask(void* arg) {
+  Subscriber* sub = (Subscriber*)arg;
+  uint32_t cursor = gSeq;
+  uint32_t prevSeq = 0;
+  int64_t prevDoneUs = 0;
+  bool ok = sendAll(sub->fd, kStreamResponseHead, strlen(kStreamResponseHead));
+
+  while (ok && !sub->stopRequested && !sub->closed) {
+    // Woken by publishSlot; the timeout only bounds how long a stop can go unnoticed.
+    ulTaskNotifyTake(pdTRUE, 500 / portTICK_PERIOD_MS);
+    int idx = acquireNewest(cursor);
+    if (idx < 0) continue;
+    const RingSlot& slot = gRing[idx];
+    uint32_t skipped = slot.seq - cursor - 1;
+    cursor = slot.seq;
+
+    // The CRLF that terminates the previous part is the prefix of this header.
+    // All times share the esp_timer clock. A part's own send-finished time is
+    // only known after its header is out, so it rides on the next part.
+    char partHeader[320];
+    int headerLen = snprintf(partHeader, sizeof(partHeader),
+                             "\r\n%s\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n"
+                             "X-Frame-Seq: %u\r\n"
+                             "X-Timestamp: %ld.%06ld\r\n"
+                             "X-Dequeue-Us: %lld\r\n"
+                             "X-Prev-Seq: %u\r\n"
+                             "X-Prev-Send-Done-Us: %lld\r\n\r\n",
+                             kStreamBoundary, (unsigned)slot.len, (unsigned)slot.seq,
+                             (long)(slot.captureUs / 1000000), (long)(slot.captureUs % 1000000),
+                             (long long)slot.dequeueUs, (unsigned)prevSeq, (long long)prevDoneUs);
+    uint32_t sendStart = micros();
+    ok = sendAll(sub->fd, partHeader, headerLen) &&
+         sendAll(sub->fd, (const char*)slot.buf, slot.len);
+    uint32_t sendUs = micros() - sendStart;
+    size_t sent = headerLen + slot.len;
+    prevSeq = slot.seq;
+    prevDoneUs = esp_timer_get_time();
+    releaseSlot(idx);
+    if (!ok) break;
+    streamRateRecordSend(sent, sendUs);
+    portENTER_CRITICAL(&gHubMux);
+    sub->frames++;
+    sub->bytes += sent;
+    sub->sendUs += sendUs;
+    sub->dropped += skipped;
+    portEXIT_CRITICAL(&gHubMux);
+  }
+
+  if (!sub->closed) {
+    httpd_sess_trigger_close(gServer, sub->fd);
+  }
+  portENTER_CRITICAL(&gHubMux);
+  sub->active = false;
+  sub->task = nullptr;
+  portEXIT_CRITICAL(&gHubMux);
+  vTaskDelete(nullptr);
+}
+
+// esp_http_server frees the session context when it closes the socket; the
+// context is the subscriber id, so a recycled table entry is never confused
+// with the connection it replaced.
+static void onSessionClosed(void* ctx) {
+  uint32_t id = (uint32_t)(uintptr_t)ctx;
+  portENTER_CRITICAL(&gHubMux);
+  for (int i = 0; i < kStreamHubMaxSubscribers; ++i) {
+    if (gSubs[i].active && gSubs[i].id == id) gSubs[i].closed = true;
+  }
+  portEXIT_CRITICAL(&gHubMux);
+}
+
+static void readPeer(int fd, char* out, size_t outLen) {
+  struct sockaddr_in6 addr;
+  socklen_t addrLen = sizeof(addr);
+  if (getpeername(fd, (struct sockaddr*)&addr, &addrLen) != 0) return;
+  if (addr.sin6_family == AF_INET) {
+    inet_ntop(AF_INET, &((struct sockaddr_in*)&addr)->sin_addr, out, outLen);
+  } else if (addr.sin6_family == AF_INET6) {
+    // esp_http_server listens on IPv6; IPv4 peers arrive as v4-mapped addresses.
+    inet_ntop(AF_INET, &addr.sin6_addr.s6_addr[12], out, outLen);
+  }
+}
+
+bool streamHubBegin(httpd_handle_t server, StreamRenderFn render) {
+  gServer = server;
+  gRender = render;
+  for (int i = 0; i < kRingSlots; ++i) {
+    if (!gRing[i].buf) {
+      gRing[i].buf = framePoolAcquire(FRAME_POOL_JPEG, 1);
+      gRing[i].cap = gRing[i].buf ? framePoolSlotBytes(FRAME_POOL_JPEG) : 0;
+    }
+    if (!gRing[i].buf) return false;
+  }
+  if (!gCaptureTask) {
+    xTaskCreatePinnedToCore(captureTask, "stream_capture", kCaptureStack, nullptr, 5, &gCaptureTask, tskNO_AFFINITY);
+  }
+  return gCaptureTask != nullptr;
+}
+
+bool streamHubSubscribe(httpd_req_t* req) {
+  if (!gCaptureTask) return false;
+  int fd = httpd_req_to_sockfd(req);
+  char peer[16] = "";
+  readPeer(fd, peer, sizeof(peer));
+  Subscriber* sub = nullptr;
+  portENTER_CRITICAL(&gHubMux);
+  for (int i = 0; i < kStreamHubMaxSubscribers; ++i) {
+    if (!gSubs[i].active) {
+      sub = &gSubs[i];
+      sub->active = true;
+      sub->stopRequested = false;
+      sub->closed = false;
+      sub->id = gNextSubId++;
+      sub->fd = fd;
+      sub->task = nullptr;
+      sub->startMs = millis();
+      sub->frames = 0;
+      sub->bytes = 0;
+      sub->sendUs = 0;
+      sub->dropped = 0;
+      memcpy(sub->peer, peer, sizeof(sub->peer));
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&gHubMux);
+  if (!sub) return false;
+
+  req->sess_ctx = (void*)(uintptr_t)sub->id;
+  req->free_ctx = onSessionClosed;
+
+  TaskHandle_t task = nullptr;
+  if (xTaskCreatePinnedToCore(subscriberTask, "stream_sub", kSubscriberStack, sub, 5, &task, tskNO_AFFINITY) != pdPASS) {
+    req->sess_ctx = nullptr;
+    req->free_ctx = nullptr;
+    sub->active = false;
+    return false;
+  }
+  portENTER_CRITICAL(&gHubMux);
+  if (sub->active) sub->task = task;
+  portEXIT_CRITICAL(&gHubMux);
+  xTaskNotifyGive(gCaptureTask);
+  return true;
+}
+
+void streamHubStopAll() {
+  portENTER_CRITICAL(&gHubMux);
+  for (int i = 0; i < kStreamHubMaxSubscribers; ++i) {
+    if (gSubs[i].active) gSubs[i].stopRequested = true;
+  }
+  portEXIT_CRITICAL(&gHubMux);
+}
+
+bool streamHubStop(uint32_t id) {
+  bool found = false;
+  portENTER_CRITICAL(&gHubMux);
+  for (int i = 0; i < kStreamHubMaxSubscribers; ++i) {
+    if (gSubs[i].active && gSubs[i].id == id) {
+      gSubs[i].stopRequested = true;
+      found = true;
+    }
+  }
+  portEXIT_CRITICAL(&gHubMux);
+  return found;
+}
+
+int streamHubListSessions(StreamSessionInfo* out, int max) {
+  int n = 0;
+  uint32_t now = millis();
+  portENTER_CRITICAL(&gHubMux);
+  for (int i = 0; i < kStreamHubMaxSubscribers && n < max; ++i) {
+    const Subscriber& sub = gSubs[i];
+    if (!sub.active) continue;
+    StreamSessionInfo& info = out[n++];
+    info.id = sub.id;
+    info.connectedMs = now - sub.startMs;
+    info.frames = sub.frames;
+    info.bytes = sub.bytes;
+    info.avgSendMs = sub.frames ? (float)sub.sendUs / 1000.0f / (float)sub.frames : 0.0f;
+    info.dropped = sub.dropped;
+    memcpy(info.peer, sub.peer, sizeof(info.peer));
+  }
+  portEXIT_CRITICAL(&gHubMux);
+  return n;
+}
+
+void streamHubFlush() {
+  portENTER_CRITICAL(&gHubMux);
+  gNewest = -1;
+  portEXIT_CRITICAL(&gHubMux);
+}
+
+void streamHubSetFrameDelay(int ms) {
+  gFrameDelayMs = ms;
+}
+
+void streamHubSetRateHook(StreamRateApplyFn apply) {
+  gRateApply = apply;
+}
+
+void streamHubSetIdleHook(StreamIdleFn idle) {
+  gIdle = idle;
+}
+
+void streamHubGetStats(StreamHubStats& out) {
+  portENTER_CRITICAL(&gHubMux);
+  out = gStats;
+  out.subscribers = (uint8_t)activeSubscribers();
+  portEXIT_CRITICAL(&gHubMux);
+}
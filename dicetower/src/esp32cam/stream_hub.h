@@ -0,0 +1,75 @@
+#pragma once
+#include <Arduino.h>
+#include "esp_camera.h"
+#include "esp_http_server.h"
+#include "stream_rate.h"
+
+// Single-producer, multi-subscriber MJPEG fan-out for the port 81 server.
+// One capture task publishes frames into a small ring; every connected viewer
+// gets its own sender task with a cursor that always jumps to the newest frame,
+// so N viewers cost one capture.
+
+// Optional per-frame transform (e.g. overlay). Writes a JPEG of at most `cap`
+// bytes into `dst` and returns true, or returns false to publish fb as-is.
+typedef bool (*StreamRenderFn)(camera_fb_t* fb, uint8_t* dst, size_t cap, size_t* outLen);
+
+// Receives sensor-side rate decisions (quality, frame size). Runs on the
+// capture task between frames; the hub itself applies the frame delay.
+typedef void (*StreamRateApplyFn)(const StreamRateState& state);
+
+static const int kStreamHubMaxSubscribers = 3;
+
+// Called on the capture task when the last viewer has gone, before it idles.
+typedef void (*StreamIdleFn)();
+
+struct StreamHubStats {
+  uint32_t captured;      // Frames taken from the sensor
+  uint32_t published;     // Frames made visible to subscribers
+  uint32_t droppedNoSlot; // Captures discarded because every ring slot was pinned
+  uint32_t captureFailed; // esp_camera_fb_get returned nullptr
+  uint8_t subscribers;
+};
+
+// One connected viewer, as listed by /camera/stream/sessions.
+struct StreamSessionInfo {
+  uint32_t id;
+  uint32_t connectedMs;   // Time since the viewer subscribed
+  uint32_t frames;        // Parts fully sent
+  uint64_t bytes;         // Header + payload bytes sent
+  float avgSendMs;        // Mean time to push one part through the socket
+  uint32_t dropped;       // Published frames this viewer skipped because it was still sending
+  char peer[16];          // Remote IPv4 address, or "" if unknown
+};
+
+// Leases the ring from the frame pool and starts the capture task.
+bool streamHubBegin(httpd_handle_t server, StreamRenderFn render);
+
+// Takes over the connection behind `req`: the response is written by a
+// dedicated sender task, so the handler must return right after this call.
+// Returns false when the viewer limit is reached or no task could be started.
+bool streamHubSubscribe(httpd_req_t* req);
+
+// Ends every currently connected stream. Viewers that connect later are unaffected.
+void streamHubStopAll();
+
+// Ends one stream by session id. Returns false if no such session is connected.
+bool streamHubStop(uint32_t id);
+
+// Copies up to `max` connected sessions into `out`; returns how many were written.
+int streamHubListSessions(StreamSessionInfo* out, int max);
+
+// Forgets the newest frame so viewers wait for the next capture (used by
+// camera_mode after a frame-size switch). Parts already being sent finish.
+void streamHubFlush();
+
+// Minimum pause between captures (the old per-stream latency knob).
+void streamHubSetFrameDelay(int ms);
+
+void streamHubSetRateHook(StreamRateApplyFn apply);
+
+// Lets the owner undo rate decisions (raised quality, a frame-size
+// downshift) once nobody is watching, so snapshots and detection captures
+// run at the manual settings.
+void streamHubSetIdleHook(StreamIdleFn idle);
+
+void streamHubGetStats(StreamHubStats& out);
@@ -0,0 +1,130 @@
+#include "stream_rate.h"
+
+static const uint32_t kWindowMs = 1000;
+static const int kMaxFrameDelayMs = 100;
+
+static StreamRateConfig gConfig = {false, 15, 10, 40, 0};
+static StreamRateState gState = {12, 1, 0, 0.0f, 0.0f, 0.0f};
+static uint32_t gWindowStart = 0;
+static uint32_t gFrames = 0;
+static uint64_t gSendUs = 0;
+static uint64_t gBytes = 0;
+static portMUX_TYPE gRateMux = portMUX_INITIALIZER_UNLOCKED;
+
+static int clampInt(int v, int lo, int hi) {
+  return v < lo ? lo : (v > hi ? hi : v);
+}
+
+void streamRateReset(int quality, int frameDelayMs) {
+  portENTER_CRITICAL(&gRateMux);
+  gState.quality = quality;
+  gState.frameDelayMs = frameDelayMs;
+  gState.downshift = 0;
+  gFrames = 0;
+  gSendUs = 0;
+  gBytes = 0;
+  gWindowStart = 0;
+  portEXIT_CRITICAL(&gRateMux);
+}
+
+void streamRateConfigure(const StreamRateConfig& config) {
+  portENTER_CRITICAL(&gRateMux);
+  gConfig = config;
+  gConfig.targetFps = clampInt(config.targetFps, 1, 30);
+  gConfig.minQuality = clampInt(config.minQuality, 4, 63);
+  gConfig.maxQuality = clampInt(config.maxQuality, gConfig.minQuality, 63);
+  gConfig.maxDownshift = clampInt(config.maxDownshift, 0, 4);
+  gState.quality = clampInt(gState.quality, gConfig.minQuality, gConfig.maxQuality);
+  if (gState.downshift > gConfig.maxDownshift) gState.downshift = gConfig.maxDownshift;
+  portEXIT_CRITICAL(&gRateMux);
+}
+
+void streamRateGetConfig(StreamRateConfig& out) {
+  portENTER_CRITICAL(&gRateMux);
+  out = gConfig;
+  portEXIT_CRITICAL(&gRateMux);
+}
+
+void streamRateRecordSend(size_t bytes, uint32_t sendUs) {
+  portENTER_CRITICAL(&gRateMux);
+  gFrames++;
+  gSendUs += sendUs;
+  gBytes += bytes;
+  portEXIT_CRITICAL(&gRateMux);
+}
+
+bool streamRateUpdate(uint32_t nowMs, int viewers, StreamRateState& out) {
+  portENTER_CRITICAL(&gRateMux);
+  if (gWindowStart == 0) gWindowStart = nowMs;
+  uint32_t elapsed = nowMs - gWindowStart;
+  if (elapsed < kWindowMs) {
+    out = gState;
+    portEXIT_CRITICAL(&gRateMux);
+    return false;
+  }
+  uint32_t frames = gFrames;
+  uint64_t sendUs = gSendUs;
+  uint64_t bytes = gBytes;
+  gFrames = 0;
+  gSendUs = 0;
+  gBytes = 0;
+  gWindowStart = nowMs;
+
+  if (viewers <= 0 || frames == 0) {
+    gState.fps = 0.0f;
+    gState.sendMs = 0.0f;
+    gState.kbps = 0.0f;
+    out = gState;
+    portEXIT_CRITICAL(&gRateMux);
+    return false;
+  }
+
+  gState.fps = (float)frames * 1000.0f / (float)viewers / (float)elapsed;
+  gState.sendMs = (float)sendUs / 1000.0f / (float)frames;
+  gState.kbps = (float)bytes * 8.0f / (float)viewers / (float)elapsed;
+
+  bool changed = false;
+  if (gConfig.enabled) {
+    const float target = (float)gConfig.targetFps;
+    const float budgetMs = 1000.0f / target;
+    StreamRateState next = gState;
+
+    if (gState.fps < target * 0.9f) {
+      // Behind: first stop pausing, then shrink frames if the link is the bottleneck.
+      if (next.frameDelayMs > 0) {
+        next.frameDelayMs /= 2;
+      } else if (gState.sendMs > budgetMs * 0.7f) {
+        if (next.quality < gConfig.maxQuality) {
+          next.quality = clampInt(next.quality + 3, gConfig.minQuality, gConfig.maxQuality);
+        } else if (next.downshift < gConfig.maxDownshift) {
+          next.downshift++;
+        }
+      }
+      // Otherwise capture-bound: nothing here would help.
+    } else if (gState.fps > target * 1.15f) {
+      // Ahead: spend the surplus as a pause instead of airtime.
+      int surplusMs = (int)(budgetMs - 1000.0f / gState.fps);
+      next.frameDelayMs = clampInt(next.frameDelayMs + (surplusMs > 2 ? surplusMs / 2 : 1), 0, kMaxFrameDelayMs);
+    } else if (gState.sendMs < budgetMs * 0.4f) {
+      // On target with headroom: buy back resolution first, then quality.
+      if (next.downshift > 0 && gState.sendMs < budgetMs * 0.2f) {
+        next.downshift--;
+      } else if (next.quality > gConfig.minQuality) {
+        next.quality--;
+      }
+    }
+
+    changed = next.quality != gState.quality || next.frameDelayMs != gState.frameDelayMs ||
+              next.downshift != gState.downshift;
+    gState = next;
+  }
+  out = gState;
+  portEXIT_CRITICAL(&gRateMux);
+  return changed;
+}
+
+void streamRateGetState(StreamRateState& out) {
+  portENTER_CRITICAL(&gRateMux);
+  out = gState;
+  portEXIT_CRITICAL(&gRateMux);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <Arduino.h>
+
+// Closed-loop rate control for the MJPEG stream. Sender tasks report how long
+// each frame took to push through the socket; once per window the controller
+// trades JPEG quality, inter-frame delay and (optionally) frame size to hold
+// the slowest viewer at the target frame rate.
+
+struct StreamRateConfig {
+  bool enabled;
+  int targetFps;       // 1..30
+  int minQuality;      // Best quality the controller may pick (OV2640: lower = better)
+  int maxQuality;      // Worst quality before it starts dropping frame size
+  int maxDownshift;    // Frame-size steps it may drop below the configured size (0 = never)
+};
+
+struct StreamRateState {
+  int quality;         // Current sensor jpeg_quality
+  int frameDelayMs;    // Current pause between captures
+  int downshift;       // Frame-size steps below the configured size
+  float fps;           // Delivered frames per second per viewer (last window)
+  float sendMs;        // Average time to send one frame (last window)
+  float kbps;          // Average per-viewer throughput (last window)
+};
+
+// Sets the starting point (e.g. after a manual settings change) and clears history.
+void streamRateReset(int quality, int frameDelayMs);
+
+void streamRateConfigure(const StreamRateConfig& config);
+void streamRateGetConfig(StreamRateConfig& out);
+
+// Called by sender tasks after each frame.
+void streamRateRecordSend(size_t bytes, uint32_t sendUs);
+
+// Called by the capture task between frames. Returns true when quality, delay
+// or downshift changed and should be applied before the next capture.
+bool streamRateUpdate(uint32_t nowMs, int viewers, StreamRateState& out);
+
+void streamRateGetState(StreamRateState& out);
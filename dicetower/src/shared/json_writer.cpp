@@ -0,0 +1,191 @@
+#include "json_writer.h"
+
+JsonWriter::JsonWriter(char* b, size_t c) : buf(b), cap(c), len(0), overflow(!b || c == 0), depth(0), hasItems(0) {
+  if (!overflow) buf[0] = '\0';
+}
+
+void JsonWriter::put(char c) {
+  if (overflow) return;
+  if (len + 1 >= cap) {
+    overflow = true;
+    return;
+  }
+  buf[len++] = c;
+  buf[len] = '\0';
+}
+
+void JsonWriter::putRaw(const char* s) {
+  while (*s && !overflow) put(*s++);
+}
+
+void JsonWriter::putString(const char* s) {
+  static const char kHex[] = "0123456789abcdef";
+  put('"');
+  for (; *s && !overflow; ++s) {
+    unsigned char c = (unsigned char)*s;
+    switch (c) {
+      case '"': putRaw("\\\""); break;
+      case '\\': putRaw("\\\\"); break;
+      case '\b': putRaw("\\b"); break;
+      case '\f': putRaw("\\f"); break;
+      case '\n': putRaw("\\n"); break;
+      case '\r': putRaw("\\r"); break;
+      case '\t': putRaw("\\t"); break;
+      default:
+        if (c < 0x20) {
+          putRaw("\\u00");
+          put(kHex[c >> 4]);
+          put(kHex[c & 0xF]);
+        } else {
+          put((char)c);
+        }
+    }
+  }
+  put('"');
+}
+
+void JsonWriter::putUnsigned(unsigned long long v) {
+  char digits[20];
+  int n = 0;
+  do {
+    digits[n++] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v);
+  while (n) put(digits[--n]);
+}
+
+void JsonWriter::putSigned(long long v) {
+  if (v < 0) {
+    put('-');
+    putUnsigned(0ULL - (unsigned long long)v);
+  } else {
+    putUnsigned((unsigned long long)v);
+  }
+}
+
+// Comma and key for the next value at the current level.
+void JsonWriter::beginValue(const char* key) {
+  uint16_t bit = (uint16_t)(1u << depth);
+  if (hasItems & bit) put(',');
+  hasItems |= bit;
+  if (key) {
+    putString(key);
+    put(':');
+  }
+}
+
+void JsonWriter::open(const char* key, char c) {
+  beginValue(key);
+  put(c);
+  if (depth + 1 >= kMaxDepth) {
+    overflow = true;
+    return;
+  }
+  depth++;
+  hasItems &= (uint16_t)~(1u << depth);
+}
+
+void JsonWriter::close(char c) {
+  if (depth > 0) depth--;
+  put(c);
+}
+
+JsonWriter& JsonWriter::beginObject(const char* key) {
+  open(key, '{');
+  return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+  close('}');
+  return *this;
+}
+
+JsonWriter& JsonWriter::beginArray(const char* key) {
+  open(key, '[');
+  return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+  close(']');
+  return *this;
+}
+
+JsonWriter& JsonWriter::add(const char* key, const char* value) {
+  beginValue(key);
+  if (value) {
+    putString(value);
+  } else {
+    putRaw("null");
+  }
+  return *this;
+}
+
+JsonWriter& JsonWriter::add(const char* key, bool value) {
+  beginValue(key);
+  putRaw(value ? "true" : "false");
+  return *this;
+}
+
+JsonWriter& JsonWriter::add(const char* key, int value) {
+  return add(key, (long long)value);
+}
+
+JsonWriter& JsonWriter::add(const char* key, unsigned value) {
+  return add(key, (unsigned long long)value);
+}
+
+JsonWriter& JsonWriter::add(const char* key, long value) {
+  return add(key, (long long)value);
+}
+
+JsonWriter& JsonWriter::add(const char* key, unsigned long value) {
+  return add(key, (unsigned long long)value);
+}
+
+JsonWriter& JsonWriter::add(const char* key, long long value) {
+  beginValue(key);
+  putSigned(value);
+  return *this;
+}
+
+JsonWriter& JsonWriter::add(const char* key, unsigned long long value) {
+  beginValue(key);
+  putUnsigned(value);
+  return *this;
+}
+
+JsonWriter& JsonWriter::add(const char* key, double value, int decimals) {
+  beginValue(key);
+  // NaN compares unequal to itself; anything past int64 range is not worth printing.
+  if (value != value || value > 9.2e18 || value < -9.2e18) {
+    putRaw("null");
+    return *this;
+  }
+  if (decimals < 0) decimals = 0;
+  if (decimals > 6) decimals = 6;
+  unsigned long long scale = 1;
+  for (int i = 0; i < decimals; ++i) scale *= 10;
+  bool negative = value < 0;
+  double mag = negative ? -value : value;
+  if (mag * scale > 9.2e18) {
+    decimals = 0;
+    scale = 1;
+  }
+  unsigned long long fixed = (unsigned long long)(mag * scale + 0.5);
+  if (negative && fixed) put('-');
+  putUnsigned(fixed / scale);
+  if (decimals) {
+    put('.');
+    unsigned long long frac = fixed % scale;
+    for (unsigned long long d = scale / 10; d; d /= 10) {
+      put((char)('0' + (frac / d) % 10));
+    }
+  }
+  return *this;
+}
+
+JsonWriter& JsonWriter::addRaw(const char* key, const char* json) {
+  beginValue(key);
+  putRaw(json ? json : "null");
+  return *this;
+}
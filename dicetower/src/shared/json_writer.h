@@ -0,0 +1,63 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Allocation-free JSON writer for HTTP responses, shared by the ESP32-CAM and
+// NodeMCU firmwares. Output goes into a caller-provided buffer (stack or
+// static); strings are escaped in place and numbers are formatted without
+// stdio, so building a response never touches the heap (test/json_writer
+// counts heap calls to keep it that way). When the buffer runs out ok() turns
+// false and the text is cut where it ran out (still terminated); callers must
+// not send it.
+//
+//   char buf[256];
+//   JsonWriter w(buf, sizeof(buf));
+//   w.beginObject().add("ok", true).add("value", 6).endObject();
+//   send(w.c_str(), w.length());
+
+class JsonWriter {
+ public:
+  JsonWriter(char* buf, size_t cap);
+
+  // Pass a key inside objects; leave it null for top-level and array values.
+  JsonWriter& beginObject(const char* key = nullptr);
+  JsonWriter& endObject();
+  JsonWriter& beginArray(const char* key = nullptr);
+  JsonWriter& endArray();
+
+  JsonWriter& add(const char* key, const char* value);  // nullptr writes null
+  JsonWriter& add(const char* key, bool value);
+  JsonWriter& add(const char* key, int value);
+  JsonWriter& add(const char* key, unsigned value);
+  JsonWriter& add(const char* key, long value);
+  JsonWriter& add(const char* key, unsigned long value);
+  JsonWriter& add(const char* key, long long value);
+  JsonWriter& add(const char* key, unsigned long long value);
+  // Fixed-point with `decimals` (0..6) digits; NaN and infinities write null.
+  JsonWriter& add(const char* key, double value, int decimals = 3);
+  // Already-serialized JSON value, copied verbatim.
+  JsonWriter& addRaw(const char* key, const char* json);
+
+  const char* c_str() const { return buf; }
+  size_t length() const { return len; }
+  bool ok() const { return !overflow; }
+
+ private:
+  static const int kMaxDepth = 16;
+
+  void put(char c);
+  void putRaw(const char* s);
+  void putString(const char* s);
+  void putUnsigned(unsigned long long v);
+  void putSigned(long long v);
+  void beginValue(const char* key);
+  void open(const char* key, char c);
+  void close(char c);
+
+  char* buf;
+  size_t cap;
+  size_t len;
+  bool overflow;
+  uint8_t depth;
+  uint16_t hasItems;  // Bit per nesting level: a value was already written there
+};
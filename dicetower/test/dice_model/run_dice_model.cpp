@@ -0,0 +1,93 @@
+// Runs the exported Edge Impulse model on recorded frames with the firmware's
+// own input path (dice_model_input.h) and decoding (dice_model_decode.h), and
+// reports accuracy and per-stage latency. Built only when CMake is given the
+// Arduino library export (-DDICE_INFERENCING_DIR=<export>/src).
+//
+//   run_dice_model [frame.pgm ...]   (default: the pip counter fixtures)
+//
+// The expected face is taken from the file name: d6_<n>[_...].pgm, or
+// "empty" for no die. Other names are run and timed but not scored. Host
+// timings show relative cost only; the ESP32 is far slower.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "dice_model_decode.h"
+#include "pgm.h"
+
+static const char* kDefaultFrames[] = {"d6_1", "d6_2", "d6_3", "d6_4", "d6_5", "d6_6", "d6_4_dim", "empty"};
+
+static std::vector<uint8_t> gInput(EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT * 3);
+
+static int getInputData(size_t offset, size_t length, float* out) {
+  modelInputPack(gInput.data(), offset, length, out);
+  return 0;
+}
+
+// -1: unlabelled
+static int expectedValue(const std::string& path) {
+  std::string name = path.substr(path.find_last_of('/') + 1);
+  if (name.compare(0, 5, "empty") == 0) return 0;
+  if (name.compare(0, 3, "d6_") == 0) return atoi(name.c_str() + 3);
+  return -1;
+}
+
+static long median(std::vector<long> v) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[v.size() / 2];
+}
+
+int main(int argc, char** argv) {
+  std::vector<std::string> frames;
+  for (int i = 1; i < argc; ++i) frames.push_back(argv[i]);
+  if (frames.empty()) {
+    for (const char* name : kDefaultFrames) frames.push_back(fixturePath(name));
+  }
+
+  int scored = 0;
+  int correct = 0;
+  std::vector<long> prepUs, dspUs, inferUs;
+  printf("%-24s %5s %5s %6s %7s %7s %7s\n", "frame", "want", "got", "conf", "prep_us", "dsp_us", "inf_us");
+  for (const std::string& path : frames) {
+    GrayImage img;
+    if (!loadPgm(path, img)) {
+      printf("%-24s unreadable\n", path.c_str());
+      continue;
+    }
+    auto start = std::chrono::steady_clock::now();
+    ModelInputMap map;
+    modelInputResize(img.px.data(), img.width, img.height, 1, gInput.data(), EI_CLASSIFIER_INPUT_WIDTH,
+                     EI_CLASSIFIER_INPUT_HEIGHT, map);
+    long prep = (long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    signal_t signal;
+    signal.total_length = (size_t)EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT;
+    signal.get_data = &getInputData;
+    ei_impulse_result_t result = {};
+    if (run_classifier(&signal, &result, false) != EI_IMPULSE_OK) {
+      printf("%-24s run_classifier failed\n", path.c_str());
+      continue;
+    }
+    ModelReading r;
+    modelDecode(result, map, r);
+    int got = r.detected ? r.value : 0;
+    int want = expectedValue(path);
+    if (want >= 0) {
+      scored++;
+      if (got == want) correct++;
+    }
+    prepUs.push_back(prep);
+    dspUs.push_back((long)result.timing.dsp_us);
+    inferUs.push_back((long)result.timing.classification_us);
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    printf("%-24s %5d %5d %6.2f %7ld %7ld %7ld\n", name.c_str(), want, got, r.confidence, prep,
+           (long)result.timing.dsp_us, (long)result.timing.classification_us);
+  }
+  printf("accuracy %d/%d, median prep %ld us, dsp %ld us, inference %ld us\n", correct, scored, median(prepUs),
+         median(dspUs), median(inferUs));
+  return 0;
+}
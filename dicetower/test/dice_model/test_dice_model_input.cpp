@@ -0,0 +1,110 @@
+// Checks the model input path (dice_model_input.h): crop placement, bilinear
+// resampling, channel handling and pixel packing. Runs without a model.
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "dice_model_input.h"
+#include "pgm.h"
+
+static const int kInputW = 96;  // A typical Edge Impulse image input
+static const int kInputH = 96;
+
+static int gFailures = 0;
+
+static void expect(bool cond, const char* name, const char* what) {
+  if (cond) return;
+  printf("FAIL %s: %s\n", name, what);
+  gFailures++;
+}
+
+static std::vector<uint8_t> resize(const std::vector<uint8_t>& px, int width, int height, int channels,
+                                   ModelInputMap& map) {
+  std::vector<uint8_t> dst((size_t)kInputW * kInputH * 3);
+  modelInputResize(px.data(), width, height, channels, dst.data(), kInputW, kInputH, map);
+  return dst;
+}
+
+static void checkCrop() {
+  ModelInputMap map;
+  std::vector<uint8_t> wide(320 * 240, 0);
+  resize(wide, 320, 240, 1, map);
+  expect(map.cropX == 40 && map.cropY == 0 && fabsf(map.scale - 2.5f) < 1e-6f, "crop", "320x240 not centred");
+  std::vector<uint8_t> tall(240 * 320, 0);
+  resize(tall, 240, 320, 1, map);
+  expect(map.cropX == 0 && map.cropY == 40, "crop", "240x320 not centred");
+}
+
+static void checkUniform() {
+  ModelInputMap map;
+  std::vector<uint8_t> gray(320 * 240, 137);
+  std::vector<uint8_t> out = resize(gray, 320, 240, 1, map);
+  bool same = true;
+  for (uint8_t v : out) same = same && v == 137;
+  expect(same, "uniform", "flat grey did not stay flat in R, G and B");
+
+  std::vector<uint8_t> rgb(320 * 240 * 3);
+  for (size_t i = 0; i < rgb.size(); i += 3) {
+    rgb[i] = 10;
+    rgb[i + 1] = 20;
+    rgb[i + 2] = 30;
+  }
+  out = resize(rgb, 320, 240, 3, map);
+  same = true;
+  for (size_t i = 0; i < out.size(); i += 3) same = same && out[i] == 10 && out[i + 1] == 20 && out[i + 2] == 30;
+  expect(same, "uniform", "RGB888 channels mixed");
+}
+
+static void checkGradient() {
+  // px = x: the first and last input columns hit the crop edges exactly and
+  // the columns between rise monotonically.
+  ModelInputMap map;
+  std::vector<uint8_t> gray(320 * 240);
+  for (int y = 0; y < 240; ++y) {
+    for (int x = 0; x < 320; ++x) gray[y * 320 + x] = (uint8_t)(x < 256 ? x : 255);
+  }
+  std::vector<uint8_t> out = resize(gray, 320, 240, 1, map);
+  expect(out[0] == 40, "gradient", "first column is not the crop's left edge");
+  bool rising = true;
+  for (int x = 1; x < kInputW; ++x) rising = rising && out[x * 3] >= out[(x - 1) * 3];
+  expect(rising, "gradient", "resampled row is not monotonic");
+  // Column 48 sits at 40 + 48 * 239 / 95 = 160.76.
+  expect(out[48 * 3] == 161, "gradient", "bilinear weight off");
+}
+
+static void checkFixture() {
+  GrayImage img;
+  if (!loadPgm(fixturePath("d6_3"), img)) {
+    expect(false, "fixture", "d6_3 missing");
+    return;
+  }
+  std::vector<uint8_t> rgb(img.px.size() * 3);
+  for (size_t i = 0; i < img.px.size(); ++i) rgb[i * 3] = rgb[i * 3 + 1] = rgb[i * 3 + 2] = img.px[i];
+  ModelInputMap grayMap, rgbMap;
+  expect(resize(img.px, img.width, img.height, 1, grayMap) == resize(rgb, img.width, img.height, 3, rgbMap), "fixture",
+         "grayscale and RGB888 sources give different inputs");
+}
+
+static void checkPackAndLabels() {
+  const uint8_t rgb[6] = {1, 2, 3, 255, 128, 0};
+  float out[2];
+  modelInputPack(rgb, 0, 2, out);
+  expect(out[0] == (float)0x010203 && out[1] == (float)0xFF8000, "pack", "not 0xRRGGBB");
+  modelInputPack(rgb, 1, 1, out);
+  expect(out[0] == (float)0xFF8000, "pack", "offset is not in pixels");
+  expect(modelLabelValue("3") == 3 && modelLabelValue("20") == 20, "labels", "face labels");
+  expect(modelLabelValue("21") == 0 && modelLabelValue("background") == 0, "labels", "non-face labels");
+}
+
+int main() {
+  checkCrop();
+  checkUniform();
+  checkGradient();
+  checkFixture();
+  checkPackAndLabels();
+  if (gFailures) {
+    printf("%d failure(s)\n", gFailures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
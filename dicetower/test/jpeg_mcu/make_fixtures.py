@@ -0,0 +1,279 @@
+"""
+Encodes the jpeg_mcu host-test fixtures: small baseline JPEGs laid out like
+OV2640 frames (standard Huffman tables, 1-bit padding before markers), plus
+for each one a reference luma plane decoded here from the quantized
+coefficients with a float IDCT. The C++ decoder never sees how these were
+made, so they double as a reference decoder.
+
+Sizes are not MCU multiples, and the DRI variants use intervals that do not
+divide the MCU count, so partial MCUs and a short last restart interval are
+both covered.
+
+Deterministic (fixed seeds); rerun after changing a scene:
+
+    python test/jpeg_mcu/make_fixtures.py
+"""
+
+import math
+import os
+import random
+
+OUT_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "fixtures")
+
+# name: (width, height, luma sampling (h, v) or None for grayscale, restart interval, quality, seed)
+FIXTURES = {
+    "tray_422": (100, 75, (2, 1), 0, 80, 1),
+    "tray_422_dri": (100, 75, (2, 1), 4, 80, 1),
+    "tray_420_dri": (90, 70, (2, 2), 5, 60, 2),
+    "tray_gray_dri": (60, 44, None, 7, 90, 3),
+}
+
+ZIGZAG = [
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+]
+
+# Annex K tables, natural order.
+LUMA_Q = [
+    16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+    14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+    18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99,
+]
+CHROMA_Q = [
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+] + [99] * 32
+
+DC_LUMA = ([0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0], list(range(12)))
+DC_CHROMA = ([0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0], list(range(12)))
+AC_LUMA = ([0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D], bytes.fromhex(
+    "01020300041105122131410613516107227114328191a1082342b1c11552d1f02433627282090a161718191a25262728292a3435363738393a"
+    "434445464748494a535455565758595a636465666768696a737475767778797a838485868788898a92939495969798999aa2a3a4a5a6a7a8a9"
+    "aab2b3b4b5b6b7b8b9bac2c3c4c5c6c7c8c9cad2d3d4d5d6d7d8d9dae1e2e3e4e5e6e7e8e9eaf1f2f3f4f5f6f7f8f9fa"))
+AC_CHROMA = ([0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77], bytes.fromhex(
+    "000102031104052131061241510761711322328108144291a1b1c109233352f0156272d10a162434e125f11718191a262728292a35363738"
+    "393a434445464748494a535455565758595a636465666768696a737475767778797a82838485868788898a92939495969798999aa2a3a4a5"
+    "a6a7a8a9aab2b3b4b5b6b7b8b9bac2c3c4c5c6c7c8c9cad2d3d4d5d6d7d8d9dae2e3e4e5e6e7e8e9eaf2f3f4f5f6f7f8f9fa"))
+
+
+def scaled(table, quality):
+    scale = 5000 // quality if quality < 50 else 200 - 2 * quality
+    return [max(1, min(255, (q * scale + 50) // 100)) for q in table]
+
+
+def huff_codes(counts, vals):
+    codes, code, k = {}, 0, 0
+    for length in range(1, 17):
+        for _ in range(counts[length - 1]):
+            codes[vals[k]] = (code, length)
+            code += 1
+            k += 1
+        code <<= 1
+    return codes
+
+
+C = [[(math.sqrt(0.5) if u == 0 else 1.0) * 0.5 * math.cos((2 * x + 1) * u * math.pi / 16) for u in range(8)]
+     for x in range(8)]
+
+
+def fdct(block):
+    return [sum(C[x][u] * C[y][v] * (block[y * 8 + x] - 128.0) for y in range(8) for x in range(8))
+            for v in range(8) for u in range(8)]
+
+
+def idct(coef):
+    out = []
+    for y in range(8):
+        for x in range(8):
+            s = 128.0 + sum(C[x][u] * C[y][v] * coef[v * 8 + u] for v in range(8) for u in range(8))
+            out.append(max(0, min(255, int(math.floor(s + 0.5)))))
+    return out
+
+
+def render(width, height, seed):
+    """RGB tray scene: lit felt, a die with pips and a coloured edge, sensor noise."""
+    rng = random.Random(seed)
+    pips = [(0.3, 0.3), (0.7, 0.3), (0.5, 0.5), (0.3, 0.7), (0.7, 0.7)]
+    cx, cy, side = width * 0.55, height * 0.5, min(width, height) * 0.6
+    rgb = []
+    for y in range(height):
+        for x in range(width):
+            light = 1.0 - 0.3 * x / width - 0.2 * y / height
+            r, g, b = 40.0, 110.0, 60.0
+            u, w = (x - cx) / side + 0.5, (y - cy) / side + 0.5
+            if 0.0 <= u <= 1.0 and 0.0 <= w <= 1.0:
+                r, g, b = 225.0, 220.0, 205.0
+                if u < 0.06 or w < 0.06:
+                    r, g, b = 200.0, 60.0, 50.0
+                for pu, pw in pips:
+                    if math.hypot(u - pu, w - pw) < 0.09:
+                        r, g, b = 30.0, 30.0, 40.0
+            n = rng.gauss(0.0, 5.0)
+            rgb.append(tuple(max(0, min(255, int(round(c * light + n)))) for c in (r, g, b)))
+    return rgb
+
+
+def planes(rgb, width, height, gray):
+    y_p, cb_p, cr_p = [], [], []
+    for r, g, b in rgb:
+        y_p.append(0.299 * r + 0.587 * g + 0.114 * b)
+        cb_p.append(128.0 - 0.168736 * r - 0.331264 * g + 0.5 * b)
+        cr_p.append(128.0 + 0.5 * r - 0.418688 * g - 0.081312 * b)
+    if gray:
+        return [y_p]
+    return [y_p, cb_p, cr_p]
+
+
+def sample_block(plane, width, height, bx, by, step_x, step_y):
+    """8x8 block at block position (bx, by) of a plane subsampled by (step_x, step_y),
+    repeating the last row/column past the frame edge."""
+    out = []
+    for j in range(8):
+        for i in range(8):
+            acc = 0.0
+            for dy in range(step_y):
+                for dx in range(step_x):
+                    x = min(width - 1, (bx * 8 + i) * step_x + dx)
+                    y = min(height - 1, (by * 8 + j) * step_y + dy)
+                    acc += plane[y * width + x]
+            out.append(max(0, min(255, int(round(acc / (step_x * step_y))))))
+    return out
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.bits = 0
+
+    def put(self, code, size):
+        self.acc = (self.acc << size) | code
+        self.bits += size
+        while self.bits >= 8:
+            byte = (self.acc >> (self.bits - 8)) & 0xFF
+            self.out.append(byte)
+            if byte == 0xFF:
+                self.out.append(0)
+            self.bits -= 8
+        self.acc &= (1 << self.bits) - 1
+
+    def flush(self):
+        if self.bits:
+            self.put((1 << (8 - self.bits)) - 1, 8 - self.bits)
+
+
+def magnitude(v):
+    size = abs(v).bit_length()
+    return size, (v if v >= 0 else v + (1 << size) - 1)
+
+
+def encode_block(bw, zz, pred, dc_codes, ac_codes):
+    diff = zz[0] - pred
+    size, bits = magnitude(diff)
+    bw.put(*dc_codes[size])
+    if size:
+        bw.put(bits, size)
+    run = 0
+    for k in range(1, 64):
+        if zz[k] == 0:
+            run += 1
+            continue
+        while run > 15:
+            bw.put(*ac_codes[0xF0])
+            run -= 16
+        size, bits = magnitude(zz[k])
+        bw.put(*ac_codes[(run << 4) | size])
+        bw.put(bits, size)
+        run = 0
+    if run:
+        bw.put(*ac_codes[0x00])
+    return zz[0]
+
+
+def segment(marker, payload):
+    return bytes([0xFF, marker]) + (len(payload) + 2).to_bytes(2, "big") + bytes(payload)
+
+
+def encode(width, height, sampling, restart, quality, seed):
+    gray = sampling is None
+    hmax, vmax = sampling or (1, 1)
+    src = planes(render(width, height, seed), width, height, gray)
+    qtabs = [scaled(LUMA_Q, quality), scaled(CHROMA_Q, quality)]
+    # (h, v, quant table, Huffman table) per component.
+    comps = [(hmax, vmax, 0, 0)] + ([] if gray else [(1, 1, 1, 1), (1, 1, 1, 1)])
+    dc_codes = [huff_codes(*DC_LUMA), huff_codes(*DC_CHROMA)]
+    ac_codes = [huff_codes(*AC_LUMA), huff_codes(*AC_CHROMA)]
+
+    head = bytearray(b"\xFF\xD8")
+    head += segment(0xE0, b"JFIF\x00\x01\x01\x00\x00\x01\x00\x01\x00\x00")
+    for i in range(1 if gray else 2):
+        head += segment(0xDB, bytes([i] + [qtabs[i][z] for z in ZIGZAG]))
+    sof = bytearray([8]) + height.to_bytes(2, "big") + width.to_bytes(2, "big") + bytes([len(comps)])
+    for i, (h, v, tq, _) in enumerate(comps):
+        sof += bytes([i + 1, (h << 4) | v, tq])
+    head += segment(0xC0, sof)
+    for i, (dc, ac) in enumerate([(DC_LUMA, AC_LUMA), (DC_CHROMA, AC_CHROMA)][:1 if gray else 2]):
+        head += segment(0xC4, bytes([0x00 | i] + dc[0] + dc[1]))
+        head += segment(0xC4, bytes([0x10 | i] + ac[0]) + bytes(ac[1]))
+    if restart:
+        head += segment(0xDD, restart.to_bytes(2, "big"))
+    sos = bytearray([len(comps)])
+    for i, (_, _, _, th) in enumerate(comps):
+        sos += bytes([i + 1, (th << 4) | th])
+    head += segment(0xDA, sos + b"\x00\x3F\x00")
+
+    mcus_x = (width + 8 * hmax - 1) // (8 * hmax)
+    mcus_y = (height + 8 * vmax - 1) // (8 * vmax)
+    luma = [0] * (mcus_x * hmax * 8 * mcus_y * vmax * 8)
+    luma_stride = mcus_x * hmax * 8
+    bw = BitWriter()
+    preds = [0] * len(comps)
+    count = 0
+    for my in range(mcus_y):
+        for mx in range(mcus_x):
+            if restart and count and count % restart == 0:
+                bw.flush()
+                bw.out += bytes([0xFF, 0xD0 + (count // restart - 1) % 8])
+                preds = [0] * len(comps)
+            for ci, (h, v, tq, th) in enumerate(comps):
+                step_x, step_y = hmax // h, vmax // v
+                for by in range(v):
+                    for bx in range(h):
+                        bx_abs, by_abs = mx * h + bx, my * v + by
+                        block = sample_block(src[ci], width, height, bx_abs, by_abs, step_x, step_y)
+                        q = qtabs[tq]
+                        coef = fdct(block)
+                        quant = [int(math.floor(c / q[k] + 0.5)) if c >= 0 else -int(math.floor(-c / q[k] + 0.5))
+                                 for k, c in enumerate(coef)]
+                        preds[ci] = encode_block(bw, [quant[z] for z in ZIGZAG], preds[ci], dc_codes[th], ac_codes[th])
+                        if ci == 0:
+                            pixels = idct([quant[k] * q[k] for k in range(64)])
+                            for j in range(8):
+                                row = (by_abs * 8 + j) * luma_stride + bx_abs * 8
+                                luma[row:row + 8] = pixels[j * 8:j * 8 + 8]
+            count += 1
+    bw.flush()
+    jpeg = bytes(head) + bytes(bw.out) + b"\xFF\xD9"
+    ref = bytearray()
+    for y in range(height):
+        ref += bytes(luma[y * luma_stride:y * luma_stride + width])
+    return jpeg, bytes(ref)
+
+
+def main():
+    os.makedirs(OUT_DIR, exist_ok=True)
+    for name, (width, height, sampling, restart, quality, seed) in FIXTURES.items():
+        jpeg, luma = encode(width, height, sampling, restart, quality, seed)
+        with open(os.path.join(OUT_DIR, name + ".jpg"), "wb") as f:
+            f.write(jpeg)
+        with open(os.path.join(OUT_DIR, name + "_luma.pgm"), "wb") as f:
+            f.write(b"P5\n%d %d\n255\n" % (width, height))
+            f.write(luma)
+        print("wrote", name, len(jpeg), "bytes")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,154 @@
+// Checks the coefficient-level JPEG code (jpeg_mcu.h) on the fixtures from
+// make_fixtures.py: an untouched transcode is byte-identical (with and
+// without restart markers), crops keep the expected MCU-aligned rectangle and
+// decode to the same pixels as the full frame, and the luma decoder matches
+// the generator's reference decode.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "jpeg_mcu.h"
+#include "pgm.h"
+
+struct Fixture {
+  const char* name;
+  bool restarts;
+  JpegRect roi;
+  JpegRect kept;  // MCU-aligned and clamped to the frame
+};
+
+// 4:2:2 and 4:2:0 MCUs are 16x8 and 16x16 pixels, grayscale 8x8.
+static const Fixture kFixtures[] = {
+  {"tray_422", false, {37, 21, 30, 25}, {32, 16, 48, 32}},
+  {"tray_422_dri", true, {90, 70, 50, 50}, {80, 64, 20, 11}},
+  {"tray_420_dri", true, {-5, 20, 40, 30}, {0, 16, 48, 48}},
+  {"tray_gray_dri", true, {37, 21, 30, 25}, {32, 16, 28, 28}},
+};
+
+static int gFailures = 0;
+
+static void expect(bool cond, const char* name, const char* what) {
+  if (cond) return;
+  printf("FAIL %s: %s\n", name, what);
+  gFailures++;
+}
+
+static std::vector<uint8_t> loadJpeg(const char* name) {
+  std::vector<uint8_t> data;
+  FILE* f = fopen((std::string(FIXTURE_DIR) + "/" + name + ".jpg").c_str(), "rb");
+  if (!f) return data;
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) data.insert(data.end(), chunk, chunk + n);
+  fclose(f);
+  return data;
+}
+
+// Offset of the first `marker` segment before the scan, or 0.
+static size_t findSegment(const std::vector<uint8_t>& jpeg, uint8_t marker) {
+  size_t pos = 2;
+  while (pos + 4 <= jpeg.size() && jpeg[pos] == 0xFF) {
+    if (jpeg[pos + 1] == marker) return pos;
+    if (jpeg[pos + 1] == 0xDA) break;
+    pos += 2 + ((jpeg[pos + 2] << 8) | jpeg[pos + 3]);
+  }
+  return 0;
+}
+
+static int countRestartMarkers(const std::vector<uint8_t>& jpeg) {
+  int n = 0;
+  for (size_t i = 0; i + 1 < jpeg.size(); ++i) n += jpeg[i] == 0xFF && jpeg[i + 1] >= 0xD0 && jpeg[i + 1] <= 0xD7;
+  return n;
+}
+
+static void noPaint(void*, int, int, uint8_t*) {}
+
+static bool decodeLuma(JpegCodec* codec, const std::vector<uint8_t>& jpeg, GrayImage& out) {
+  out.px.assign(256 * 256, 0);
+  if (!jpegDecodeLuma(codec, jpeg.data(), jpeg.size(), out.px.data(), out.px.size(), &out.width, &out.height)) {
+    return false;
+  }
+  out.px.resize((size_t)out.width * out.height);
+  return true;
+}
+
+static void checkIdentity(JpegCodec* codec, const Fixture& fx, const std::vector<uint8_t>& jpeg) {
+  expect(fx.restarts == (countRestartMarkers(jpeg) > 0), fx.name, "fixture restart markers do not match its name");
+  std::vector<uint8_t> out(jpeg.size() + 1024);
+  size_t len = jpegPaintLuma(codec, jpeg.data(), jpeg.size(), nullptr, 0, noPaint, nullptr, out.data(), out.size());
+  out.resize(len);
+  expect(out == jpeg, fx.name, "untouched transcode is not byte-identical");
+
+  // One byte short of the input must fail cleanly rather than truncate.
+  std::vector<uint8_t> tight(jpeg.size() - 1);
+  expect(jpegPaintLuma(codec, jpeg.data(), jpeg.size(), nullptr, 0, noPaint, nullptr, tight.data(), tight.size()) == 0,
+         fx.name, "transcode into a short buffer did not fail");
+}
+
+static void checkCrop(JpegCodec* codec, const Fixture& fx, const std::vector<uint8_t>& jpeg, const GrayImage& full) {
+  std::vector<uint8_t> out(jpeg.size() + 1024);
+  JpegRect kept = {0, 0, 0, 0};
+  size_t len = jpegCrop(codec, jpeg.data(), jpeg.size(), fx.roi, out.data(), out.size(), &kept);
+  expect(len > 0, fx.name, "crop failed");
+  if (!len) return;
+  out.resize(len);
+  expect(kept.x == fx.kept.x && kept.y == fx.kept.y && kept.w == fx.kept.w && kept.h == fx.kept.h, fx.name,
+         "crop kept the wrong rectangle");
+
+  size_t sof = findSegment(out, 0xC0);
+  expect(sof && ((out[sof + 5] << 8) | out[sof + 6]) == kept.h && ((out[sof + 7] << 8) | out[sof + 8]) == kept.w,
+         fx.name, "cropped SOF does not match the kept rectangle");
+  expect(!findSegment(out, 0xDD) && countRestartMarkers(out) == 0, fx.name, "crop kept DRI or restart markers");
+
+  // Coefficients are carried over unchanged, so the crop decodes to exactly
+  // the same pixels as that window of the full frame.
+  GrayImage crop;
+  expect(decodeLuma(codec, out, crop) && crop.width == kept.w && crop.height == kept.h, fx.name,
+         "crop does not decode to the kept size");
+  if (crop.width != kept.w || crop.height != kept.h) return;
+  bool same = true;
+  for (int y = 0; y < kept.h; ++y) {
+    same = same && memcmp(&crop.px[(size_t)y * kept.w], &full.px[(size_t)(kept.y + y) * full.width + kept.x], kept.w) == 0;
+  }
+  expect(same, fx.name, "cropped pixels differ from the full decode");
+
+  JpegRect outside = {500, 500, 10, 10};
+  expect(jpegCrop(codec, jpeg.data(), jpeg.size(), outside, out.data(), out.size(), nullptr) == 0, fx.name,
+         "ROI outside the frame did not fail");
+}
+
+static void checkLuma(const Fixture& fx, const GrayImage& luma) {
+  GrayImage ref;
+  expect(loadPgm(std::string(FIXTURE_DIR) + "/" + fx.name + "_luma.pgm", ref), fx.name, "reference luma missing");
+  expect(luma.width == ref.width && luma.height == ref.height, fx.name, "decoded size differs from SOF");
+  if (luma.px.size() != ref.px.size()) return;
+  // The firmware IDCT runs in float, the reference in double: rounding may
+  // differ by one level.
+  int worst = 0;
+  for (size_t i = 0; i < ref.px.size(); ++i) {
+    int d = abs((int)luma.px[i] - (int)ref.px[i]);
+    if (d > worst) worst = d;
+  }
+  expect(worst <= 1, fx.name, "luma differs from the reference decode by more than 1");
+}
+
+int main() {
+  JpegCodec* codec = jpegCodecCreate();
+  for (const Fixture& fx : kFixtures) {
+    std::vector<uint8_t> jpeg = loadJpeg(fx.name);
+    expect(!jpeg.empty(), fx.name, "fixture missing");
+    if (jpeg.empty()) continue;
+    GrayImage luma;
+    expect(decodeLuma(codec, jpeg, luma), fx.name, "luma decode failed");
+    checkIdentity(codec, fx, jpeg);
+    checkLuma(fx, luma);
+    checkCrop(codec, fx, jpeg, luma);
+  }
+  jpegCodecDestroy(codec);
+  if (gFailures) {
+    printf("%d failure(s)\n", gFailures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
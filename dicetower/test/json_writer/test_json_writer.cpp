@@ -0,0 +1,167 @@
+// Checks JsonWriter (shared/json_writer.h): escaping, nesting, overflow and
+// number formatting, and that none of it touches the heap. malloc and
+// operator new are wrapped to count calls while a check runs.
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include "json_writer.h"
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* p, size_t size);
+
+static bool gCounting = false;
+static int gAllocs = 0;
+
+extern "C" void* malloc(size_t size) {
+  if (gCounting) gAllocs++;
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size) {
+  if (gCounting) gAllocs++;
+  return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* p, size_t size) {
+  if (gCounting) gAllocs++;
+  return __libc_realloc(p, size);
+}
+
+void* operator new(size_t size) {
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static int gFailures = 0;
+
+static void expect(bool cond, const char* name, const char* what) {
+  if (cond) return;
+  printf("FAIL %s: %s\n", name, what);
+  gFailures++;
+}
+
+static void expectText(const JsonWriter& w, const char* want, const char* name) {
+  if (w.ok() && strcmp(w.c_str(), want) == 0 && w.length() == strlen(want)) return;
+  printf("FAIL %s: got %s%s, want %s\n", name, w.c_str(), w.ok() ? "" : " (overflow)", want);
+  gFailures++;
+}
+
+static void checkEscaping() {
+  char buf[128];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginObject().add("k\"ey", "a\\b\"c\n\t\r\b\f\x01\x1f/\xc3\xa9").add("n", (const char*)nullptr).endObject();
+  expectText(w, "{\"k\\\"ey\":\"a\\\\b\\\"c\\n\\t\\r\\b\\f\\u0001\\u001f/\xc3\xa9\",\"n\":null}", "escaping");
+}
+
+static void checkNesting() {
+  char buf[128];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginObject()
+    .beginArray("a")
+    .add(nullptr, 1)
+    .beginObject()
+    .add("b", true)
+    .endObject()
+    .beginArray()
+    .endArray()
+    .add(nullptr, false)
+    .endArray()
+    .beginObject("o")
+    .endObject()
+    .addRaw("raw", "[1,2]")
+    .endObject();
+  expectText(w, "{\"a\":[1,{\"b\":true},[],false],\"o\":{},\"raw\":[1,2]}", "nesting");
+
+  // Commas are tracked per level: closing a nested object must not reset the parent.
+  JsonWriter v(buf, sizeof(buf));
+  v.beginObject().beginObject("x").add("y", 1).endObject().add("z", 2).endObject();
+  expectText(v, "{\"x\":{\"y\":1},\"z\":2}", "nesting");
+
+  JsonWriter deep(buf, sizeof(buf));
+  for (int i = 0; i < 20; ++i) deep.beginArray();
+  expect(!deep.ok(), "nesting", "more levels than kMaxDepth did not overflow");
+}
+
+static void checkOverflow() {
+  char buf[16];
+  memset(buf, 'x', sizeof(buf));
+  JsonWriter w(buf, sizeof(buf));
+  w.beginObject().add("key", "a long value that does not fit").endObject();
+  expect(!w.ok(), "overflow", "ok() still true");
+  expect(w.length() < sizeof(buf) && buf[w.length()] == '\0', "overflow", "text not terminated inside the buffer");
+  expect(strncmp(buf, "{\"key\":\"a long value that does not fit\"}", w.length()) == 0, "overflow", "text is not a prefix of the full body");
+
+  // Exactly full: 7 characters plus the terminator.
+  char exact[8];
+  JsonWriter e(exact, sizeof(exact));
+  e.beginArray().add(nullptr, 12345).endArray();
+  expectText(e, "[12345]", "overflow");
+  e.add(nullptr, 1);
+  expect(!e.ok() && strcmp(exact, "[12345]") == 0, "overflow", "one more byte did not overflow cleanly");
+
+  JsonWriter none(nullptr, 0);
+  none.beginObject().endObject();
+  expect(!none.ok(), "overflow", "null buffer reported ok");
+}
+
+static void checkIntegers() {
+  char buf[128];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginArray()
+    .add(nullptr, 0)
+    .add(nullptr, -42)
+    .add(nullptr, UINT_MAX)
+    .add(nullptr, LLONG_MIN)
+    .add(nullptr, ULLONG_MAX)
+    .endArray();
+  expectText(w, "[0,-42,4294967295,-9223372036854775808,18446744073709551615]", "integers");
+}
+
+static void checkDoubles() {
+  char buf[160];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginArray()
+    .add(nullptr, 1.5)
+    .add(nullptr, -2.25, 1)
+    .add(nullptr, 0.125, 2)
+    .add(nullptr, 2.5, 0)
+    .add(nullptr, -0.0004)
+    .add(nullptr, 0.1f, 9)
+    .add(nullptr, 1e19)
+    .add(nullptr, (double)NAN)
+    .add(nullptr, (double)INFINITY)
+    .add(nullptr, -(double)INFINITY)
+    .add(nullptr, 1e15, 6)
+    .endArray();
+  // 0.1f is 0.100000001490116 as a double; decimals are capped at 6. 1e15 with
+  // 6 decimals would not fit in 64 bits, so it drops to an integer.
+  expectText(w, "[1.500,-2.3,0.13,3,0.000,0.100000,null,null,null,null,1000000000000000]", "doubles");
+}
+
+int main() {
+  // A static stdout buffer, so FAIL lines printed mid-check are not counted.
+  static char out[BUFSIZ];
+  setvbuf(stdout, out, _IOLBF, sizeof(out));
+  gCounting = true;
+  checkEscaping();
+  checkNesting();
+  checkOverflow();
+  checkIntegers();
+  checkDoubles();
+  gCounting = false;
+  if (gAllocs) printf("FAIL heap: %d allocation(s) while writing\n", gAllocs);
+  if (gFailures || gAllocs) {
+    printf("%d failure(s)\n", gFailures + (gAllocs ? 1 : 0));
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,38 @@
+// Times pipCount on each fixture: median and worst of N runs, microseconds.
+//
+//   bench_pip_counter [runs]   (default 200)
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "pgm.h"
+#include "pip_counter.h"
+
+static const char* kFixtures[] = {"d6_1", "d6_2", "d6_3", "d6_4", "d6_5", "d6_6", "d6_4_dim", "empty"};
+
+int main(int argc, char** argv) {
+  int runs = argc > 1 ? atoi(argv[1]) : 200;
+  if (runs < 1) runs = 1;
+  PipParams params;
+  pipParamsDefault(params);
+  printf("%-9s %8s %8s\n", "fixture", "med_us", "max_us");
+  for (const char* name : kFixtures) {
+    GrayImage img;
+    if (!loadPgm(fixturePath(name), img)) {
+      printf("%-9s missing\n", name);
+      return 1;
+    }
+    std::vector<uint8_t> scratch(pipScratchBytes(img.width, img.height));
+    std::vector<long> us(runs);
+    PipResult r;
+    for (int i = 0; i < runs; ++i) {
+      auto start = std::chrono::steady_clock::now();
+      pipCount(img.px.data(), img.width, img.height, 1, img.width, params, scratch.data(), scratch.size(), r);
+      us[i] = (long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+    std::sort(us.begin(), us.end());
+    printf("%-9s %8ld %8ld\n", name, us[runs / 2], us[runs - 1]);
+  }
+  return 0;
+}
@@ -0,0 +1,80 @@
+"""
+Renders the pip counter's host-test fixtures: 320x240 8-bit PGM views of a
+d6 on the tray, roughly what the tray crop hands pipCount at QVGA. Each face
+is drawn rotated under an uneven light with sensor noise, so the adaptive
+threshold and the shape filters are exercised, not just a clean template.
+
+Deterministic (fixed seeds); rerun after changing a scene:
+
+    python test/pip_counter/make_fixtures.py
+"""
+
+import math
+import os
+import random
+
+WIDTH, HEIGHT = 320, 240
+OUT_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "fixtures")
+
+# Pip centres in die units (0..1), per face.
+LAYOUTS = {
+    1: [(0.5, 0.5)],
+    2: [(0.25, 0.25), (0.75, 0.75)],
+    3: [(0.25, 0.25), (0.5, 0.5), (0.75, 0.75)],
+    4: [(0.25, 0.25), (0.75, 0.25), (0.25, 0.75), (0.75, 0.75)],
+    5: [(0.25, 0.25), (0.75, 0.25), (0.5, 0.5), (0.25, 0.75), (0.75, 0.75)],
+    6: [(0.25, 0.22), (0.75, 0.22), (0.25, 0.5), (0.75, 0.5), (0.25, 0.78), (0.75, 0.78)],
+}
+
+# name: (face, centre x, centre y, die side px, rotation deg, light gain, seed)
+SCENES = {
+    "d6_1": (1, 150, 118, 76, 8, 1.00, 1),
+    "d6_2": (2, 170, 126, 72, -14, 0.95, 2),
+    "d6_3": (3, 140, 110, 80, 22, 1.05, 3),
+    "d6_4": (4, 180, 120, 74, -5, 0.90, 4),
+    "d6_5": (5, 160, 130, 78, 31, 1.00, 5),
+    "d6_6": (6, 155, 115, 82, -18, 0.85, 6),
+    "d6_4_dim": (4, 120, 100, 70, 40, 0.55, 7),
+    "empty": (0, 0, 0, 0, 0, 1.00, 8),
+}
+
+
+def render(face, cx, cy, side, rot_deg, gain, seed):
+    rng = random.Random(seed)
+    cos_r, sin_r = math.cos(math.radians(rot_deg)), math.sin(math.radians(rot_deg))
+    pip_r = side * 0.085
+    pips = LAYOUTS.get(face, [])
+    px = bytearray(WIDTH * HEIGHT)
+    for y in range(HEIGHT):
+        for x in range(WIDTH):
+            # Felt tray with light falling off to the right and bottom.
+            light = gain * (1.0 - 0.25 * x / WIDTH - 0.15 * y / HEIGHT)
+            v = 55.0
+            if face:
+                u = ((x - cx) * cos_r + (y - cy) * sin_r) / side + 0.5
+                w = (-(x - cx) * sin_r + (y - cy) * cos_r) / side + 0.5
+                if 0.0 <= u <= 1.0 and 0.0 <= w <= 1.0:
+                    v = 215.0
+                    for pu, pw in pips:
+                        d = math.hypot((u - pu) * side, (w - pw) * side)
+                        if d < pip_r:
+                            v = 40.0
+                        elif d < pip_r + 1.0:  # One-pixel antialiased rim
+                            v = 40.0 + (215.0 - 40.0) * (d - pip_r)
+            v = v * light + rng.gauss(0.0, 4.0)
+            px[y * WIDTH + x] = max(0, min(255, int(round(v))))
+    return px
+
+
+def main():
+    os.makedirs(OUT_DIR, exist_ok=True)
+    for name, scene in SCENES.items():
+        data = render(*scene)
+        with open(os.path.join(OUT_DIR, name + ".pgm"), "wb") as f:
+            f.write(b"P5\n%d %d\n255\n" % (WIDTH, HEIGHT))
+            f.write(data)
+        print("wrote", name)
+
+
+if __name__ == "__main__":
+    main()
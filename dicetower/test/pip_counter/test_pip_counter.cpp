@@ -0,0 +1,90 @@
+// Reads every fixture and checks the count, the confidence gate the firmware
+// applies (dice_detection.cpp) and that the box lands on the die. Fixtures
+// come from make_fixtures.py.
+#include <stdio.h>
+#include <vector>
+#include "pgm.h"
+#include "pip_counter.h"
+
+static const int kMinConfidenceQ8 = 154;  // Same gate as dice_detection.cpp
+
+struct Case {
+  const char* name;
+  int pips;        // 0: nothing readable
+  int cx, cy;      // Die centre in the fixture
+};
+
+static const Case kCases[] = {
+  {"d6_1", 1, 150, 118},
+  {"d6_2", 2, 170, 126},
+  {"d6_3", 3, 140, 110},
+  {"d6_4", 4, 180, 120},
+  {"d6_5", 5, 160, 130},
+  {"d6_6", 6, 155, 115},
+  {"d6_4_dim", 4, 120, 100},
+  {"empty", 0, 0, 0},
+};
+
+static int gFailures = 0;
+
+static void expect(bool cond, const char* name, const char* what) {
+  if (cond) return;
+  printf("FAIL %s: %s\n", name, what);
+  gFailures++;
+}
+
+static bool count(const uint8_t* px, int width, int height, int stride, PipResult& out) {
+  PipParams params;
+  pipParamsDefault(params);
+  std::vector<uint8_t> scratch(pipScratchBytes(width, height));
+  return pipCount(px, width, height, stride, width * stride, params, scratch.data(), scratch.size(), out);
+}
+
+static void checkFixture(const Case& c) {
+  GrayImage img;
+  if (!loadPgm(fixturePath(c.name), img)) {
+    expect(false, c.name, "fixture missing");
+    return;
+  }
+  PipResult r;
+  expect(count(img.px.data(), img.width, img.height, 1, r), c.name, "pipCount failed");
+  printf("%-9s pips=%d candidates=%d conf=%d box=%d,%d %dx%d\n", c.name, r.pips, r.candidates,
+         r.confidenceQ8, r.x, r.y, r.w, r.h);
+  if (c.pips == 0) {
+    expect(r.pips < 1 || r.confidenceQ8 < kMinConfidenceQ8, c.name, "read a face on an empty tray");
+    return;
+  }
+  expect(r.pips == c.pips, c.name, "wrong pip count");
+  expect(r.confidenceQ8 >= kMinConfidenceQ8, c.name, "confidence below the firmware gate");
+  expect(r.x <= c.cx && c.cx < r.x + r.w && r.y <= c.cy && c.cy < r.y + r.h, c.name, "box misses the die");
+
+  // The RGB888 path reads the G byte with a pixel stride of 3.
+  std::vector<uint8_t> rgb(img.px.size() * 3);
+  for (size_t i = 0; i < img.px.size(); ++i) rgb[i * 3] = rgb[i * 3 + 1] = rgb[i * 3 + 2] = img.px[i];
+  PipResult rgbResult;
+  expect(count(rgb.data() + 1, img.width, img.height, 3, rgbResult) && rgbResult.pips == r.pips &&
+         rgbResult.confidenceQ8 == r.confidenceQ8, c.name, "RGB888 stride disagrees with grayscale");
+}
+
+static void checkRejects() {
+  GrayImage img;
+  if (!loadPgm(fixturePath("d6_3"), img)) return;
+  PipParams params;
+  pipParamsDefault(params);
+  std::vector<uint8_t> scratch(pipScratchBytes(img.width, img.height) - 1);
+  PipResult r;
+  expect(!pipCount(img.px.data(), img.width, img.height, 1, img.width, params, scratch.data(), scratch.size(), r),
+         "scratch", "accepted a scratch buffer one byte short");
+  expect(!pipCount(img.px.data(), 4, 4, 1, 4, params, scratch.data(), scratch.size(), r), "tiny", "accepted a 4x4 image");
+}
+
+int main() {
+  for (const Case& c : kCases) checkFixture(c);
+  checkRejects();
+  if (gFailures) {
+    printf("%d failure(s)\n", gFailures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
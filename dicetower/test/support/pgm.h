@@ -0,0 +1,31 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Minimal binary PGM (P5, maxval 255) reader for the fixtures. FIXTURE_DIR is
+// set per target by CMakeLists.txt.
+struct GrayImage {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> px;
+};
+
+inline bool loadPgm(const std::string& path, GrayImage& out) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) return false;
+  int maxval = 0;
+  bool ok = fscanf(f, "P5 %d %d %d", &out.width, &out.height, &maxval) == 3 && maxval == 255 &&
+            out.width > 0 && out.height > 0 && fgetc(f) != EOF;
+  if (ok) {
+    out.px.resize((size_t)out.width * out.height);
+    ok = fread(out.px.data(), 1, out.px.size(), f) == out.px.size();
+  }
+  fclose(f);
+  return ok;
+}
+
+inline std::string fixturePath(const char* name) {
+  return std::string(FIXTURE_DIR) + "/" + name + ".pgm";
+}
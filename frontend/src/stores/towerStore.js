@@ -110,6 +110,36 @@ export const useTowerStore = defineStore('towers', () => {
     }
   }
 
+  // /dice/capture only queues a detection job on the tower; poll
+  // /dice/job/<id> until it finishes. Resolves to the final response as
+  // { ok, status, data, text } (data is null when the body is not JSON).
+  async function captureDice(apiBase, { intervalMs = 250, timeoutMs = 15000 } = {}) {
+    const base = (apiBase || '').trim().replace(/\/+$/, '');
+    const parse = text => {
+      try {
+        return JSON.parse(text);
+      } catch (e) {
+        return null;
+      }
+    };
+    let res = await fetch(`${base}/dice/capture`, { cache: 'no-store' });
+    let text = await res.text();
+    let data = parse(text);
+    const deadline = Date.now() + timeoutMs;
+    while (
+      res.ok &&
+      data?.job &&
+      (data.state === 'queued' || data.state === 'running') &&
+      Date.now() < deadline
+    ) {
+      await new Promise(resolve => setTimeout(resolve, intervalMs));
+      res = await fetch(`${base}/dice/job/${data.job}`, { cache: 'no-store' });
+      text = await res.text();
+      data = parse(text);
+    }
+    return { ok: res.ok, status: res.status, data, text };
+  }
+
   watch(towers, save, { deep: true });
 
   return {
@@ -119,6 +149,7 @@ export const useTowerStore = defineStore('towers', () => {
     removeTower,
     cleanInvalidTowers,
     setStatus,
+    captureDice,
     load,
     save,
   };